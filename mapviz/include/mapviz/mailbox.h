@@ -0,0 +1,133 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_MAILBOX_H_
+#define MAPVIZ_MAILBOX_H_
+
+// C++ standard libraries
+#include <deque>
+#include <utility>
+
+// QT libraries
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace mapviz
+{
+  /**
+   * Hands results from a ROS callback thread to the GUI thread.
+   *
+   * Producers append to a pending buffer and the consumer swaps the whole
+   * buffer out for its own, so neither side holds the lock for longer than
+   * it takes to move a container.  If a capacity is set, the oldest pending
+   * items are dropped once it is exceeded; a capacity of 1 gives
+   * latest-message-wins behavior.
+   */
+  template <class T>
+  class Mailbox
+  {
+  public:
+    explicit Mailbox(size_t capacity = 0) : capacity_(capacity), dropped_(0) {}
+
+    void SetCapacity(size_t capacity)
+    {
+      QMutexLocker locker(&mutex_);
+      capacity_ = capacity;
+      Trim();
+    }
+
+    void Post(T item)
+    {
+      QMutexLocker locker(&mutex_);
+      pending_.push_back(std::move(item));
+      Trim();
+    }
+
+    /**
+     * Moves all pending items into items, which is cleared first.
+     * @return false if there was nothing pending
+     */
+    bool Take(std::deque<T>& items)
+    {
+      items.clear();
+      QMutexLocker locker(&mutex_);
+      items.swap(pending_);
+      return !items.empty();
+    }
+
+    /**
+     * Moves the most recent pending item into item and discards the rest.
+     * @return false if there was nothing pending
+     */
+    bool TakeLatest(T& item)
+    {
+      QMutexLocker locker(&mutex_);
+      if (pending_.empty())
+      {
+        return false;
+      }
+      item = std::move(pending_.back());
+      dropped_ += pending_.size() - 1;
+      pending_.clear();
+      return true;
+    }
+
+    void Clear()
+    {
+      QMutexLocker locker(&mutex_);
+      pending_.clear();
+    }
+
+    /**
+     * Number of items that were discarded before the consumer took them.
+     */
+    size_t Dropped() const
+    {
+      QMutexLocker locker(&mutex_);
+      return dropped_;
+    }
+
+  private:
+    void Trim()
+    {
+      while (capacity_ > 0 && pending_.size() > capacity_)
+      {
+        pending_.pop_front();
+        dropped_++;
+      }
+    }
+
+    mutable QMutex mutex_;
+    std::deque<T> pending_;
+    size_t capacity_;
+    size_t dropped_;
+  };
+}
+
+#endif  // MAPVIZ_MAILBOX_H_
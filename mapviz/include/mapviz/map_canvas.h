@@ -51,6 +51,7 @@
 #include <tf/transform_listener.h>
 
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/renderer.h>
 
 namespace mapviz
 {
@@ -79,6 +80,16 @@ namespace mapviz
     QPointF FixedFrameToMapGlCoord(const QPointF& point);
 
     double frameRate() const;
+    double idleFrameRate() const;
+
+    /**
+     * Number of frame timer ticks since startup that did not repaint because
+     * nothing was dirty.
+     */
+    uint64_t framesSkipped() const { return frames_skipped_; }
+    uint64_t framesDrawn() const { return frames_drawn_; }
+
+    Renderer* GetRenderer() { return &renderer_; }
 
     float ViewScale() const { return view_scale_; }
     float OffsetX() const { return offset_x_; }
@@ -96,30 +107,33 @@ namespace mapviz
     {
       view_scale_ = scale;
       UpdateView();
+      MarkDirty();
     }
 
     void SetOffsetX(float x)
     {
       offset_x_ = x;
       UpdateView();
+      MarkDirty();
     }
 
     void SetOffsetY(float y)
     {
       offset_y_ = y;
       UpdateView();
+      MarkDirty();
     }
 
     void SetBackground(const QColor& color)
     {
       bg_color_ = color;
-      update();
+      MarkDirty();
     }
 
     void CaptureFrames(bool enabled)
     {
       capture_frames_ = enabled;
-      update();
+      MarkDirty();
     }
 
     /**
@@ -166,8 +180,24 @@ namespace mapviz
     void Hover(double x, double y, double scale);
 
   public Q_SLOTS:
+    /**
+     * Sets the maximum rate at which the canvas will repaint.  The canvas
+     * only repaints at this rate while something is dirty.
+     */
     void setFrameRate(const double fps);
 
+    /**
+     * Sets the rate at which the canvas repaints even when nothing is dirty.
+     * This catches changes that nobody reported, such as plugins that don't
+     * emit Dirty().  Set to 0 to disable the heartbeat.
+     */
+    void setIdleFrameRate(const double fps);
+
+    /**
+     * Requests a repaint on the next frame timer tick.
+     */
+    void MarkDirty();
+
   protected:
     void initializeGL();
     void initGlBlending();
@@ -186,6 +216,12 @@ namespace mapviz
     void Zoom(float factor);
 
     void InitializePixelBuffers();
+    bool TargetTransformChanged();
+
+  protected Q_SLOTS:
+    void HandleFrameTimer();
+
+  protected:
 
     bool canvas_able_to_move_ = true;
     bool has_pixel_buffers_;
@@ -201,6 +237,15 @@ namespace mapviz
 
     QTimer frame_rate_timer_;
 
+    Renderer renderer_;
+
+    // Set whenever the view or a plugin changes; cleared on every repaint.
+    bool dirty_;
+    double idle_frame_rate_;
+    ros::WallTime last_frame_time_;
+    uint64_t frames_drawn_;
+    uint64_t frames_skipped_;
+
     QColor bg_color_;
 
     Qt::MouseButton mouse_button_;
@@ -246,6 +291,8 @@ namespace mapviz
 
     boost::shared_ptr<tf::TransformListener> tf_;
     tf::StampedTransform transform_;
+    // The raw fixed -> target transform used for the last repaint
+    tf::StampedTransform painted_target_transform_;
     QTransform qtransform_;
     std::list<MapvizPluginPtr> plugins_;
 
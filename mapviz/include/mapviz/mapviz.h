@@ -167,6 +167,7 @@ namespace mapviz
     VideoWriter* vid_writer_;
 
     bool updating_frames_;
+    bool threaded_callbacks_;
 
     ros::NodeHandle* node_;
     ros::ServiceServer add_display_srv_;
@@ -198,6 +199,7 @@ namespace mapviz
 
     virtual void showEvent(QShowEvent* event);
     virtual void closeEvent(QCloseEvent* event);
+    virtual bool eventFilter(QObject* object, QEvent* event);
 
     static const QString ROS_WORKSPACE_VAR;
     static const QString MAPVIZ_CONFIG_FILE;
@@ -31,6 +31,7 @@
 #define MAPVIZ_MAPVIZ_PLUGIN_H_
 
 // C++ standard libraries
+#include <algorithm>
 #include <string>
 
 #include <boost/make_shared.hpp>
@@ -40,9 +41,11 @@
 #include <QWidget>
 #include <QGLWidget>
 #include <QObject>
+#include <QThread>
 
 // ROS libraries
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <tf/transform_datatypes.h>
 #include <swri_transform_util/transform.h>
 #include <swri_transform_util/transform_manager.h>
@@ -54,11 +57,16 @@
 
 namespace mapviz
 {
+  class Renderer;
+
   class MapvizPlugin : public QObject
   {
     Q_OBJECT;
   public:
-    virtual ~MapvizPlugin() {}
+    virtual ~MapvizPlugin()
+    {
+      StopCallbackThread();
+    }
 
     virtual bool Initialize(
         boost::shared_ptr<tf::TransformListener> tf_listener,
@@ -70,6 +78,10 @@ namespace mapviz
       return Initialize(canvas);
     }
 
+    /**
+     * Called when the plugin is removed from the canvas, with the canvas's
+     * GL context current so that textures and buffers can be released.
+     */
     virtual void Shutdown() = 0;
 
     virtual void ClearHistory() {}
@@ -119,6 +131,63 @@ namespace mapviz
       node_ = node;
     }
 
+    /**
+     * Override this to return "true" if your plugin's ROS callbacks are safe
+     * to run on a worker thread.  Such callbacks must not touch Qt widgets
+     * (PrintError() and friends are fine) or make OpenGL calls, and should
+     * hand their results to the GUI thread through a mapviz::Mailbox.
+     */
+    virtual bool SupportsThreadedCallbacks()
+    {
+      return false;
+    }
+
+    /**
+     * Starts a worker thread that services this plugin's own callback queue
+     * and returns a copy of node that delivers its callbacks to that queue.
+     * Pass the result to SetNode() so that every subscription the plugin
+     * makes is processed off the GUI thread.
+     */
+    ros::NodeHandle StartCallbackThread(const ros::NodeHandle& node)
+    {
+      ros::NodeHandle threaded_node(node);
+      threaded_node.setCallbackQueue(&callback_queue_);
+
+      if (!callback_spinner_)
+      {
+        // A single thread per queue keeps each plugin's callbacks serialized,
+        // so plugins don't need to be re-entrant.
+        callback_spinner_ = boost::make_shared<ros::AsyncSpinner>(1, &callback_queue_);
+        callback_spinner_->start();
+      }
+
+      return threaded_node;
+    }
+
+    /**
+     * Stops servicing the plugin's callback queue.  This must happen before
+     * any of the derived class is destroyed, so it is called when the plugin
+     * is removed from the canvas.
+     */
+    void StopCallbackThread()
+    {
+      if (callback_spinner_)
+      {
+        callback_queue_.disable();
+        callback_spinner_->stop();
+        callback_spinner_.reset();
+        callback_queue_.clear();
+      }
+    }
+
+    bool HasCallbackThread() const { return static_cast<bool>(callback_spinner_); }
+
+    /**
+     * Sets the batched renderer owned by the canvas.  This is done when the
+     * plugin is added to the canvas, so it's available from Draw().
+     */
+    void SetRenderer(Renderer* renderer) { renderer_ = renderer; }
+
     void DrawPlugin(double x, double y, double scale)
     {
       if (visible_ && initialized_)
@@ -288,12 +357,19 @@ namespace mapviz
     void UseLatestTransformsChanged(bool use_latest_transforms);
     void VisibleChanged(bool visible);
 
+    /**
+     * Emit this whenever something the plugin draws has changed, e.g. after
+     * receiving a message or when a config setting is edited.  The canvas
+     * only repaints when the view or at least one plugin is dirty.
+     */
+    void Dirty();
 
   protected:
     bool initialized_;
     bool visible_;
 
     QGLWidget* canvas_;
+    Renderer* renderer_;
     IconWidget* icon_;
 
     ros::NodeHandle node_;
@@ -316,6 +392,7 @@ namespace mapviz
       initialized_(false),
       visible_(true),
       canvas_(NULL),
+      renderer_(NULL),
       icon_(NULL),
       tf_(),
       target_frame_(""),
@@ -329,6 +406,11 @@ namespace mapviz
     Stopwatch meas_transform_;
     Stopwatch meas_paint_;
     Stopwatch meas_draw_;
+
+    ros::CallbackQueue callback_queue_;
+    boost::shared_ptr<ros::AsyncSpinner> callback_spinner_;
+
+    static void PostStatusHelper(QLabel *status_label, const QString& color, const std::string& message);
   };
   typedef boost::shared_ptr<MapvizPlugin> MapvizPluginPtr;
 
@@ -337,6 +419,15 @@ namespace mapviz
   inline void MapvizPlugin::PrintErrorHelper(QLabel *status_label, const std::string &message,
                                              double throttle)
   {
+      if (QThread::currentThread() != status_label->thread())
+      {
+        // Only the GUI thread may touch the label; since we can't safely
+        // compare against its current text, always throttle the log.
+        ROS_ERROR_THROTTLE(std::max(throttle, 1.0), "Error: %s", message.c_str());
+        PostStatusHelper(status_label, "red", message);
+        return;
+      }
+
       if (message == status_label->text().toStdString())
       {
         return;
@@ -351,12 +442,25 @@ namespace mapviz
       QPalette p(status_label->palette());
       p.setColor(QPalette::Text, Qt::red);
       status_label->setPalette(p);
+      if (!status_label->styleSheet().isEmpty())
+      {
+        status_label->setStyleSheet(QString());
+      }
       status_label->setText(message.c_str());
   }
 
   inline void MapvizPlugin::PrintInfoHelper(QLabel *status_label, const std::string &message,
                                             double throttle)
   {
+      if (QThread::currentThread() != status_label->thread())
+      {
+        // Only the GUI thread may touch the label; since we can't safely
+        // compare against its current text, always throttle the log.
+        ROS_INFO_THROTTLE(std::max(throttle, 1.0), "%s", message.c_str());
+        PostStatusHelper(status_label, "#008000", message);
+        return;
+      }
+
       if (message == status_label->text().toStdString())
       {
         return;
@@ -371,12 +475,25 @@ namespace mapviz
       QPalette p(status_label->palette());
       p.setColor(QPalette::Text, Qt::darkGreen);
       status_label->setPalette(p);
+      if (!status_label->styleSheet().isEmpty())
+      {
+        status_label->setStyleSheet(QString());
+      }
       status_label->setText(message.c_str());
   }
 
   inline void MapvizPlugin::PrintWarningHelper(QLabel *status_label, const std::string &message,
                                                double throttle)
   {
+      if (QThread::currentThread() != status_label->thread())
+      {
+        // Only the GUI thread may touch the label; since we can't safely
+        // compare against its current text, always throttle the log.
+        ROS_WARN_THROTTLE(std::max(throttle, 1.0), "%s", message.c_str());
+        PostStatusHelper(status_label, "#808000", message);
+        return;
+      }
+
       if (message == status_label->text().toStdString())
       {
         return;
@@ -391,9 +508,24 @@ namespace mapviz
       QPalette p(status_label->palette());
       p.setColor(QPalette::Text, Qt::darkYellow);
       status_label->setPalette(p);
+      if (!status_label->styleSheet().isEmpty())
+      {
+        status_label->setStyleSheet(QString());
+      }
       status_label->setText(message.c_str());
   }
 
+  inline void MapvizPlugin::PostStatusHelper(QLabel *status_label, const QString& color,
+                                             const std::string &message)
+  {
+      // setStyleSheet() and setText() are both slots, so they can be queued
+      // to run on the label's thread.
+      QMetaObject::invokeMethod(status_label, "setStyleSheet", Qt::QueuedConnection,
+                                Q_ARG(QString, "color: " + color));
+      QMetaObject::invokeMethod(status_label, "setText", Qt::QueuedConnection,
+                                Q_ARG(QString, QString::fromStdString(message)));
+  }
+
 }
 #endif  // MAPVIZ_MAPVIZ_PLUGIN_H_
 
@@ -0,0 +1,731 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_RENDERER_H_
+#define MAPVIZ_RENDERER_H_
+
+// C++ standard libraries
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+// QT libraries
+#include <QGLWidget>
+#include <QColor>
+
+// ROS libraries
+#include <tf/transform_datatypes.h>
+
+namespace mapviz
+{
+  /**
+   * A vertex with a per-vertex color, laid out so that a whole batch can be
+   * copied straight into a vertex buffer.
+   */
+  struct ColorVertex
+  {
+    ColorVertex() : x(0), y(0), r(0), g(0), b(0), a(255) {}
+
+    ColorVertex(float x, float y, const QColor& color) :
+      x(x),
+      y(y),
+      r(static_cast<uint8_t>(color.red())),
+      g(static_cast<uint8_t>(color.green())),
+      b(static_cast<uint8_t>(color.blue())),
+      a(static_cast<uint8_t>(color.alpha()))
+    {
+    }
+
+    ColorVertex(float x, float y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) :
+      x(x), y(y), r(r), g(g), b(b), a(a)
+    {
+    }
+
+    float x;
+    float y;
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+  };
+
+  /**
+   * A vertex with texture coordinates.
+   */
+  struct TexturedVertex
+  {
+    TexturedVertex() : x(0), y(0), u(0), v(0) {}
+    TexturedVertex(float x, float y, float u, float v) : x(x), y(y), u(u), v(v) {}
+
+    float x;
+    float y;
+    float u;
+    float v;
+  };
+
+  /**
+   * A vertex with texture coordinates and a color of its own, so that quads
+   * of different colors can share a draw call.
+   */
+  struct ColorTexturedVertex
+  {
+    ColorTexturedVertex() : x(0), y(0), u(0), v(0), r(0), g(0), b(0), a(255) {}
+    ColorTexturedVertex(float x, float y, float u, float v, const QColor& color) :
+      x(x),
+      y(y),
+      u(u),
+      v(v),
+      r(static_cast<uint8_t>(color.red())),
+      g(static_cast<uint8_t>(color.green())),
+      b(static_cast<uint8_t>(color.blue())),
+      a(static_cast<uint8_t>(color.alpha()))
+    {
+    }
+
+    float x;
+    float y;
+    float u;
+    float v;
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+  };
+
+  /**
+   * A vertex that carries a scalar value instead of a color; the color is
+   * looked up from a Colormap when it is drawn.
+   */
+  struct ScalarVertex
+  {
+    ScalarVertex() : x(0), y(0), value(0) {}
+    ScalarVertex(float x, float y, float value) : x(x), y(y), value(value) {}
+
+    float x;
+    float y;
+    float value;
+  };
+
+  /**
+   * One placement of a mesh: the mesh's x and y axes are mapped onto x_axis
+   * and y_axis and its origin onto x, y, so a unit mesh can be rotated,
+   * scaled and stretched into place.
+   */
+  struct Instance
+  {
+    Instance() :
+      x(0), y(0), x_axis_x(1), x_axis_y(0), y_axis_x(0), y_axis_y(1),
+      r(0), g(0), b(0), a(255)
+    {}
+
+    float x;
+    float y;
+    float x_axis_x;
+    float x_axis_y;
+    float y_axis_x;
+    float y_axis_y;
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+  };
+
+  /**
+   * The meshes that can be drawn with Renderer::DrawInstances().
+   */
+  enum InstanceMesh
+  {
+    // A filled circle of radius 1 around the origin
+    MESH_DISC = 0,
+    // A filled square from -0.5 to 0.5 on both axes
+    MESH_SQUARE,
+    // Lines for an arrow from the origin to (1, 0), with its head starting
+    // three quarters of the way along
+    MESH_ARROW,
+    // Lines around the edge of a circle of radius 1 around the origin, to be
+    // deformed into an ellipse by the instance's axes
+    MESH_CIRCLE,
+    MESH_COUNT
+  };
+
+  /**
+   * Maps scalar values to colors through a 256-entry table.  The table is
+   * uploaded as a 1D texture so that shaders can do the lookup per vertex;
+   * changing the colors or the range only touches the table or a uniform,
+   * never the geometry that is being colored.
+   */
+  class Colormap : boost::noncopyable
+  {
+  public:
+    static const size_t SIZE = 256;
+
+    Colormap();
+    ~Colormap();
+
+    /** Linearly interpolates from min_color to max_color in RGB. */
+    void SetGradient(const QColor& min_color, const QColor& max_color);
+
+    /** Sweeps the hue, as the plugins' "rainbow" option always has. */
+    void SetRainbow();
+
+    /**
+     * Copies SIZE RGBA colors into the table as they are, for palettes that
+     * are indexed by byte values rather than interpolated.
+     */
+    void SetTable(const uint8_t* rgba);
+
+    /**
+     * Values are normalized to [0, 1] over this range before the lookup; if
+     * max <= min they're used as they are.
+     */
+    void SetRange(float min, float max);
+    float Min() const { return min_; }
+    float Max() const { return max_; }
+
+    /** Looks up the color of a value on the CPU. */
+    void Lookup(float value, uint8_t* rgba) const;
+
+    /**
+     * Increments whenever the colors or the range change, so that anything
+     * colored on the CPU can tell when it's stale.
+     */
+    uint32_t Version() const { return version_; }
+
+    /**
+     * Returns the GL_TEXTURE_1D holding the table, uploading it first if it
+     * changed; requires a current GL context.
+     */
+    GLuint Texture();
+
+    /**
+     * Releases the texture; requires a current GL context.
+     */
+    void Destroy();
+
+  private:
+    std::vector<uint8_t> table_;
+    float min_;
+    float max_;
+    uint32_t version_;
+    GLuint texture_;
+    bool texture_dirty_;
+  };
+
+  /**
+   * The raw beams of a planar laser scan, as they are in a LaserScan
+   * message.
+   */
+  struct BeamScan
+  {
+    BeamScan() :
+      ranges(NULL), intensities(NULL), count(0),
+      angle_min(0), angle_increment(0), range_min(0), range_max(0)
+    {}
+
+    const float* ranges;
+    // Either NULL or count intensities
+    const float* intensities;
+    size_t count;
+    float angle_min;
+    float angle_increment;
+    float range_min;
+    float range_max;
+  };
+
+  /**
+   * What DrawBeams() colors each beam by.
+   */
+  enum BeamValue
+  {
+    BEAM_RANGE = 0,
+    BEAM_INTENSITY,
+    // Coordinates in the scan's frame
+    BEAM_X,
+    BEAM_Y,
+    // Height in the frame the scan is being transformed to
+    BEAM_Z,
+    BEAM_CONSTANT
+  };
+
+  /**
+   * A linked GLSL program.  All of mapviz's shaders are written against GLSL
+   * 1.20 and read the fixed-function matrices, so they work with the
+   * glOrtho/glTranslate transform stack the canvas and plugins already use.
+   */
+  class ShaderProgram : boost::noncopyable
+  {
+  public:
+    ShaderProgram();
+    ~ShaderProgram();
+
+    /**
+     * Binds a vertex attribute to a fixed location when the program is next
+     * built.  This keeps custom attributes off location 0, which some drivers
+     * alias with gl_Vertex.
+     */
+    void BindAttributeLocation(const std::string& name, GLuint location);
+
+    /**
+     * Compiles and links the program; requires a current GL context.
+     * On failure the compiler output is available from Log().
+     */
+    bool Build(const std::string& vertex_source, const std::string& fragment_source);
+
+    /**
+     * Releases the program; requires a current GL context.
+     */
+    void Destroy();
+
+    bool IsValid() const { return program_ != 0; }
+    GLuint Id() const { return program_; }
+    const std::string& Log() const { return log_; }
+
+    void Bind() const;
+    static void Release();
+
+    /**
+     * Looks up (and caches) the location of a uniform; returns -1 if the
+     * program has no active uniform by that name.
+     */
+    GLint Uniform(const std::string& name);
+
+    /**
+     * Looks up (and caches) the location of a vertex attribute.
+     */
+    GLint Attribute(const std::string& name);
+
+  private:
+    GLuint Compile(GLenum type, const std::string& source);
+
+    GLuint program_;
+    std::string log_;
+    std::map<std::string, GLint> uniforms_;
+    std::map<std::string, GLint> attributes_;
+    std::map<std::string, GLuint> attribute_bindings_;
+  };
+  typedef boost::shared_ptr<ShaderProgram> ShaderProgramPtr;
+
+  /**
+   * A ring-buffered vertex buffer for geometry that is rebuilt every frame.
+   *
+   * Batches are appended one after another into a single buffer object;
+   * when the end of the buffer is reached it is orphaned and writing starts
+   * over at the front, so the driver never has to stall waiting for the GPU
+   * to finish reading data that is still in flight.
+   */
+  class StreamBuffer : boost::noncopyable
+  {
+  public:
+    explicit StreamBuffer(size_t capacity = 4 * 1024 * 1024);
+    ~StreamBuffer();
+
+    /**
+     * Releases the buffer object; requires a current GL context.
+     */
+    void Destroy();
+
+    /**
+     * Copies bytes into the ring and leaves the buffer bound to
+     * GL_ARRAY_BUFFER.
+     * @return The byte offset of the data within the buffer
+     */
+    size_t Append(const void* data, size_t bytes);
+
+    /**
+     * Makes sure the next appends, totalling up to bytes, are contiguous and
+     * won't wrap, so that several arrays appended for one draw call stay
+     * valid together.
+     */
+    void Reserve(size_t bytes);
+
+    GLuint Id() const { return buffer_; }
+    size_t Capacity() const { return capacity_; }
+
+  private:
+    void Allocate();
+
+    GLuint buffer_;
+    size_t capacity_;
+    size_t head_;
+    bool allocated_;
+  };
+
+  /**
+   * A vertex buffer for geometry that changes rarely, which is uploaded
+   * once and drawn from many times.
+   */
+  class VertexBuffer : boost::noncopyable
+  {
+  public:
+    VertexBuffer();
+    ~VertexBuffer();
+
+    /**
+     * Replaces the contents of the buffer and leaves it bound to
+     * GL_ARRAY_BUFFER; requires a current GL context.
+     */
+    void Upload(const void* data, size_t bytes);
+
+    /**
+     * Makes room for at least bytes and leaves the buffer bound to
+     * GL_ARRAY_BUFFER.  Storage grows by doubling, so a buffer that's
+     * appended to is only reallocated a logarithmic number of times.
+     * @return true if the storage was replaced, losing its contents
+     */
+    bool Reserve(size_t bytes);
+
+    /**
+     * Overwrites part of the buffer, which must already have room for it.
+     */
+    void Update(size_t offset, const void* data, size_t bytes);
+
+    /**
+     * Releases the buffer object; requires a current GL context.
+     */
+    void Destroy();
+
+    GLuint Id() const { return buffer_; }
+    size_t Capacity() const { return capacity_; }
+
+  private:
+    GLuint buffer_;
+    size_t capacity_;
+  };
+
+  /**
+   * Geometry that is kept on the GPU between frames, along with a copy on
+   * the CPU.  Editing the data marks it to be uploaded again the next time
+   * it's drawn, so a batch only costs a transfer when it actually changes.
+   * Data that only grows at the end can be appended to instead, which
+   * uploads just the new elements.
+   */
+  template <typename T>
+  class StaticBatch : boost::noncopyable
+  {
+  public:
+    StaticBatch() : uploaded_(0) {}
+
+    std::vector<T>& Edit()
+    {
+      uploaded_ = 0;
+      return data_;
+    }
+
+    /**
+     * Gives access to the data for adding to its end.  Elements that are
+     * already there must be left as they are, since they aren't uploaded
+     * again.
+     */
+    std::vector<T>& Append()
+    {
+      return data_;
+    }
+
+    const std::vector<T>& Data() const { return data_; }
+    size_t Size() const { return data_.size(); }
+    bool Empty() const { return data_.empty(); }
+
+    /**
+     * Uploads whatever was edited or appended and returns the buffer
+     * holding the data; requires a current GL context.
+     */
+    GLuint Buffer()
+    {
+      if (uploaded_ < data_.size())
+      {
+        if (buffer_.Reserve(data_.size() * sizeof(T)))
+        {
+          uploaded_ = 0;
+        }
+        buffer_.Update(uploaded_ * sizeof(T), &data_[uploaded_],
+                       (data_.size() - uploaded_) * sizeof(T));
+      }
+      uploaded_ = data_.size();
+      return buffer_.Id();
+    }
+
+    /**
+     * Releases the buffer, keeping the data; requires a current GL context.
+     */
+    void Destroy()
+    {
+      buffer_.Destroy();
+      uploaded_ = 0;
+    }
+
+  private:
+    std::vector<T> data_;
+    VertexBuffer buffer_;
+    // How many elements at the front of the data are on the GPU.
+    size_t uploaded_;
+  };
+  typedef StaticBatch<ColorVertex> ColorBatch;
+  typedef StaticBatch<Instance> InstanceBatch;
+
+  /**
+   * Batched drawing for plugins.
+   *
+   * Rather than issuing a driver call per vertex with glBegin()/glVertex(),
+   * plugins build a vector of vertices and submit it in one call.  The data
+   * is streamed through a StreamBuffer and drawn with a single
+   * glDrawArrays().  The current model-view matrix is honored, so
+   * plugins can keep using glPushMatrix()/glMultMatrix() to position
+   * batches.
+   *
+   * All methods must be called from the GUI thread while the canvas' GL
+   * context is current, i.e. from a plugin's Draw().
+   */
+  class Renderer : boost::noncopyable
+  {
+  public:
+    Renderer();
+    ~Renderer();
+
+    /**
+     * Creates GL resources.  This is done automatically on first use, but
+     * requires GLEW to have been initialized.
+     */
+    bool Initialize();
+
+    /**
+     * Releases GL resources; requires a current GL context.
+     */
+    void Destroy();
+
+    /**
+     * True if GLSL shaders are available.  If not, batches are still drawn
+     * from vertex buffers, but through the fixed-function pipeline.
+     */
+    bool ShadersSupported() const { return shaders_supported_; }
+
+    /**
+     * Draws count vertices as primitives of the given mode (GL_POINTS,
+     * GL_LINES, GL_LINE_STRIP, GL_TRIANGLES, ...).
+     */
+    void Draw(GLenum mode, const ColorVertex* vertices, size_t count);
+    void Draw(GLenum mode, const std::vector<ColorVertex>& vertices)
+    {
+      if (!vertices.empty())
+      {
+        Draw(mode, &vertices[0], vertices.size());
+      }
+    }
+
+    /**
+     * Draws a batch that is kept on the GPU, uploading it first if it was
+     * edited.
+     */
+    void Draw(GLenum mode, ColorBatch& batch);
+
+    /**
+     * True if meshes can be instanced on the GPU.  If not, DrawInstances()
+     * still works, but places every copy of the mesh on the CPU.
+     */
+    bool InstancingSupported() const { return instancing_supported_; }
+
+    /**
+     * Draws a copy of mesh for each instance in a single draw call; only the
+     * instances are uploaded, and the vertex shader places the mesh.
+     * @param scale  Multiplies every instance's axes, so that instances can
+     *               be resized together without being uploaded again
+     * @param first  The first instance of the batch to draw, so that
+     *               instances can be dropped from the front of a batch
+     *               without uploading it again
+     */
+    void DrawInstances(InstanceMesh mesh, InstanceBatch& instances, float scale = 1.0f,
+        size_t first = 0);
+    void DrawInstances(InstanceMesh mesh, const std::vector<Instance>& instances,
+        float scale = 1.0f);
+
+    void DrawPoints(const std::vector<ColorVertex>& vertices, float size);
+    void DrawLines(const std::vector<ColorVertex>& vertices, float width);
+    void DrawLineStrip(const std::vector<ColorVertex>& vertices, float width);
+    void DrawTriangles(const std::vector<ColorVertex>& vertices);
+
+    /**
+     * Draws textured quads.  Every four vertices describe one quad, given
+     * in counter-clockwise or clockwise order around its edge.
+     * @param texture  A GL_TEXTURE_2D texture name
+     * @param color    Modulates the texture; use white for none
+     */
+    void DrawTexturedQuads(
+        GLuint texture,
+        const std::vector<TexturedVertex>& vertices,
+        const QColor& color = Qt::white);
+
+    /**
+     * Like DrawTexturedQuads(), with the texture modulated by each vertex's
+     * color.
+     */
+    void DrawTexturedQuads(
+        GLuint texture,
+        const std::vector<ColorTexturedVertex>& vertices);
+
+    /**
+     * Draws textured quads whose texture holds palette indices, one byte per
+     * texel in the red or luminance channel, and looks each one up in
+     * palette on the GPU.  The texture should be sampled with GL_NEAREST,
+     * since interpolated indices are meaningless.
+     * @return false if shaders aren't available, in which case nothing is
+     *         drawn and the caller has to color the texels itself
+     */
+    bool DrawPaletteQuads(
+        GLuint indices,
+        const std::vector<TexturedVertex>& vertices,
+        Colormap& palette,
+        const QColor& color = Qt::white);
+
+    /**
+     * Draws vertices colored by looking up their values in colormap.  With
+     * shaders the lookup happens on the GPU; otherwise the vertices are
+     * colored on the CPU first.
+     * @param alpha  Opacity in [0, 1], applied to every vertex
+     */
+    void DrawScalar(GLenum mode, const std::vector<ScalarVertex>& vertices,
+        Colormap& colormap, float alpha);
+    void DrawScalarPoints(const std::vector<ScalarVertex>& vertices,
+        Colormap& colormap, float alpha, float size);
+
+    /**
+     * Like DrawScalar(), for vertices kept in columns.
+     * @param xy            Interleaved x, y of each vertex
+     * @param values        The value of the first vertex
+     * @param value_stride  The number of floats between successive values,
+     *                      so that a column of xy can be used as the values
+     */
+    void DrawScalar(GLenum mode, const float* xy, const float* values,
+        size_t value_stride, size_t count, Colormap& colormap, float alpha);
+    void DrawScalarPoints(const float* xy, const float* values,
+        size_t value_stride, size_t count, Colormap& colormap, float alpha,
+        float size);
+
+    /**
+     * For plugins that keep their own vertex buffers: binds the colormap
+     * program and texture.  Positions come from the vertex array
+     * (glVertexPointer) and values from the generic attribute at
+     * SCALAR_ATTRIBUTE.  Call EndColormap() when done.
+     * @return false if shaders aren't available, in which case nothing is
+     *         bound and the caller has to color on the CPU
+     */
+    bool BeginColormap(Colormap& colormap, float alpha);
+    void EndColormap();
+
+    static const GLuint SCALAR_ATTRIBUTE = 1;
+
+    /**
+     * Draws a laser scan straight from its ranges: only the ranges and
+     * intensities are uploaded, and the vertex shader works out where each
+     * beam is from its index and the scan's angles, hides the beams that are
+     * out of range, and looks up its color.
+     * @param transform       Takes the scan's frame to the target frame
+     * @param value           What to color the beams by
+     * @param constant_value  The value used for BEAM_CONSTANT
+     * @return false if shaders aren't available, in which case nothing is
+     *         drawn and the caller has to project the beams on the CPU
+     */
+    bool DrawBeams(const BeamScan& scan, const tf::Transform& transform,
+        BeamValue value, float constant_value, Colormap& colormap,
+        float alpha, float size);
+
+    /**
+     * Pushes the model-view matrix and multiplies it by transform, so that
+     * geometry stored in a source frame is drawn in the target frame without
+     * transforming it on the CPU.  Must be balanced by PopTransform().
+     */
+    static void PushTransform(const tf::Transform& transform);
+    static void PopTransform();
+
+    /**
+     * Binds the renderer's stream buffer to GL_ARRAY_BUFFER and copies data
+     * into it, for plugins that need a custom vertex layout.
+     * @return The byte offset of the data within the buffer
+     */
+    size_t Stream(const void* data, size_t bytes);
+
+    /** Number of draw calls issued since the last ResetStatistics(). */
+    size_t DrawCalls() const { return draw_calls_; }
+
+    /** Number of vertices submitted since the last ResetStatistics(). */
+    size_t Vertices() const { return vertices_; }
+
+    void ResetStatistics();
+
+  private:
+    void DrawQuads(
+        GLuint texture,
+        const std::vector<TexturedVertex>& vertices,
+        const QColor& color,
+        Colormap* palette);
+
+    void DrawInstances(InstanceMesh mesh, GLuint buffer, size_t offset,
+        const Instance* instances, size_t count, float scale);
+
+    struct Mesh
+    {
+      GLenum mode;
+      size_t first;
+      size_t count;
+    };
+
+    bool initialized_;
+    bool shaders_supported_;
+    bool instancing_supported_;
+
+    ShaderProgram color_program_;
+    ShaderProgram texture_program_;
+    ShaderProgram colormap_program_;
+    ShaderProgram beam_program_;
+    ShaderProgram palette_program_;
+    ShaderProgram instance_program_;
+    StreamBuffer stream_;
+
+    // Every InstanceMesh, one after another, as x, y pairs
+    std::vector<float> mesh_vertices_;
+    Mesh meshes_[MESH_COUNT];
+    VertexBuffer mesh_buffer_;
+
+    // Holds 0, 1, 2, ... as floats, to give the beam shader each vertex's
+    // index; GLSL 1.20 has no gl_VertexID.
+    GLuint beam_index_buffer_;
+    size_t beam_index_count_;
+
+    std::vector<TexturedVertex> quad_scratch_;
+    std::vector<ColorTexturedVertex> color_quad_scratch_;
+    std::vector<ColorVertex> color_scratch_;
+
+    size_t draw_calls_;
+    size_t vertices_;
+  };
+}
+
+#endif  // MAPVIZ_RENDERER_H_
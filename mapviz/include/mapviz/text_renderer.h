@@ -0,0 +1,180 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_TEXT_RENDERER_H_
+#define MAPVIZ_TEXT_RENDERER_H_
+
+// C++ standard libraries
+#include <stdint.h>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+// QT libraries
+#include <QGLWidget>
+#include <QColor>
+#include <QFont>
+#include <QString>
+
+#include <mapviz/renderer.h>
+
+namespace mapviz
+{
+  /**
+   * Draws text labels in the GL pass, so that plugins don't have to switch
+   * to a QPainter for them.
+   *
+   * Glyphs are rasterized once by Qt into an atlas texture, strings are laid
+   * out once into quads that sample it, and every label added in a frame is
+   * drawn with a single call.  Labels can be decluttered, in which case one
+   * that would overlap a label added before it is dropped.
+   *
+   * Like the Renderer, this must be used from the GUI thread while the
+   * canvas' GL context is current.
+   */
+  class TextRenderer : boost::noncopyable
+  {
+  public:
+    /**
+     * A string laid out in a font.  Layouts sample the atlas, so they go
+     * stale when it fills up and is started over; see IsCurrent().
+     */
+    struct Layout
+    {
+      uint32_t generation;
+      float width;
+      float height;
+      // Four vertices per glyph, relative to the top left of the text
+      std::vector<TexturedVertex> quads;
+    };
+    typedef boost::shared_ptr<const Layout> LayoutPtr;
+
+    static const int ATLAS_SIZE = 1024;
+
+    TextRenderer();
+    ~TextRenderer();
+
+    /**
+     * Lays out text, rasterizing any glyphs that aren't in the atlas yet.
+     * Plugins should keep the layout for as long as the text doesn't change.
+     */
+    LayoutPtr GetLayout(const QString& text, const QFont& font);
+
+    /**
+     * False if the layout is empty or was made before the atlas was last
+     * started over, in which case it has to be laid out again.
+     */
+    bool IsCurrent(const LayoutPtr& layout) const;
+
+    /**
+     * Starts a frame of labels.  The current GL transform and viewport are
+     * captured so that Project() can place labels at points in the scene.
+     */
+    void Begin();
+
+    /**
+     * Projects a point in the frame that was current at Begin() to window
+     * coordinates, in pixels from the top left.
+     * @return false if the point is behind the view
+     */
+    bool Project(double x, double y, float& window_x, float& window_y) const;
+
+    /**
+     * Adds a label with its top left corner at a window position.  Labels
+     * added before a GetLayout() that started the atlas over are discarded,
+     * so plugins should lay out stale text before adding it.
+     * @param declutter  If true, the label is dropped if it would overlap
+     *                   another decluttered label added since Begin()
+     * @return false if the label was dropped or is off screen
+     */
+    bool Add(const LayoutPtr& layout, float left, float top,
+        const QColor& color, bool declutter = false);
+
+    /**
+     * Draws every label added since Begin().
+     */
+    void Draw(Renderer& renderer);
+
+    /**
+     * Releases the atlas texture; requires a current GL context.
+     */
+    void Destroy();
+
+  private:
+    struct Glyph
+    {
+      // Atlas coordinates
+      float u0, v0, u1, v1;
+      // Placement relative to the pen position on the baseline
+      float left, top, width, height;
+      float advance;
+    };
+
+    // Rectangles of decluttered labels, bucketed into screen cells
+    struct Rect
+    {
+      float left, top, right, bottom;
+    };
+    static const int CELL_SIZE = 64;
+
+    const Glyph& GetGlyph(const QFont& font, const QString& font_key, uint32_t code_point);
+    void ResetAtlas();
+    bool Overlaps(const Rect& rect) const;
+    void Insert(const Rect& rect);
+
+    std::map<std::pair<QString, uint32_t>, Glyph> glyphs_;
+    // Luminance-alpha texels; the luminance is always white, so the label
+    // color comes through unchanged.
+    std::vector<uint8_t> atlas_;
+    uint32_t generation_;
+    int shelf_x_;
+    int shelf_y_;
+    int shelf_height_;
+    // Rows of the atlas that changed since it was last uploaded
+    int dirty_top_;
+    int dirty_bottom_;
+    GLuint texture_;
+
+    double modelview_[16];
+    double projection_[16];
+    GLint viewport_[4];
+
+    std::vector<ColorTexturedVertex> vertices_;
+    // The atlas generation the vertices sample
+    uint32_t vertices_generation_;
+    std::vector<Rect> rects_;
+    std::unordered_map<int64_t, std::vector<size_t> > cells_;
+  };
+}
+
+#endif  // MAPVIZ_TEXT_RENDERER_H_
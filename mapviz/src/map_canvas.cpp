@@ -57,6 +57,10 @@ MapCanvas::MapCanvas(QWidget* parent) :
   fix_orientation_(false),
   rotate_90_(false),
   enable_antialiasing_(true),
+  dirty_(true),
+  idle_frame_rate_(1.0),
+  frames_drawn_(0),
+  frames_skipped_(0),
   mouse_button_(Qt::NoButton),
   mouse_pressed_(false),
   mouse_x_(0),
@@ -85,8 +89,9 @@ MapCanvas::MapCanvas(QWidget* parent) :
   setMouseTracking(true);
 
   transform_.setIdentity();
+  painted_target_transform_.setIdentity();
 
-  QObject::connect(&frame_rate_timer_, SIGNAL(timeout()), this, SLOT(update()));
+  QObject::connect(&frame_rate_timer_, SIGNAL(timeout()), this, SLOT(HandleFrameTimer()));
   setFrameRate(50.0);
   frame_rate_timer_.start();
   setFocusPolicy(Qt::StrongFocus);
@@ -94,6 +99,8 @@ MapCanvas::MapCanvas(QWidget* parent) :
 
 MapCanvas::~MapCanvas()
 {
+  makeCurrent();
+  renderer_.Destroy();
   if(pixel_buffer_size_ != 0)
   {
     glDeleteBuffersARB(2, pixel_buffer_ids_);
@@ -218,6 +225,13 @@ void MapCanvas::CaptureFrame(bool force)
 
 void MapCanvas::paintEvent(QPaintEvent* event)
 {
+  // Anything that becomes dirty while the plugins are drawing will be picked
+  // up on the next tick.
+  dirty_ = false;
+  last_frame_time_ = ros::WallTime::now();
+  frames_drawn_++;
+  renderer_.ResetStatistics();
+
   if (capture_frames_)
   {
     CaptureFrame();
@@ -315,6 +329,7 @@ void MapCanvas::Zoom(float factor)
 {
   view_scale_ *= std::pow(1.1, factor);
   UpdateView();
+  MarkDirty();
 }
 
 void MapCanvas::mousePressEvent(QMouseEvent* e)
@@ -326,10 +341,12 @@ void MapCanvas::mousePressEvent(QMouseEvent* e)
   drag_y_ = 0;
   mouse_pressed_ = true;
   mouse_button_ = e->button();
+  MarkDirty();
 }
 
 void MapCanvas::keyPressEvent(QKeyEvent* event)
 {
+  MarkDirty();
   std::list<MapvizPluginPtr>::iterator it;
   for (it = plugins_.begin(); it != plugins_.end(); ++it)
   {
@@ -356,6 +373,7 @@ void MapCanvas::mouseReleaseEvent(QMouseEvent* e)
   offset_y_ += drag_y_;
   drag_x_ = 0;
   drag_y_ = 0;
+  MarkDirty();
 }
 
 void MapCanvas::mouseMoveEvent(QMouseEvent* e)
@@ -371,6 +389,7 @@ void MapCanvas::mouseMoveEvent(QMouseEvent* e)
         {
           drag_x_ = -((mouse_x_ - e->x()) * view_scale_);
           drag_y_ = ((mouse_y_ - e->y()) * view_scale_);
+          MarkDirty();
         }
         break;
       case Qt::RightButton:
@@ -416,6 +435,7 @@ void MapCanvas::SetFixedFrame(const std::string& frame)
   {
     (*it)->SetTargetFrame(frame);
   }
+  MarkDirty();
 }
 
 void MapCanvas::SetTargetFrame(const std::string& frame)
@@ -426,16 +446,19 @@ void MapCanvas::SetTargetFrame(const std::string& frame)
   drag_y_ = 0;
 
   target_frame_ = frame;
+  MarkDirty();
 }
 
 void MapCanvas::ToggleFixOrientation(bool on)
 {
   fix_orientation_ = on;
+  MarkDirty();
 }
 
 void MapCanvas::ToggleRotate90(bool on)
 {
   rotate_90_ = on;
+  MarkDirty();
 }
 
 void MapCanvas::ToggleEnableAntialiasing(bool on)
@@ -455,17 +478,32 @@ void MapCanvas::ToggleUseLatestTransforms(bool on)
   {
     (*it)->SetUseLatestTransforms(on);
   }
+  MarkDirty();
 }
 
 void MapCanvas::AddPlugin(MapvizPluginPtr plugin, int order)
 {
+  plugin->SetRenderer(&renderer_);
+  QObject::connect(plugin.get(), SIGNAL(Dirty()), this, SLOT(MarkDirty()));
+  QObject::connect(plugin.get(), SIGNAL(VisibleChanged(bool)), this, SLOT(MarkDirty()));
+  QObject::connect(plugin.get(), SIGNAL(DrawOrderChanged(int)), this, SLOT(MarkDirty()));
+  QObject::connect(plugin.get(), SIGNAL(SizeChanged()), this, SLOT(MarkDirty()));
+
   plugins_.push_back(plugin);
+  MarkDirty();
 }
 
 void MapCanvas::RemovePlugin(MapvizPluginPtr plugin)
 {
+  // Make sure no callbacks are running on other threads while the plugin
+  // shuts down.
+  plugin->StopCallbackThread();
+  // Plugins release their GL resources when they shut down.
+  makeCurrent();
   plugin->Shutdown();
+  QObject::disconnect(plugin.get(), 0, this, 0);
   plugins_.remove(plugin);
+  MarkDirty();
 }
 
 void MapCanvas::TransformTarget(QPainter* painter)
@@ -493,6 +531,7 @@ void MapCanvas::TransformTarget(QPainter* painter)
   try
   {
     tf_->lookupTransform(fixed_frame_, target_frame_, ros::Time(0), transform_);
+    painted_target_transform_ = transform_;
 
     // If the viewer orientation is fixed don't rotate the center point.
     if (fix_orientation_)
@@ -589,6 +628,7 @@ void MapCanvas::ResetLocation()
 void MapCanvas::ReorderDisplays()
 {
   plugins_.sort(compare_plugins);
+  MarkDirty();
 }
 
 void MapCanvas::Recenter()
@@ -610,8 +650,66 @@ void MapCanvas::setFrameRate(const double fps)
   frame_rate_timer_.setInterval(1000.0/fps);
 }
 
+void MapCanvas::setIdleFrameRate(const double fps)
+{
+  if (fps < 0.0) {
+    ROS_ERROR("Invalid idle frame rate: %f", fps);
+    return;
+  }
+
+  idle_frame_rate_ = fps;
+}
+
 double MapCanvas::frameRate() const
 {
   return 1000.0 / frame_rate_timer_.interval();
 }
+
+double MapCanvas::idleFrameRate() const
+{
+  return idle_frame_rate_;
+}
+
+void MapCanvas::MarkDirty()
+{
+  dirty_ = true;
+}
+
+bool MapCanvas::TargetTransformChanged()
+{
+  if (!tf_ || fixed_frame_.empty() || target_frame_.empty() || target_frame_ == "<none>")
+  {
+    return false;
+  }
+
+  tf::StampedTransform transform;
+  try
+  {
+    tf_->lookupTransform(fixed_frame_, target_frame_, ros::Time(0), transform);
+  }
+  catch (const tf::TransformException& e)
+  {
+    return false;
+  }
+
+  return transform.getOrigin() != painted_target_transform_.getOrigin() ||
+      transform.getRotation() != painted_target_transform_.getRotation();
+}
+
+void MapCanvas::HandleFrameTimer()
+{
+  bool heartbeat = idle_frame_rate_ > 0.0 &&
+      (ros::WallTime::now() - last_frame_time_).toSec() >= 1.0 / idle_frame_rate_;
+
+  // If the view is following a moving target frame, every frame is different
+  // even if no plugin has received new data.
+  if (dirty_ || heartbeat || TargetTransformChanged())
+  {
+    update();
+  }
+  else
+  {
+    frames_skipped_++;
+  }
+}
 }  // namespace mapviz
@@ -67,8 +67,11 @@
 #include <QProcessEnvironment>
 #include <QFileInfo>
 #include <QListWidgetItem>
+#include <QMouseEvent>
 #include <QMutexLocker>
 
+#include <ros/callback_queue.h>
+
 #include <swri_math_util/constants.h>
 #include <swri_transform_util/frames.h>
 #include <swri_yaml_util/yaml_util.h>
@@ -99,6 +102,7 @@ Mapviz::Mapviz(bool is_standalone, int argc, char** argv, QWidget *parent, Qt::W
     capture_directory_("~"),
     vid_writer_(NULL),
     updating_frames_(false),
+    threaded_callbacks_(true),
     node_(NULL),
     canvas_(NULL)
 {
@@ -200,10 +204,15 @@ Mapviz::Mapviz(bool is_standalone, int argc, char** argv, QWidget *parent, Qt::W
 
   ui_.bg_color->setColor(background_);
   canvas_->SetBackground(background_);
+
+  // Most config widget edits change what the canvas should show, so any user
+  // input is treated as a reason to repaint.
+  qApp->installEventFilter(this);
 }
 
 Mapviz::~Mapviz()
 {
+  qApp->removeEventFilter(this);
   video_thread_.quit();
   video_thread_.wait();
   delete node_;
@@ -214,6 +223,28 @@ void Mapviz::showEvent(QShowEvent* event)
   Initialize();
 }
 
+bool Mapviz::eventFilter(QObject* object, QEvent* event)
+{
+  switch (event->type())
+  {
+    case QEvent::MouseButtonRelease:
+    case QEvent::KeyRelease:
+    case QEvent::Wheel:
+      canvas_->MarkDirty();
+      break;
+    case QEvent::MouseMove:
+      if (static_cast<QMouseEvent*>(event)->buttons() != Qt::NoButton)
+      {
+        canvas_->MarkDirty();
+      }
+      break;
+    default:
+      break;
+  }
+
+  return QMainWindow::eventFilter(object, event);
+}
+
 void Mapviz::closeEvent(QCloseEvent* event)
 {
   AutoSave();
@@ -307,6 +338,18 @@ void Mapviz::Initialize()
     bool auto_save;
     priv.param("auto_save_backup", auto_save, true);
 
+    double max_fps;
+    priv.param("max_fps", max_fps, 50.0);
+    canvas_->setFrameRate(max_fps);
+
+    double idle_fps;
+    priv.param("idle_fps", idle_fps, 1.0);
+    canvas_->setIdleFrameRate(idle_fps);
+
+    // Plugins that support it process their ROS callbacks on worker threads
+    // so that heavy topics don't stall painting and the UI.
+    priv.param("threaded_callbacks", threaded_callbacks_, true);
+
     Open(config);
 
     UpdateFrames();
@@ -337,9 +380,19 @@ void Mapviz::SpinOnce()
 {
   if (ros::ok())
   {
+    // Plugins should emit Dirty() when they receive new data, but not all of
+    // them do; if any callbacks are about to run, assume the canvas needs to
+    // be repainted.
+    bool has_callbacks = !ros::getGlobalCallbackQueue()->isEmpty();
+
     meas_spin_.start();
     ros::spinOnce();
     meas_spin_.stop();
+
+    if (has_callbacks)
+    {
+      canvas_->MarkDirty();
+    }
   }
   else
   {
@@ -1141,7 +1194,14 @@ MapvizPluginPtr Mapviz::CreateNewDisplay(
   plugin->Initialize(tf_, tf_manager_, canvas_);
   plugin->SetType(real_type.c_str());
   plugin->SetName(name);
-  plugin->SetNode(*node_);
+  if (threaded_callbacks_ && plugin->SupportsThreadedCallbacks())
+  {
+    plugin->SetNode(plugin->StartCallbackThread(*node_));
+  }
+  else
+  {
+    plugin->SetNode(*node_);
+  }
   plugin->SetVisible(visible);
 
   if (draw_order == 0)
@@ -1524,6 +1584,9 @@ void Mapviz::HandleProfileTimer()
 {
   ROS_INFO("Mapviz Profiling Data");
   meas_spin_.printInfo("ROS SpinOnce()");
+  ROS_INFO("Canvas -- frames drawn: %lu, frames skipped: %lu",
+           static_cast<unsigned long>(canvas_->framesDrawn()),
+           static_cast<unsigned long>(canvas_->framesSkipped()));
   for (auto& display: plugins_)
   {
     MapvizPluginPtr plugin = display.second;
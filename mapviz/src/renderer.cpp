@@ -0,0 +1,1381 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <mapviz/renderer.h>
+
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// ROS libraries
+#include <ros/console.h>
+
+namespace mapviz
+{
+  namespace
+  {
+    inline const GLvoid* BufferOffset(size_t offset)
+    {
+      return reinterpret_cast<const GLvoid*>(offset);
+    }
+
+    const char* COLOR_VERTEX_SHADER =
+        "#version 120\n"
+        "void main()\n"
+        "{\n"
+        "  gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+        "  gl_FrontColor = gl_Color;\n"
+        "}\n";
+
+    const char* COLOR_FRAGMENT_SHADER =
+        "#version 120\n"
+        "void main()\n"
+        "{\n"
+        "  gl_FragColor = gl_Color;\n"
+        "}\n";
+
+    const char* TEXTURE_VERTEX_SHADER =
+        "#version 120\n"
+        "void main()\n"
+        "{\n"
+        "  gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+        "  gl_FrontColor = gl_Color;\n"
+        "  gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+        "}\n";
+
+    const char* TEXTURE_FRAGMENT_SHADER =
+        "#version 120\n"
+        "uniform sampler2D image;\n"
+        "void main()\n"
+        "{\n"
+        "  gl_FragColor = texture2D(image, gl_TexCoord[0].st) * gl_Color;\n"
+        "}\n";
+
+    // Indices are stored as normalized bytes, so the palette is sampled at
+    // the center of the entry they pick.
+    const char* PALETTE_FRAGMENT_SHADER =
+        "#version 120\n"
+        "uniform sampler2D indices;\n"
+        "uniform sampler1D palette;\n"
+        "void main()\n"
+        "{\n"
+        "  float index = texture2D(indices, gl_TexCoord[0].st).r;\n"
+        "  gl_FragColor = texture1D(palette, (0.5 + index * 255.0) / 256.0) * gl_Color;\n"
+        "}\n";
+
+    const char* COLORMAP_VERTEX_SHADER =
+        "#version 120\n"
+        "attribute float scalar;\n"
+        "uniform float value_min;\n"
+        "uniform float value_max;\n"
+        "varying float position;\n"
+        "void main()\n"
+        "{\n"
+        "  gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+        "  float value = scalar;\n"
+        "  if (value_max > value_min)\n"
+        "  {\n"
+        "    value = (value - value_min) / (value_max - value_min);\n"
+        "  }\n"
+        "  position = clamp(value, 0.0, 1.0);\n"
+        "}\n";
+
+    // Sample at texel centers so that 0 and 1 land exactly on the first and
+    // last entries of the table.
+    const char* COLORMAP_FRAGMENT_SHADER =
+        "#version 120\n"
+        "uniform sampler1D colormap;\n"
+        "uniform float alpha;\n"
+        "varying float position;\n"
+        "void main()\n"
+        "{\n"
+        "  vec4 color = texture1D(colormap, (0.5 + position * 255.0) / 256.0);\n"
+        "  gl_FragColor = vec4(color.rgb, alpha);\n"
+        "}\n";
+
+    // The beam index is bound to location 0 since nothing here reads
+    // gl_Vertex; some drivers won't draw without an array at location 0.
+    // Beams that are out of range, including NaNs, are moved outside of the
+    // clip volume so that they're never rasterized.
+    const char* BEAM_VERTEX_SHADER =
+        "#version 120\n"
+        "attribute float beam;\n"
+        "attribute float range;\n"
+        "attribute float intensity;\n"
+        "uniform float angle_min;\n"
+        "uniform float angle_increment;\n"
+        "uniform float range_min;\n"
+        "uniform float range_max;\n"
+        "uniform int value_source;\n"
+        "uniform float constant_value;\n"
+        "uniform vec4 z_row;\n"
+        "uniform float value_min;\n"
+        "uniform float value_max;\n"
+        "varying float position;\n"
+        "void main()\n"
+        "{\n"
+        "  float angle = angle_min + angle_increment * beam;\n"
+        "  vec4 vertex = vec4(range * cos(angle), range * sin(angle), 0.0, 1.0);\n"
+        "  if (range >= range_min && range <= range_max)\n"
+        "  {\n"
+        "    gl_Position = gl_ModelViewProjectionMatrix * vertex;\n"
+        "  }\n"
+        "  else\n"
+        "  {\n"
+        "    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+        "  }\n"
+        "  float value = constant_value;\n"
+        "  if (value_source == 0) value = range;\n"
+        "  else if (value_source == 1) value = intensity;\n"
+        "  else if (value_source == 2) value = vertex.x;\n"
+        "  else if (value_source == 3) value = vertex.y;\n"
+        "  else if (value_source == 4) value = dot(z_row, vertex);\n"
+        "  if (value_max > value_min)\n"
+        "  {\n"
+        "    value = (value - value_min) / (value_max - value_min);\n"
+        "  }\n"
+        "  position = clamp(value, 0.0, 1.0);\n"
+        "}\n";
+
+    const GLuint BEAM_INDEX_ATTRIBUTE = 0;
+    const GLuint BEAM_RANGE_ATTRIBUTE = 1;
+    const GLuint BEAM_INTENSITY_ATTRIBUTE = 2;
+
+    // The mesh vertex is at location 0 for the same reason as the beam index.
+    const char* INSTANCE_VERTEX_SHADER =
+        "#version 120\n"
+        "attribute vec2 mesh_vertex;\n"
+        "attribute vec2 origin;\n"
+        "attribute vec4 axes;\n"
+        "attribute vec4 color;\n"
+        "uniform float mesh_scale;\n"
+        "void main()\n"
+        "{\n"
+        "  vec2 position = origin + mesh_scale * (mesh_vertex.x * axes.xy + mesh_vertex.y * axes.zw);\n"
+        "  gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 0.0, 1.0);\n"
+        "  gl_FrontColor = color;\n"
+        "}\n";
+
+    const GLuint MESH_VERTEX_ATTRIBUTE = 0;
+    const GLuint INSTANCE_ORIGIN_ATTRIBUTE = 1;
+    const GLuint INSTANCE_AXES_ATTRIBUTE = 2;
+    const GLuint INSTANCE_COLOR_ATTRIBUTE = 3;
+
+    // The same resolution markers have always been drawn with
+    const int DISC_SEGMENTS = 36;
+  }
+
+  Colormap::Colormap() :
+    table_(SIZE * 4, 255),
+    min_(0.0f),
+    max_(1.0f),
+    version_(0),
+    texture_(0),
+    texture_dirty_(true)
+  {
+    SetGradient(Qt::white, Qt::black);
+  }
+
+  Colormap::~Colormap()
+  {
+  }
+
+  void Colormap::SetGradient(const QColor& min_color, const QColor& max_color)
+  {
+    for (size_t i = 0; i < SIZE; i++)
+    {
+      const double val = static_cast<double>(i) / (SIZE - 1);
+      table_[i * 4] = static_cast<uint8_t>(val * max_color.red() + ((1.0 - val) * min_color.red()));
+      table_[i * 4 + 1] = static_cast<uint8_t>(val * max_color.green() + ((1.0 - val) * min_color.green()));
+      table_[i * 4 + 2] = static_cast<uint8_t>(val * max_color.blue() + ((1.0 - val) * min_color.blue()));
+      table_[i * 4 + 3] = 255;
+    }
+    version_++;
+    texture_dirty_ = true;
+  }
+
+  void Colormap::SetRainbow()
+  {
+    for (size_t i = 0; i < SIZE; i++)
+    {
+      const QColor color = QColor::fromHsl(static_cast<int>(i * 255 / (SIZE - 1)), 255, 127, 255);
+      table_[i * 4] = static_cast<uint8_t>(color.red());
+      table_[i * 4 + 1] = static_cast<uint8_t>(color.green());
+      table_[i * 4 + 2] = static_cast<uint8_t>(color.blue());
+      table_[i * 4 + 3] = 255;
+    }
+    version_++;
+    texture_dirty_ = true;
+  }
+
+  void Colormap::SetTable(const uint8_t* rgba)
+  {
+    std::memcpy(&table_[0], rgba, SIZE * 4);
+    version_++;
+    texture_dirty_ = true;
+  }
+
+  void Colormap::SetRange(float min, float max)
+  {
+    if (min != min_ || max != max_)
+    {
+      min_ = min;
+      max_ = max;
+      version_++;
+    }
+  }
+
+  void Colormap::Lookup(float value, uint8_t* rgba) const
+  {
+    if (max_ > min_)
+    {
+      value = (value - min_) / (max_ - min_);
+    }
+    value = std::max(0.0f, std::min(value, 1.0f));
+
+    const size_t index = static_cast<size_t>(value * (SIZE - 1) + 0.5f);
+    std::memcpy(rgba, &table_[index * 4], 4);
+  }
+
+  GLuint Colormap::Texture()
+  {
+    if (texture_ == 0)
+    {
+      glGenTextures(1, &texture_);
+      texture_dirty_ = true;
+    }
+
+    if (texture_dirty_)
+    {
+      glBindTexture(GL_TEXTURE_1D, texture_);
+      glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, &table_[0]);
+      glBindTexture(GL_TEXTURE_1D, 0);
+      texture_dirty_ = false;
+    }
+
+    return texture_;
+  }
+
+  void Colormap::Destroy()
+  {
+    if (texture_ != 0)
+    {
+      glDeleteTextures(1, &texture_);
+      texture_ = 0;
+    }
+  }
+
+  ShaderProgram::ShaderProgram() :
+    program_(0)
+  {
+  }
+
+  ShaderProgram::~ShaderProgram()
+  {
+    // GL objects can only be released with the context current, which can't
+    // be guaranteed here; they are freed along with the context otherwise.
+  }
+
+  GLuint ShaderProgram::Compile(GLenum type, const std::string& source)
+  {
+    GLuint shader = glCreateShader(type);
+    const GLchar* text = source.c_str();
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+      GLint length = 0;
+      glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+      std::vector<GLchar> log(std::max(length, 1));
+      glGetShaderInfoLog(shader, static_cast<GLsizei>(log.size()), NULL, &log[0]);
+      log_ += &log[0];
+      glDeleteShader(shader);
+      return 0;
+    }
+
+    return shader;
+  }
+
+  bool ShaderProgram::Build(const std::string& vertex_source, const std::string& fragment_source)
+  {
+    Destroy();
+    log_.clear();
+
+    GLuint vertex_shader = Compile(GL_VERTEX_SHADER, vertex_source);
+    GLuint fragment_shader = Compile(GL_FRAGMENT_SHADER, fragment_source);
+    if (vertex_shader == 0 || fragment_shader == 0)
+    {
+      glDeleteShader(vertex_shader);
+      glDeleteShader(fragment_shader);
+      return false;
+    }
+
+    program_ = glCreateProgram();
+    glAttachShader(program_, vertex_shader);
+    glAttachShader(program_, fragment_shader);
+    std::map<std::string, GLuint>::const_iterator binding = attribute_bindings_.begin();
+    for (; binding != attribute_bindings_.end(); ++binding)
+    {
+      glBindAttribLocation(program_, binding->second, binding->first.c_str());
+    }
+    glLinkProgram(program_);
+
+    // The program keeps the shaders alive for as long as they're attached.
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program_, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+      GLint length = 0;
+      glGetProgramiv(program_, GL_INFO_LOG_LENGTH, &length);
+      std::vector<GLchar> log(std::max(length, 1));
+      glGetProgramInfoLog(program_, static_cast<GLsizei>(log.size()), NULL, &log[0]);
+      log_ += &log[0];
+      Destroy();
+      return false;
+    }
+
+    return true;
+  }
+
+  void ShaderProgram::BindAttributeLocation(const std::string& name, GLuint location)
+  {
+    attribute_bindings_[name] = location;
+  }
+
+  void ShaderProgram::Destroy()
+  {
+    if (program_ != 0)
+    {
+      glDeleteProgram(program_);
+      program_ = 0;
+    }
+    uniforms_.clear();
+    attributes_.clear();
+  }
+
+  void ShaderProgram::Bind() const
+  {
+    glUseProgram(program_);
+  }
+
+  void ShaderProgram::Release()
+  {
+    glUseProgram(0);
+  }
+
+  GLint ShaderProgram::Uniform(const std::string& name)
+  {
+    std::map<std::string, GLint>::const_iterator it = uniforms_.find(name);
+    if (it != uniforms_.end())
+    {
+      return it->second;
+    }
+
+    GLint location = glGetUniformLocation(program_, name.c_str());
+    uniforms_[name] = location;
+    return location;
+  }
+
+  GLint ShaderProgram::Attribute(const std::string& name)
+  {
+    std::map<std::string, GLint>::const_iterator it = attributes_.find(name);
+    if (it != attributes_.end())
+    {
+      return it->second;
+    }
+
+    GLint location = glGetAttribLocation(program_, name.c_str());
+    attributes_[name] = location;
+    return location;
+  }
+
+  StreamBuffer::StreamBuffer(size_t capacity) :
+    buffer_(0),
+    capacity_(capacity),
+    head_(0),
+    allocated_(false)
+  {
+  }
+
+  StreamBuffer::~StreamBuffer()
+  {
+  }
+
+  void StreamBuffer::Allocate()
+  {
+    if (buffer_ == 0)
+    {
+      glGenBuffers(1, &buffer_);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    glBufferData(GL_ARRAY_BUFFER, capacity_, NULL, GL_STREAM_DRAW);
+    head_ = 0;
+    allocated_ = true;
+  }
+
+  void StreamBuffer::Destroy()
+  {
+    if (buffer_ != 0)
+    {
+      glDeleteBuffers(1, &buffer_);
+      buffer_ = 0;
+    }
+    allocated_ = false;
+  }
+
+  size_t StreamBuffer::Append(const void* data, size_t bytes)
+  {
+    if (bytes > capacity_)
+    {
+      while (capacity_ < bytes)
+      {
+        capacity_ *= 2;
+      }
+      allocated_ = false;
+    }
+
+    if (!allocated_)
+    {
+      Allocate();
+    }
+    else
+    {
+      glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+      if (head_ + bytes > capacity_)
+      {
+        // Orphan the storage; the driver keeps the old block around until the
+        // GPU is done with it and hands us a fresh one.
+        glBufferData(GL_ARRAY_BUFFER, capacity_, NULL, GL_STREAM_DRAW);
+        head_ = 0;
+      }
+    }
+
+    const size_t offset = head_;
+    void* dest = NULL;
+    if (GLEW_ARB_map_buffer_range)
+    {
+      // Nothing can be reading this range yet, so there's no need for the
+      // driver to synchronize.
+      dest = glMapBufferRange(GL_ARRAY_BUFFER, offset, bytes,
+          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+
+    if (dest)
+    {
+      std::memcpy(dest, data, bytes);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    else
+    {
+      glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
+    }
+
+    // Keep every batch aligned for whatever attribute types follow.
+    head_ += (bytes + 15) & ~static_cast<size_t>(15);
+
+    return offset;
+  }
+
+  void StreamBuffer::Reserve(size_t bytes)
+  {
+    if (bytes > capacity_)
+    {
+      while (capacity_ < bytes)
+      {
+        capacity_ *= 2;
+      }
+      allocated_ = false;
+    }
+
+    if (!allocated_)
+    {
+      Allocate();
+    }
+    else if (head_ + bytes > capacity_)
+    {
+      glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+      glBufferData(GL_ARRAY_BUFFER, capacity_, NULL, GL_STREAM_DRAW);
+      head_ = 0;
+    }
+  }
+
+  VertexBuffer::VertexBuffer() :
+    buffer_(0),
+    capacity_(0)
+  {
+  }
+
+  VertexBuffer::~VertexBuffer()
+  {
+  }
+
+  void VertexBuffer::Upload(const void* data, size_t bytes)
+  {
+    if (buffer_ == 0)
+    {
+      glGenBuffers(1, &buffer_);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+    capacity_ = bytes;
+  }
+
+  bool VertexBuffer::Reserve(size_t bytes)
+  {
+    if (buffer_ == 0)
+    {
+      glGenBuffers(1, &buffer_);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    if (bytes <= capacity_)
+    {
+      return false;
+    }
+
+    size_t capacity = capacity_ > 0 ? capacity_ : bytes;
+    while (capacity < bytes)
+    {
+      capacity *= 2;
+    }
+    glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STATIC_DRAW);
+    capacity_ = capacity;
+    return true;
+  }
+
+  void VertexBuffer::Update(size_t offset, const void* data, size_t bytes)
+  {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
+  }
+
+  void VertexBuffer::Destroy()
+  {
+    if (buffer_ != 0)
+    {
+      glDeleteBuffers(1, &buffer_);
+      buffer_ = 0;
+    }
+    capacity_ = 0;
+  }
+
+  Renderer::Renderer() :
+    initialized_(false),
+    shaders_supported_(false),
+    instancing_supported_(false),
+    beam_index_buffer_(0),
+    beam_index_count_(0),
+    draw_calls_(0),
+    vertices_(0)
+  {
+    // Meshes are listed as plain triangles or lines, so that copies of them
+    // can also be concatenated into one batch when placed on the CPU.
+    meshes_[MESH_DISC].mode = GL_TRIANGLES;
+    meshes_[MESH_DISC].first = 0;
+    for (int i = 0; i < DISC_SEGMENTS; i++)
+    {
+      const double start = 2.0 * M_PI * i / DISC_SEGMENTS;
+      const double end = 2.0 * M_PI * (i + 1) / DISC_SEGMENTS;
+      const float triangle[] = {
+          0.0f, 0.0f,
+          static_cast<float>(std::cos(start)), static_cast<float>(std::sin(start)),
+          static_cast<float>(std::cos(end)), static_cast<float>(std::sin(end))};
+      mesh_vertices_.insert(mesh_vertices_.end(), triangle, triangle + 6);
+    }
+    meshes_[MESH_DISC].count = mesh_vertices_.size() / 2 - meshes_[MESH_DISC].first;
+
+    meshes_[MESH_SQUARE].mode = GL_TRIANGLES;
+    meshes_[MESH_SQUARE].first = mesh_vertices_.size() / 2;
+    const float square[] = {
+        -0.5f, -0.5f,  0.5f, -0.5f,  0.5f, 0.5f,
+        -0.5f, -0.5f,  0.5f, 0.5f,  -0.5f, 0.5f};
+    mesh_vertices_.insert(mesh_vertices_.end(), square, square + 12);
+    meshes_[MESH_SQUARE].count = mesh_vertices_.size() / 2 - meshes_[MESH_SQUARE].first;
+
+    // The proportions arrows have always been drawn with
+    meshes_[MESH_ARROW].mode = GL_LINES;
+    meshes_[MESH_ARROW].first = mesh_vertices_.size() / 2;
+    const float arrow[] = {
+        0.0f, 0.0f,  1.0f, 0.0f,
+        1.0f, 0.0f,  0.75f, -0.2f,
+        1.0f, 0.0f,  0.75f, 0.2f};
+    mesh_vertices_.insert(mesh_vertices_.end(), arrow, arrow + 12);
+    meshes_[MESH_ARROW].count = mesh_vertices_.size() / 2 - meshes_[MESH_ARROW].first;
+
+    meshes_[MESH_CIRCLE].mode = GL_LINES;
+    meshes_[MESH_CIRCLE].first = mesh_vertices_.size() / 2;
+    for (int i = 0; i < DISC_SEGMENTS; i++)
+    {
+      const double start = 2.0 * M_PI * i / DISC_SEGMENTS;
+      const double end = 2.0 * M_PI * (i + 1) / DISC_SEGMENTS;
+      const float line[] = {
+          static_cast<float>(std::cos(start)), static_cast<float>(std::sin(start)),
+          static_cast<float>(std::cos(end)), static_cast<float>(std::sin(end))};
+      mesh_vertices_.insert(mesh_vertices_.end(), line, line + 4);
+    }
+    meshes_[MESH_CIRCLE].count = mesh_vertices_.size() / 2 - meshes_[MESH_CIRCLE].first;
+  }
+
+  Renderer::~Renderer()
+  {
+  }
+
+  bool Renderer::Initialize()
+  {
+    if (initialized_)
+    {
+      return true;
+    }
+
+    if (!GLEW_VERSION_1_5)
+    {
+      ROS_ERROR_ONCE("OpenGL 1.5 is required for vertex buffer objects.");
+      return false;
+    }
+
+    if (GLEW_VERSION_2_0)
+    {
+      colormap_program_.BindAttributeLocation("scalar", SCALAR_ATTRIBUTE);
+      beam_program_.BindAttributeLocation("beam", BEAM_INDEX_ATTRIBUTE);
+      beam_program_.BindAttributeLocation("range", BEAM_RANGE_ATTRIBUTE);
+      beam_program_.BindAttributeLocation("intensity", BEAM_INTENSITY_ATTRIBUTE);
+      instance_program_.BindAttributeLocation("mesh_vertex", MESH_VERTEX_ATTRIBUTE);
+      instance_program_.BindAttributeLocation("origin", INSTANCE_ORIGIN_ATTRIBUTE);
+      instance_program_.BindAttributeLocation("axes", INSTANCE_AXES_ATTRIBUTE);
+      instance_program_.BindAttributeLocation("color", INSTANCE_COLOR_ATTRIBUTE);
+
+      shaders_supported_ =
+          color_program_.Build(COLOR_VERTEX_SHADER, COLOR_FRAGMENT_SHADER) &&
+          texture_program_.Build(TEXTURE_VERTEX_SHADER, TEXTURE_FRAGMENT_SHADER) &&
+          colormap_program_.Build(COLORMAP_VERTEX_SHADER, COLORMAP_FRAGMENT_SHADER) &&
+          beam_program_.Build(BEAM_VERTEX_SHADER, COLORMAP_FRAGMENT_SHADER) &&
+          palette_program_.Build(TEXTURE_VERTEX_SHADER, PALETTE_FRAGMENT_SHADER);
+
+      if (!shaders_supported_)
+      {
+        ROS_WARN("Failed to build shaders, falling back to fixed-function rendering: %s",
+            (color_program_.Log() + texture_program_.Log() + colormap_program_.Log() +
+             beam_program_.Log() + palette_program_.Log()).c_str());
+        color_program_.Destroy();
+        texture_program_.Destroy();
+        colormap_program_.Destroy();
+        beam_program_.Destroy();
+        palette_program_.Destroy();
+      }
+      else if (GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced)
+      {
+        instancing_supported_ = instance_program_.Build(INSTANCE_VERTEX_SHADER, COLOR_FRAGMENT_SHADER);
+        if (instancing_supported_)
+        {
+          mesh_buffer_.Upload(&mesh_vertices_[0], mesh_vertices_.size() * sizeof(float));
+          glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        else
+        {
+          ROS_WARN("Failed to build the instancing shader, placing meshes on the CPU: %s",
+              instance_program_.Log().c_str());
+          instance_program_.Destroy();
+        }
+      }
+    }
+    else
+    {
+      ROS_WARN("GLSL is not supported, falling back to fixed-function rendering.");
+    }
+
+    initialized_ = true;
+    return true;
+  }
+
+  void Renderer::Destroy()
+  {
+    if (initialized_)
+    {
+      color_program_.Destroy();
+      texture_program_.Destroy();
+      colormap_program_.Destroy();
+      beam_program_.Destroy();
+      palette_program_.Destroy();
+      instance_program_.Destroy();
+      stream_.Destroy();
+      mesh_buffer_.Destroy();
+      if (beam_index_buffer_ != 0)
+      {
+        glDeleteBuffers(1, &beam_index_buffer_);
+        beam_index_buffer_ = 0;
+        beam_index_count_ = 0;
+      }
+      initialized_ = false;
+      shaders_supported_ = false;
+      instancing_supported_ = false;
+    }
+  }
+
+  size_t Renderer::Stream(const void* data, size_t bytes)
+  {
+    if (!Initialize())
+    {
+      return 0;
+    }
+
+    return stream_.Append(data, bytes);
+  }
+
+  void Renderer::Draw(GLenum mode, const ColorVertex* vertices, size_t count)
+  {
+    if (count == 0 || !Initialize())
+    {
+      return;
+    }
+
+    const size_t offset = stream_.Append(vertices, count * sizeof(ColorVertex));
+
+    if (shaders_supported_)
+    {
+      color_program_.Bind();
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(ColorVertex),
+        BufferOffset(offset + offsetof(ColorVertex, x)));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ColorVertex),
+        BufferOffset(offset + offsetof(ColorVertex, r)));
+
+    glDrawArrays(mode, 0, static_cast<GLsizei>(count));
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (shaders_supported_)
+    {
+      ShaderProgram::Release();
+    }
+
+    draw_calls_++;
+    vertices_ += count;
+  }
+
+  void Renderer::Draw(GLenum mode, ColorBatch& batch)
+  {
+    if (batch.Empty() || !Initialize())
+    {
+      return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, batch.Buffer());
+
+    if (shaders_supported_)
+    {
+      color_program_.Bind();
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(ColorVertex),
+        BufferOffset(offsetof(ColorVertex, x)));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ColorVertex),
+        BufferOffset(offsetof(ColorVertex, r)));
+
+    glDrawArrays(mode, 0, static_cast<GLsizei>(batch.Size()));
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (shaders_supported_)
+    {
+      ShaderProgram::Release();
+    }
+
+    draw_calls_++;
+    vertices_ += batch.Size();
+  }
+
+  void Renderer::DrawInstances(InstanceMesh mesh, InstanceBatch& instances, float scale,
+      size_t first)
+  {
+    if (first >= instances.Size() || !Initialize())
+    {
+      return;
+    }
+
+    const size_t count = instances.Size() - first;
+    if (instancing_supported_)
+    {
+      DrawInstances(mesh, instances.Buffer(), first * sizeof(Instance), NULL, count, scale);
+    }
+    else
+    {
+      DrawInstances(mesh, 0, 0, &instances.Data()[first], count, scale);
+    }
+  }
+
+  void Renderer::DrawInstances(InstanceMesh mesh, const std::vector<Instance>& instances,
+      float scale)
+  {
+    if (instances.empty() || !Initialize())
+    {
+      return;
+    }
+
+    if (instancing_supported_)
+    {
+      const size_t offset = stream_.Append(&instances[0], instances.size() * sizeof(Instance));
+      DrawInstances(mesh, stream_.Id(), offset, NULL, instances.size(), scale);
+    }
+    else
+    {
+      DrawInstances(mesh, 0, 0, &instances[0], instances.size(), scale);
+    }
+  }
+
+  void Renderer::DrawInstances(InstanceMesh mesh, GLuint buffer, size_t offset,
+      const Instance* instances, size_t count, float scale)
+  {
+    const Mesh& shape = meshes_[mesh];
+
+    if (instances)
+    {
+      // Without instancing, every copy of the mesh is placed here and the
+      // whole lot goes out as one ordinary batch.
+      color_scratch_.resize(count * shape.count);
+      ColorVertex* vertex = color_scratch_.empty() ? NULL : &color_scratch_[0];
+      for (size_t i = 0; i < count; i++)
+      {
+        const Instance& instance = instances[i];
+        const float* mesh_vertex = &mesh_vertices_[shape.first * 2];
+        for (size_t j = 0; j < shape.count; j++, mesh_vertex += 2, vertex++)
+        {
+          const float mesh_x = mesh_vertex[0] * scale;
+          const float mesh_y = mesh_vertex[1] * scale;
+          *vertex = ColorVertex(
+              instance.x + mesh_x * instance.x_axis_x + mesh_y * instance.y_axis_x,
+              instance.y + mesh_x * instance.x_axis_y + mesh_y * instance.y_axis_y,
+              instance.r, instance.g, instance.b, instance.a);
+        }
+      }
+      Draw(shape.mode, color_scratch_);
+      return;
+    }
+
+    instance_program_.Bind();
+    glUniform1f(instance_program_.Uniform("mesh_scale"), scale);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer_.Id());
+    glEnableVertexAttribArray(MESH_VERTEX_ATTRIBUTE);
+    glVertexAttribPointer(MESH_VERTEX_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, 0,
+        BufferOffset(shape.first * 2 * sizeof(float)));
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(INSTANCE_ORIGIN_ATTRIBUTE);
+    glEnableVertexAttribArray(INSTANCE_AXES_ATTRIBUTE);
+    glEnableVertexAttribArray(INSTANCE_COLOR_ATTRIBUTE);
+    glVertexAttribPointer(INSTANCE_ORIGIN_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, sizeof(Instance),
+        BufferOffset(offset + offsetof(Instance, x)));
+    glVertexAttribPointer(INSTANCE_AXES_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+        BufferOffset(offset + offsetof(Instance, x_axis_x)));
+    glVertexAttribPointer(INSTANCE_COLOR_ATTRIBUTE, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance),
+        BufferOffset(offset + offsetof(Instance, r)));
+    glVertexAttribDivisorARB(INSTANCE_ORIGIN_ATTRIBUTE, 1);
+    glVertexAttribDivisorARB(INSTANCE_AXES_ATTRIBUTE, 1);
+    glVertexAttribDivisorARB(INSTANCE_COLOR_ATTRIBUTE, 1);
+
+    glDrawArraysInstancedARB(shape.mode, 0, static_cast<GLsizei>(shape.count),
+        static_cast<GLsizei>(count));
+
+    // Divisors aren't part of any other state that gets reset, so they'd
+    // leak into the next draw that uses these attributes.
+    glVertexAttribDivisorARB(INSTANCE_ORIGIN_ATTRIBUTE, 0);
+    glVertexAttribDivisorARB(INSTANCE_AXES_ATTRIBUTE, 0);
+    glVertexAttribDivisorARB(INSTANCE_COLOR_ATTRIBUTE, 0);
+    glDisableVertexAttribArray(MESH_VERTEX_ATTRIBUTE);
+    glDisableVertexAttribArray(INSTANCE_ORIGIN_ATTRIBUTE);
+    glDisableVertexAttribArray(INSTANCE_AXES_ATTRIBUTE);
+    glDisableVertexAttribArray(INSTANCE_COLOR_ATTRIBUTE);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ShaderProgram::Release();
+
+    draw_calls_++;
+    vertices_ += count * shape.count;
+  }
+
+  void Renderer::DrawPoints(const std::vector<ColorVertex>& vertices, float size)
+  {
+    glPointSize(size);
+    Draw(GL_POINTS, vertices);
+  }
+
+  void Renderer::DrawLines(const std::vector<ColorVertex>& vertices, float width)
+  {
+    glLineWidth(width);
+    Draw(GL_LINES, vertices);
+  }
+
+  void Renderer::DrawLineStrip(const std::vector<ColorVertex>& vertices, float width)
+  {
+    glLineWidth(width);
+    Draw(GL_LINE_STRIP, vertices);
+  }
+
+  void Renderer::DrawTriangles(const std::vector<ColorVertex>& vertices)
+  {
+    Draw(GL_TRIANGLES, vertices);
+  }
+
+  void Renderer::DrawTexturedQuads(
+      GLuint texture,
+      const std::vector<TexturedVertex>& vertices,
+      const QColor& color)
+  {
+    DrawQuads(texture, vertices, color, NULL);
+  }
+
+  void Renderer::DrawTexturedQuads(
+      GLuint texture,
+      const std::vector<ColorTexturedVertex>& vertices)
+  {
+    const size_t quads = vertices.size() / 4;
+    if (quads == 0 || !Initialize())
+    {
+      return;
+    }
+
+    color_quad_scratch_.clear();
+    color_quad_scratch_.reserve(quads * 6);
+    for (size_t i = 0; i < quads * 4; i += 4)
+    {
+      color_quad_scratch_.push_back(vertices[i]);
+      color_quad_scratch_.push_back(vertices[i + 1]);
+      color_quad_scratch_.push_back(vertices[i + 2]);
+      color_quad_scratch_.push_back(vertices[i]);
+      color_quad_scratch_.push_back(vertices[i + 2]);
+      color_quad_scratch_.push_back(vertices[i + 3]);
+    }
+
+    const size_t offset = stream_.Append(
+        &color_quad_scratch_[0], color_quad_scratch_.size() * sizeof(ColorTexturedVertex));
+
+    if (shaders_supported_)
+    {
+      texture_program_.Bind();
+      glUniform1i(texture_program_.Uniform("image"), 0);
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(ColorTexturedVertex),
+        BufferOffset(offset + offsetof(ColorTexturedVertex, x)));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(ColorTexturedVertex),
+        BufferOffset(offset + offsetof(ColorTexturedVertex, u)));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ColorTexturedVertex),
+        BufferOffset(offset + offsetof(ColorTexturedVertex, r)));
+
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(color_quad_scratch_.size()));
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+
+    if (shaders_supported_)
+    {
+      ShaderProgram::Release();
+    }
+
+    draw_calls_++;
+    vertices_ += color_quad_scratch_.size();
+  }
+
+  bool Renderer::DrawPaletteQuads(
+      GLuint indices,
+      const std::vector<TexturedVertex>& vertices,
+      Colormap& palette,
+      const QColor& color)
+  {
+    if (!Initialize() || !shaders_supported_)
+    {
+      return false;
+    }
+
+    DrawQuads(indices, vertices, color, &palette);
+    return true;
+  }
+
+  void Renderer::DrawQuads(
+      GLuint texture,
+      const std::vector<TexturedVertex>& vertices,
+      const QColor& color,
+      Colormap* palette)
+  {
+    const size_t quads = vertices.size() / 4;
+    if (quads == 0 || !Initialize())
+    {
+      return;
+    }
+
+    // Split each quad into two triangles so that a single draw call covers
+    // every quad in the batch.
+    quad_scratch_.clear();
+    quad_scratch_.reserve(quads * 6);
+    for (size_t i = 0; i < quads * 4; i += 4)
+    {
+      quad_scratch_.push_back(vertices[i]);
+      quad_scratch_.push_back(vertices[i + 1]);
+      quad_scratch_.push_back(vertices[i + 2]);
+      quad_scratch_.push_back(vertices[i]);
+      quad_scratch_.push_back(vertices[i + 2]);
+      quad_scratch_.push_back(vertices[i + 3]);
+    }
+
+    const size_t offset = stream_.Append(
+        &quad_scratch_[0], quad_scratch_.size() * sizeof(TexturedVertex));
+
+    if (palette)
+    {
+      palette_program_.Bind();
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_1D, palette->Texture());
+      glUniform1i(palette_program_.Uniform("palette"), 1);
+      glUniform1i(palette_program_.Uniform("indices"), 0);
+    }
+    else if (shaders_supported_)
+    {
+      texture_program_.Bind();
+      glUniform1i(texture_program_.Uniform("image"), 0);
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glColor4ub(color.red(), color.green(), color.blue(), color.alpha());
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(TexturedVertex),
+        BufferOffset(offset + offsetof(TexturedVertex, x)));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(TexturedVertex),
+        BufferOffset(offset + offsetof(TexturedVertex, u)));
+
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(quad_scratch_.size()));
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+
+    if (palette)
+    {
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_1D, 0);
+      glActiveTexture(GL_TEXTURE0);
+    }
+
+    if (shaders_supported_)
+    {
+      ShaderProgram::Release();
+    }
+
+    draw_calls_++;
+    vertices_ += quad_scratch_.size();
+  }
+
+  bool Renderer::BeginColormap(Colormap& colormap, float alpha)
+  {
+    if (!Initialize() || !shaders_supported_)
+    {
+      return false;
+    }
+
+    colormap_program_.Bind();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_1D, colormap.Texture());
+    glUniform1i(colormap_program_.Uniform("colormap"), 0);
+    glUniform1f(colormap_program_.Uniform("value_min"), colormap.Min());
+    glUniform1f(colormap_program_.Uniform("value_max"), colormap.Max());
+    glUniform1f(colormap_program_.Uniform("alpha"), alpha);
+
+    return true;
+  }
+
+  void Renderer::EndColormap()
+  {
+    glBindTexture(GL_TEXTURE_1D, 0);
+    ShaderProgram::Release();
+  }
+
+  void Renderer::DrawScalar(GLenum mode, const std::vector<ScalarVertex>& vertices,
+      Colormap& colormap, float alpha)
+  {
+    if (vertices.empty() || !Initialize())
+    {
+      return;
+    }
+
+    if (!shaders_supported_)
+    {
+      const uint8_t alpha_byte = static_cast<uint8_t>(std::max(0.0f, std::min(alpha, 1.0f)) * 255.0f);
+      color_scratch_.resize(vertices.size());
+      for (size_t i = 0; i < vertices.size(); i++)
+      {
+        ColorVertex& vertex = color_scratch_[i];
+        vertex.x = vertices[i].x;
+        vertex.y = vertices[i].y;
+        colormap.Lookup(vertices[i].value, &vertex.r);
+        vertex.a = alpha_byte;
+      }
+      Draw(mode, color_scratch_);
+      return;
+    }
+
+    const size_t offset = stream_.Append(&vertices[0], vertices.size() * sizeof(ScalarVertex));
+
+    BeginColormap(colormap, alpha);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableVertexAttribArray(SCALAR_ATTRIBUTE);
+    glVertexPointer(2, GL_FLOAT, sizeof(ScalarVertex),
+        BufferOffset(offset + offsetof(ScalarVertex, x)));
+    glVertexAttribPointer(SCALAR_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, sizeof(ScalarVertex),
+        BufferOffset(offset + offsetof(ScalarVertex, value)));
+
+    glDrawArrays(mode, 0, static_cast<GLsizei>(vertices.size()));
+
+    glDisableVertexAttribArray(SCALAR_ATTRIBUTE);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    EndColormap();
+
+    draw_calls_++;
+    vertices_ += vertices.size();
+  }
+
+  void Renderer::DrawScalarPoints(const std::vector<ScalarVertex>& vertices,
+      Colormap& colormap, float alpha, float size)
+  {
+    glPointSize(size);
+    DrawScalar(GL_POINTS, vertices, colormap, alpha);
+  }
+
+  void Renderer::DrawScalar(GLenum mode, const float* xy, const float* values,
+      size_t value_stride, size_t count, Colormap& colormap, float alpha)
+  {
+    if (count == 0 || !Initialize())
+    {
+      return;
+    }
+
+    if (!shaders_supported_)
+    {
+      const uint8_t alpha_byte = static_cast<uint8_t>(std::max(0.0f, std::min(alpha, 1.0f)) * 255.0f);
+      color_scratch_.resize(count);
+      for (size_t i = 0; i < count; i++)
+      {
+        ColorVertex& vertex = color_scratch_[i];
+        vertex.x = xy[i * 2];
+        vertex.y = xy[i * 2 + 1];
+        colormap.Lookup(values[i * value_stride], &vertex.r);
+        vertex.a = alpha_byte;
+      }
+      Draw(mode, color_scratch_);
+      return;
+    }
+
+    const size_t xy_bytes = count * 2 * sizeof(float);
+    const size_t value_bytes = ((count - 1) * value_stride + 1) * sizeof(float);
+    stream_.Reserve(((xy_bytes + 15) & ~static_cast<size_t>(15)) + value_bytes);
+    const size_t xy_offset = stream_.Append(xy, xy_bytes);
+    const size_t value_offset = stream_.Append(values, value_bytes);
+
+    BeginColormap(colormap, alpha);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableVertexAttribArray(SCALAR_ATTRIBUTE);
+    glVertexPointer(2, GL_FLOAT, 0, BufferOffset(xy_offset));
+    glVertexAttribPointer(SCALAR_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE,
+        static_cast<GLsizei>(value_stride * sizeof(float)), BufferOffset(value_offset));
+
+    glDrawArrays(mode, 0, static_cast<GLsizei>(count));
+
+    glDisableVertexAttribArray(SCALAR_ATTRIBUTE);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    EndColormap();
+
+    draw_calls_++;
+    vertices_ += count;
+  }
+
+  void Renderer::DrawScalarPoints(const float* xy, const float* values,
+      size_t value_stride, size_t count, Colormap& colormap, float alpha,
+      float size)
+  {
+    glPointSize(size);
+    DrawScalar(GL_POINTS, xy, values, value_stride, count, colormap, alpha);
+  }
+
+  bool Renderer::DrawBeams(const BeamScan& scan, const tf::Transform& transform,
+      BeamValue value, float constant_value, Colormap& colormap,
+      float alpha, float size)
+  {
+    if (!Initialize() || !shaders_supported_)
+    {
+      return false;
+    }
+
+    if (scan.count == 0)
+    {
+      return true;
+    }
+
+    if (beam_index_count_ < scan.count)
+    {
+      // Indices are shared by every scan, so they're only uploaded when a
+      // scan comes along with more beams than any before it.
+      std::vector<float> indices(std::max(scan.count, beam_index_count_ * 2));
+      for (size_t i = 0; i < indices.size(); i++)
+      {
+        indices[i] = static_cast<float>(i);
+      }
+      if (beam_index_buffer_ == 0)
+      {
+        glGenBuffers(1, &beam_index_buffer_);
+      }
+      glBindBuffer(GL_ARRAY_BUFFER, beam_index_buffer_);
+      glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(float), &indices[0], GL_STATIC_DRAW);
+      beam_index_count_ = indices.size();
+    }
+
+    const size_t bytes = scan.count * sizeof(float);
+    stream_.Reserve(scan.intensities ? ((bytes + 15) & ~static_cast<size_t>(15)) + bytes : bytes);
+    const size_t range_offset = stream_.Append(scan.ranges, bytes);
+    const size_t intensity_offset = scan.intensities ? stream_.Append(scan.intensities, bytes) : 0;
+
+    PushTransform(transform);
+
+    const tf::Matrix3x3& basis = transform.getBasis();
+    beam_program_.Bind();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_1D, colormap.Texture());
+    glUniform1i(beam_program_.Uniform("colormap"), 0);
+    glUniform1f(beam_program_.Uniform("value_min"), colormap.Min());
+    glUniform1f(beam_program_.Uniform("value_max"), colormap.Max());
+    glUniform1f(beam_program_.Uniform("alpha"), alpha);
+    glUniform1f(beam_program_.Uniform("angle_min"), scan.angle_min);
+    glUniform1f(beam_program_.Uniform("angle_increment"), scan.angle_increment);
+    glUniform1f(beam_program_.Uniform("range_min"), scan.range_min);
+    glUniform1f(beam_program_.Uniform("range_max"), scan.range_max);
+    glUniform1i(beam_program_.Uniform("value_source"), static_cast<GLint>(value));
+    glUniform1f(beam_program_.Uniform("constant_value"), constant_value);
+    glUniform4f(beam_program_.Uniform("z_row"),
+        basis[2][0], basis[2][1], basis[2][2], transform.getOrigin().z());
+
+    glBindBuffer(GL_ARRAY_BUFFER, beam_index_buffer_);
+    glEnableVertexAttribArray(BEAM_INDEX_ATTRIBUTE);
+    glVertexAttribPointer(BEAM_INDEX_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, 0, BufferOffset(0));
+
+    glBindBuffer(GL_ARRAY_BUFFER, stream_.Id());
+    glEnableVertexAttribArray(BEAM_RANGE_ATTRIBUTE);
+    glVertexAttribPointer(BEAM_RANGE_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, 0, BufferOffset(range_offset));
+    if (scan.intensities)
+    {
+      glEnableVertexAttribArray(BEAM_INTENSITY_ATTRIBUTE);
+      glVertexAttribPointer(BEAM_INTENSITY_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, 0,
+          BufferOffset(intensity_offset));
+    }
+    else
+    {
+      glVertexAttrib1f(BEAM_INTENSITY_ATTRIBUTE, constant_value);
+    }
+
+    glPointSize(size);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(scan.count));
+
+    glDisableVertexAttribArray(BEAM_INDEX_ATTRIBUTE);
+    glDisableVertexAttribArray(BEAM_RANGE_ATTRIBUTE);
+    glDisableVertexAttribArray(BEAM_INTENSITY_ATTRIBUTE);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    EndColormap();
+
+    PopTransform();
+
+    draw_calls_++;
+    vertices_ += scan.count;
+    return true;
+  }
+
+  void Renderer::PushTransform(const tf::Transform& transform)
+  {
+    double matrix[16];
+    transform.getOpenGLMatrix(matrix);
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glMultMatrixd(matrix);
+  }
+
+  void Renderer::PopTransform()
+  {
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+  }
+
+  void Renderer::ResetStatistics()
+  {
+    draw_calls_ = 0;
+    vertices_ = 0;
+  }
+}
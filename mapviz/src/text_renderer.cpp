@@ -0,0 +1,435 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <mapviz/text_renderer.h>
+
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+
+// QT libraries
+#include <QFontMetricsF>
+#include <QImage>
+#include <QPainter>
+#include <QVector>
+
+namespace mapviz
+{
+  namespace
+  {
+    // Transparent border around each glyph so neighbours don't bleed into it
+    const int GLYPH_PADDING = 1;
+
+    inline int64_t CellKey(int x, int y)
+    {
+      return (static_cast<int64_t>(x) << 32) | static_cast<uint32_t>(y);
+    }
+  }
+
+  TextRenderer::TextRenderer() :
+    generation_(0),
+    shelf_x_(0),
+    shelf_y_(0),
+    shelf_height_(0),
+    dirty_top_(0),
+    dirty_bottom_(0),
+    texture_(0),
+    vertices_generation_(0)
+  {
+    std::fill(modelview_, modelview_ + 16, 0.0);
+    std::fill(projection_, projection_ + 16, 0.0);
+    std::fill(viewport_, viewport_ + 4, 0);
+    ResetAtlas();
+  }
+
+  TextRenderer::~TextRenderer()
+  {
+    // The texture can't be released here because there may be no current
+    // context; owners call Destroy() from their plugin's Shutdown().
+  }
+
+  void TextRenderer::Destroy()
+  {
+    if (texture_ != 0)
+    {
+      glDeleteTextures(1, &texture_);
+      texture_ = 0;
+    }
+  }
+
+  void TextRenderer::ResetAtlas()
+  {
+    glyphs_.clear();
+    atlas_.resize(ATLAS_SIZE * ATLAS_SIZE * 2);
+    for (size_t i = 0; i < atlas_.size(); i += 2)
+    {
+      atlas_[i] = 255;
+      atlas_[i + 1] = 0;
+    }
+    generation_++;
+    shelf_x_ = 0;
+    shelf_y_ = 0;
+    shelf_height_ = 0;
+    dirty_top_ = 0;
+    dirty_bottom_ = ATLAS_SIZE;
+  }
+
+  const TextRenderer::Glyph& TextRenderer::GetGlyph(
+      const QFont& font,
+      const QString& font_key,
+      uint32_t code_point)
+  {
+    const std::pair<QString, uint32_t> key(font_key, code_point);
+    std::map<std::pair<QString, uint32_t>, Glyph>::const_iterator existing = glyphs_.find(key);
+    if (existing != glyphs_.end())
+    {
+      return existing->second;
+    }
+
+    const uint ucs4 = code_point;
+    const QString character = QString::fromUcs4(&ucs4, 1);
+    QFontMetricsF metrics(font);
+
+    Glyph glyph = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    glyph.advance = metrics.width(character);
+
+    // Bounds are relative to the pen position on the baseline
+    const QRect bounds = metrics.boundingRect(character).toAlignedRect();
+    const int width = bounds.width() + 2 * GLYPH_PADDING;
+    const int height = bounds.height() + 2 * GLYPH_PADDING;
+    if (bounds.isEmpty() || width > ATLAS_SIZE || height > ATLAS_SIZE)
+    {
+      // Whitespace, or too large to ever fit; it only moves the pen.
+      return glyphs_.insert(std::make_pair(key, glyph)).first->second;
+    }
+
+    if (shelf_x_ + width > ATLAS_SIZE)
+    {
+      shelf_y_ += shelf_height_;
+      shelf_x_ = 0;
+      shelf_height_ = 0;
+    }
+    if (shelf_y_ + height > ATLAS_SIZE)
+    {
+      // Start over rather than evicting individual glyphs; existing layouts
+      // see the new generation and are laid out again.
+      ResetAtlas();
+    }
+
+    QImage image(width, height, QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    {
+      QPainter painter(&image);
+      painter.setFont(font);
+      painter.setPen(Qt::white);
+      painter.drawText(
+          QPointF(GLYPH_PADDING - bounds.left(), GLYPH_PADDING - bounds.top()),
+          character);
+    }
+
+    for (int y = 0; y < height; y++)
+    {
+      const QRgb* row = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+      uint8_t* texel = &atlas_[((shelf_y_ + y) * ATLAS_SIZE + shelf_x_) * 2];
+      for (int x = 0; x < width; x++)
+      {
+        texel[x * 2 + 1] = static_cast<uint8_t>(qAlpha(row[x]));
+      }
+    }
+
+    glyph.u0 = static_cast<float>(shelf_x_) / ATLAS_SIZE;
+    glyph.v0 = static_cast<float>(shelf_y_) / ATLAS_SIZE;
+    glyph.u1 = static_cast<float>(shelf_x_ + width) / ATLAS_SIZE;
+    glyph.v1 = static_cast<float>(shelf_y_ + height) / ATLAS_SIZE;
+    glyph.left = bounds.left() - GLYPH_PADDING;
+    glyph.top = bounds.top() - GLYPH_PADDING;
+    glyph.width = width;
+    glyph.height = height;
+
+    dirty_top_ = std::min(dirty_top_, shelf_y_);
+    dirty_bottom_ = std::max(dirty_bottom_, shelf_y_ + height);
+
+    shelf_x_ += width;
+    shelf_height_ = std::max(shelf_height_, height);
+
+    return glyphs_.insert(std::make_pair(key, glyph)).first->second;
+  }
+
+  TextRenderer::LayoutPtr TextRenderer::GetLayout(const QString& text, const QFont& font)
+  {
+    const QString font_key = font.key();
+    const QFontMetricsF metrics(font);
+    const QVector<uint> code_points = text.toUcs4();
+
+    boost::shared_ptr<Layout> layout(new Layout);
+
+    // If the atlas fills up partway through, the glyphs placed before it was
+    // started over are gone, so lay the whole string out again.  A single
+    // string can't fill an empty atlas, so one retry is enough.
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+      layout->generation = generation_;
+      layout->width = 0;
+      layout->quads.clear();
+      layout->quads.reserve(code_points.size() * 4);
+
+      float pen_x = 0;
+      float baseline = metrics.ascent();
+      int lines = 1;
+      for (int i = 0; i < code_points.size(); i++)
+      {
+        if (code_points[i] == '\n')
+        {
+          pen_x = 0;
+          baseline += metrics.lineSpacing();
+          lines++;
+          continue;
+        }
+
+        const Glyph& glyph = GetGlyph(font, font_key, code_points[i]);
+        if (glyph.width > 0)
+        {
+          const float x0 = pen_x + glyph.left;
+          const float y0 = baseline + glyph.top;
+          const float x1 = x0 + glyph.width;
+          const float y1 = y0 + glyph.height;
+          layout->quads.push_back(TexturedVertex(x0, y0, glyph.u0, glyph.v0));
+          layout->quads.push_back(TexturedVertex(x1, y0, glyph.u1, glyph.v0));
+          layout->quads.push_back(TexturedVertex(x1, y1, glyph.u1, glyph.v1));
+          layout->quads.push_back(TexturedVertex(x0, y1, glyph.u0, glyph.v1));
+        }
+        pen_x += glyph.advance;
+        layout->width = std::max(layout->width, pen_x);
+      }
+      layout->height = metrics.height() + (lines - 1) * metrics.lineSpacing();
+
+      if (layout->generation == generation_)
+      {
+        break;
+      }
+    }
+
+    return layout;
+  }
+
+  bool TextRenderer::IsCurrent(const LayoutPtr& layout) const
+  {
+    return layout && layout->generation == generation_;
+  }
+
+  void TextRenderer::Begin()
+  {
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview_);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection_);
+    glGetIntegerv(GL_VIEWPORT, viewport_);
+
+    vertices_.clear();
+    rects_.clear();
+    cells_.clear();
+  }
+
+  bool TextRenderer::Project(double x, double y, float& window_x, float& window_y) const
+  {
+    // Matrices are column-major; z is always 0 in the map.
+    double eye[4];
+    for (int row = 0; row < 4; row++)
+    {
+      eye[row] = modelview_[row] * x + modelview_[4 + row] * y + modelview_[12 + row];
+    }
+
+    double clip[4];
+    for (int row = 0; row < 4; row++)
+    {
+      clip[row] = projection_[row] * eye[0] +
+                  projection_[4 + row] * eye[1] +
+                  projection_[8 + row] * eye[2] +
+                  projection_[12 + row] * eye[3];
+    }
+    if (clip[3] <= 0.0)
+    {
+      return false;
+    }
+
+    window_x = static_cast<float>((clip[0] / clip[3] + 1.0) * 0.5 * viewport_[2]);
+    window_y = static_cast<float>((1.0 - clip[1] / clip[3]) * 0.5 * viewport_[3]);
+    return true;
+  }
+
+  bool TextRenderer::Add(
+      const LayoutPtr& layout,
+      float left,
+      float top,
+      const QColor& color,
+      bool declutter)
+  {
+    if (!IsCurrent(layout) || layout->quads.empty())
+    {
+      return false;
+    }
+
+    // Snap to whole pixels so that texels map one to one.
+    left = std::floor(left + 0.5f);
+    top = std::floor(top + 0.5f);
+
+    Rect rect = {left, top, left + layout->width, top + layout->height};
+    if (rect.right < 0 || rect.bottom < 0 ||
+        rect.left > viewport_[2] || rect.top > viewport_[3])
+    {
+      return false;
+    }
+
+    if (vertices_generation_ != generation_)
+    {
+      vertices_.clear();
+      vertices_generation_ = generation_;
+    }
+
+    if (declutter)
+    {
+      if (Overlaps(rect))
+      {
+        return false;
+      }
+      Insert(rect);
+    }
+
+    for (size_t i = 0; i < layout->quads.size(); i++)
+    {
+      const TexturedVertex& vertex = layout->quads[i];
+      vertices_.push_back(ColorTexturedVertex(
+          left + vertex.x, top + vertex.y, vertex.u, vertex.v, color));
+    }
+
+    return true;
+  }
+
+  bool TextRenderer::Overlaps(const Rect& rect) const
+  {
+    const int x0 = static_cast<int>(std::floor(rect.left / CELL_SIZE));
+    const int x1 = static_cast<int>(std::floor(rect.right / CELL_SIZE));
+    const int y0 = static_cast<int>(std::floor(rect.top / CELL_SIZE));
+    const int y1 = static_cast<int>(std::floor(rect.bottom / CELL_SIZE));
+    for (int x = x0; x <= x1; x++)
+    {
+      for (int y = y0; y <= y1; y++)
+      {
+        std::unordered_map<int64_t, std::vector<size_t> >::const_iterator cell =
+            cells_.find(CellKey(x, y));
+        if (cell == cells_.end())
+        {
+          continue;
+        }
+
+        for (size_t i = 0; i < cell->second.size(); i++)
+        {
+          const Rect& other = rects_[cell->second[i]];
+          if (rect.left < other.right && other.left < rect.right &&
+              rect.top < other.bottom && other.top < rect.bottom)
+          {
+            return true;
+          }
+        }
+      }
+    }
+
+    return false;
+  }
+
+  void TextRenderer::Insert(const Rect& rect)
+  {
+    const size_t index = rects_.size();
+    rects_.push_back(rect);
+
+    const int x0 = static_cast<int>(std::floor(rect.left / CELL_SIZE));
+    const int x1 = static_cast<int>(std::floor(rect.right / CELL_SIZE));
+    const int y0 = static_cast<int>(std::floor(rect.top / CELL_SIZE));
+    const int y1 = static_cast<int>(std::floor(rect.bottom / CELL_SIZE));
+    for (int x = x0; x <= x1; x++)
+    {
+      for (int y = y0; y <= y1; y++)
+      {
+        cells_[CellKey(x, y)].push_back(index);
+      }
+    }
+  }
+
+  void TextRenderer::Draw(Renderer& renderer)
+  {
+    if (vertices_.empty())
+    {
+      return;
+    }
+
+    if (texture_ == 0)
+    {
+      glGenTextures(1, &texture_);
+      glBindTexture(GL_TEXTURE_2D, texture_);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8_ALPHA8, ATLAS_SIZE, ATLAS_SIZE, 0,
+                   GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, &atlas_[0]);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      dirty_top_ = ATLAS_SIZE;
+      dirty_bottom_ = 0;
+    }
+    else if (dirty_bottom_ > dirty_top_)
+    {
+      // Only the shelves that gained glyphs since the last frame are sent.
+      glBindTexture(GL_TEXTURE_2D, texture_);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, dirty_top_, ATLAS_SIZE, dirty_bottom_ - dirty_top_,
+                      GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, &atlas_[dirty_top_ * ATLAS_SIZE * 2]);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      dirty_top_ = ATLAS_SIZE;
+      dirty_bottom_ = 0;
+    }
+
+    // Labels are positioned in window pixels.  The scene's matrices were
+    // captured in Begin(), so they're reloaded afterwards instead of pushed,
+    // which keeps clear of the shallow projection stack.
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, viewport_[2], viewport_[3], 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    renderer.DrawTexturedQuads(texture_, vertices_);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixd(projection_);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixd(modelview_);
+
+    vertices_.clear();
+  }
+}
@@ -0,0 +1,284 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+/**
+ * Compares the throughput of PointCloud2Decoder with the per-point decoding
+ * that PointCloud2Plugin used to do, on synthetic clouds with a few common
+ * layouts.  Build with -DMAPVIZ_BUILD_BENCHMARKS=ON and run:
+ *
+ *   pointcloud2_decoder_benchmark [points] [iterations]
+ */
+
+// C++ standard libraries
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// ROS libraries
+#include <sensor_msgs/PointCloud2.h>
+#include <tf/transform_datatypes.h>
+
+#include <mapviz_plugins/pointcloud2_decoder.h>
+
+namespace
+{
+  struct Layout
+  {
+    std::string name;
+    uint32_t point_step;
+    std::vector<sensor_msgs::PointField> fields;
+    std::string value_field;
+  };
+
+  sensor_msgs::PointField Field(const std::string& name, uint32_t offset, uint8_t datatype)
+  {
+    sensor_msgs::PointField field;
+    field.name = name;
+    field.offset = offset;
+    field.datatype = datatype;
+    field.count = 1;
+    return field;
+  }
+
+  std::vector<Layout> Layouts()
+  {
+    const uint8_t F32 = sensor_msgs::PointField::FLOAT32;
+    const uint8_t U32 = sensor_msgs::PointField::UINT32;
+    const uint8_t U16 = sensor_msgs::PointField::UINT16;
+    const uint8_t U8 = sensor_msgs::PointField::UINT8;
+
+    std::vector<Layout> layouts;
+
+    Layout xyz;
+    xyz.name = "xyz, step 16";
+    xyz.point_step = 16;
+    xyz.fields.push_back(Field("x", 0, F32));
+    xyz.fields.push_back(Field("y", 4, F32));
+    xyz.fields.push_back(Field("z", 8, F32));
+    xyz.value_field = "z";
+    layouts.push_back(xyz);
+
+    Layout xyzi;
+    xyzi.name = "PCL xyzi, step 32";
+    xyzi.point_step = 32;
+    xyzi.fields.push_back(Field("x", 0, F32));
+    xyzi.fields.push_back(Field("y", 4, F32));
+    xyzi.fields.push_back(Field("z", 8, F32));
+    xyzi.fields.push_back(Field("intensity", 16, F32));
+    xyzi.value_field = "intensity";
+    layouts.push_back(xyzi);
+
+    Layout ouster;
+    ouster.name = "Ouster, step 48";
+    ouster.point_step = 48;
+    ouster.fields.push_back(Field("x", 0, F32));
+    ouster.fields.push_back(Field("y", 4, F32));
+    ouster.fields.push_back(Field("z", 8, F32));
+    ouster.fields.push_back(Field("intensity", 16, F32));
+    ouster.fields.push_back(Field("t", 20, U32));
+    ouster.fields.push_back(Field("reflectivity", 24, U16));
+    ouster.fields.push_back(Field("ring", 26, U8));
+    ouster.fields.push_back(Field("ambient", 28, U16));
+    ouster.fields.push_back(Field("range", 32, U32));
+    ouster.value_field = "reflectivity";
+    layouts.push_back(ouster);
+
+    Layout generic;
+    generic.name = "zyx + intensity, step 20";
+    generic.point_step = 20;
+    generic.fields.push_back(Field("z", 0, F32));
+    generic.fields.push_back(Field("y", 4, F32));
+    generic.fields.push_back(Field("x", 8, F32));
+    generic.fields.push_back(Field("intensity", 12, F32));
+    generic.value_field = "intensity";
+    layouts.push_back(generic);
+
+    return layouts;
+  }
+
+  sensor_msgs::PointCloud2 MakeCloud(const Layout& layout, size_t points)
+  {
+    sensor_msgs::PointCloud2 cloud;
+    cloud.height = 1;
+    cloud.width = points;
+    cloud.fields = layout.fields;
+    cloud.is_bigendian = false;
+    cloud.point_step = layout.point_step;
+    cloud.row_step = layout.point_step * points;
+    cloud.is_dense = true;
+    cloud.data.resize(cloud.row_step);
+    for (size_t i = 0; i < cloud.data.size(); i++)
+    {
+      cloud.data[i] = static_cast<uint8_t>(std::rand());
+    }
+    return cloud;
+  }
+
+  // What PointCloud2Plugin::PointCloud2Callback did before the decoder.
+  struct StampedPoint
+  {
+    tf::Point point;
+    std::vector<float> features;
+  };
+
+  float PointFeature(const uint8_t* data, const sensor_msgs::PointField& field)
+  {
+    switch (field.datatype)
+    {
+      case 1:
+        return *reinterpret_cast<const int8_t*>(data + field.offset);
+      case 2:
+        return *(data + field.offset);
+      case 3:
+        return *reinterpret_cast<const int16_t*>(data + field.offset);
+      case 4:
+        return *reinterpret_cast<const uint16_t*>(data + field.offset);
+      case 5:
+        return *reinterpret_cast<const int32_t*>(data + field.offset);
+      case 6:
+        return *reinterpret_cast<const uint32_t*>(data + field.offset);
+      case 7:
+        return *reinterpret_cast<const float*>(data + field.offset);
+      case 8:
+        return *reinterpret_cast<const double*>(data + field.offset);
+      default:
+        return 0.0;
+    }
+  }
+
+  int32_t FindChannelIndex(const sensor_msgs::PointCloud2& cloud, const std::string& channel)
+  {
+    for (size_t i = 0; i < cloud.fields.size(); ++i)
+    {
+      if (cloud.fields[i].name == channel)
+      {
+        return static_cast<int32_t>(i);
+      }
+    }
+    return -1;
+  }
+
+  float LegacyDecode(const sensor_msgs::PointCloud2& cloud)
+  {
+    std::vector<StampedPoint> points;
+    const int32_t xi = FindChannelIndex(cloud, "x");
+    const int32_t yi = FindChannelIndex(cloud, "y");
+    const int32_t zi = FindChannelIndex(cloud, "z");
+    const uint8_t* ptr = &cloud.data.front();
+    const uint32_t point_step = cloud.point_step;
+    const uint32_t xoff = cloud.fields[xi].offset;
+    const uint32_t yoff = cloud.fields[yi].offset;
+    const uint32_t zoff = cloud.fields[zi].offset;
+    const size_t num_points = cloud.data.size() / point_step;
+    const size_t num_features = cloud.fields.size();
+    points.resize(num_points);
+
+    for (size_t i = 0; i < num_points; i++, ptr += point_step)
+    {
+      float x = *reinterpret_cast<const float*>(ptr + xoff);
+      float y = *reinterpret_cast<const float*>(ptr + yoff);
+      float z = *reinterpret_cast<const float*>(ptr + zoff);
+
+      StampedPoint& point = points[i];
+      point.point = tf::Point(x, y, z);
+      point.features.resize(num_features);
+      for (size_t count = 0; count < num_features; count++)
+      {
+        point.features[count] = PointFeature(ptr, cloud.fields[count]);
+      }
+    }
+
+    // ...and then copied the coordinates out for the vertex buffer
+    std::vector<float> gl_point;
+    gl_point.reserve(num_points * 3);
+    for (const StampedPoint& point: points)
+    {
+      gl_point.push_back(point.point.getX());
+      gl_point.push_back(point.point.getY());
+      gl_point.push_back(point.point.getZ());
+    }
+
+    return gl_point.empty() ? 0.0f : gl_point.back();
+  }
+
+  float ColumnarDecode(const sensor_msgs::PointCloud2& cloud, const std::string& value_field)
+  {
+    mapviz_plugins::PointCloud2Decoder decoder;
+    decoder.Configure(cloud, value_field);
+    std::vector<float> xyz;
+    std::vector<float> values;
+    decoder.Decode(cloud, xyz, values);
+    return xyz.empty() ? 0.0f : xyz.back() + values.back();
+  }
+
+  template <typename F>
+  double MeasureSeconds(F decode, int iterations, float& sink)
+  {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+      sink += decode();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  const size_t points = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 1000000;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  std::printf("%zu points, %d iterations\n", points, iterations);
+  std::printf("%-28s %14s %14s %8s\n", "layout", "legacy Mpt/s", "decoder Mpt/s", "speedup");
+
+  float sink = 0.0f;
+  const std::vector<Layout> layouts = Layouts();
+  for (const Layout& layout: layouts)
+  {
+    const sensor_msgs::PointCloud2 cloud = MakeCloud(layout, points);
+
+    const double legacy = MeasureSeconds(
+        [&]() { return LegacyDecode(cloud); }, iterations, sink);
+    const double columnar = MeasureSeconds(
+        [&]() { return ColumnarDecode(cloud, layout.value_field); }, iterations, sink);
+
+    std::printf("%-28s %14.1f %14.1f %7.1fx\n",
+        layout.name.c_str(),
+        points / legacy / 1e6,
+        points / columnar / 1e6,
+        legacy / columnar);
+  }
+
+  // Keeps the decoding from being optimized away
+  return sink == 12345.0f ? 1 : 0;
+}
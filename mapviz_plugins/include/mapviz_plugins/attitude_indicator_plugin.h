@@ -89,7 +89,6 @@ class AttitudeIndicatorPlugin : public mapviz::MapvizPlugin
   void drawBall();
   void drawPanel();
   
-  void timerEvent(QTimerEvent *);
 
  protected Q_SLOTS:
    void SelectTopic();
@@ -32,6 +32,8 @@
 
 // Include mapviz_plugin.h first to ensure GL deps are included in the right order
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/mailbox.h>
+#include <mapviz/renderer.h>
 
 // C++ standard libraries
 #include <list>
@@ -45,7 +47,6 @@
 
 // ROS libraries
 #include <cv_bridge/cv_bridge.h>
-#include <opencv/highgui.h>
 #include <ros/ros.h>
 #include <stereo_msgs/DisparityImage.h>
 #include <tf/transform_datatypes.h>
@@ -79,10 +80,15 @@ namespace mapviz_plugins
     virtual ~DisparityPlugin();
 
     bool Initialize(QGLWidget* canvas);
-    void Shutdown() {}
+    void Shutdown();
 
     void Draw(double x, double y, double scale);
 
+    bool SupportsThreadedCallbacks()
+    {
+      return true;
+    }
+
     void Transform() {}
 
     void LoadConfig(const YAML::Node& node, const std::string& path);
@@ -120,21 +126,26 @@ namespace mapviz_plugins
 
     bool has_image_;
 
-    double last_width_;
-    double last_height_;
-
     ros::Subscriber disparity_sub_;
     bool has_message_;
 
-    stereo_msgs::DisparityImage disparity_;
+    // Disparities quantized to COLOR_MAP indices on the callback thread; an
+    // empty image means the latest message couldn't be shown.
+    mapviz::Mailbox<cv::Mat> incoming_indices_;
 
-    cv::Mat_<cv::Vec3b> disparity_color_;
-    cv::Mat scaled_image_;
+    // The indices are colored by the GPU, or on the CPU if shaders aren't
+    // available.
+    mapviz::Colormap palette_;
+    cv::Mat lut_;
+    GLuint texture_;
+    bool texture_indexed_;
+    int texture_width_;
+    int texture_height_;
 
     void disparityCallback(const stereo_msgs::DisparityImageConstPtr& image);
+    void AdmitLatestImage();
 
-    void ScaleImage(double width, double height);
-    void DrawIplImage(cv::Mat *image);
+    void UploadImage(const cv::Mat& indices, bool indexed);
 
     std::string AnchorToString(Anchor anchor);
     std::string UnitsToString(Units units);
@@ -58,6 +58,7 @@ namespace mapviz_plugins
     bool Initialize(QGLWidget* canvas);
     void Shutdown()
     {
+      destroyInstances();
     }
 
     void Draw(double x, double y, double scale);
@@ -33,6 +33,7 @@
 // C++ standard libraries
 #include <string>
 #include <list>
+#include <vector>
 
 #include <mapviz/mapviz_plugin.h>
 
@@ -113,6 +114,8 @@ namespace mapviz_plugins
     std::list<tf::Point> transformed_left_points_;
     std::list<tf::Point> transformed_right_points_;
 
+    std::vector<mapviz::ColorVertex> vertices_;
+
     swri_transform_util::Transform transform_;
 
     void RecalculateGrid();
@@ -35,6 +35,8 @@
 #include <list>
 
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/mailbox.h>
+#include <mapviz/renderer.h>
 
 // QT libraries
 #include <QGLWidget>
@@ -46,7 +48,6 @@
 #include <ros/ros.h>
 #include <tf/transform_datatypes.h>
 #include <sensor_msgs/Image.h>
-#include <opencv/highgui.h>
 #include <cv_bridge/cv_bridge.h>
 #include <image_transport/image_transport.h>
 
@@ -80,10 +81,15 @@ namespace mapviz_plugins
     virtual ~ImagePlugin();
 
     bool Initialize(QGLWidget* canvas);
-    void Shutdown() {}
+    void Shutdown();
 
     void Draw(double x, double y, double scale);
 
+    bool SupportsThreadedCallbacks()
+    {
+      return true;
+    }
+
     void CreateLocalNode();
     virtual void SetNode(const ros::NodeHandle& node);
 
@@ -131,23 +137,25 @@ namespace mapviz_plugins
     bool force_resubscribe_;
     bool has_image_;
 
-    double last_width_;
-    double last_height_;
     double original_aspect_ratio_;
 
     ros::NodeHandle local_node_;
     image_transport::Subscriber image_sub_;
     bool has_message_;
 
-    sensor_msgs::Image image_;
+    mapviz::Mailbox<cv_bridge::CvImageConstPtr> incoming_images_;
 
-    cv_bridge::CvImagePtr cv_image_;
-    cv::Mat scaled_image_;
+    // The newest image, kept at its original size; the GPU scales it
+    GLuint texture_;
+    GLuint pixel_buffer_;
+    GLenum texture_format_;
+    int texture_width_;
+    int texture_height_;
 
     void imageCallback(const sensor_msgs::ImageConstPtr& image);
+    void AdmitLatestImage();
 
-    void ScaleImage(double width, double height);
-    void DrawIplImage(cv::Mat *image);
+    void UploadImage(const cv::Mat& image, GLenum format);
 
     std::string AnchorToString(Anchor anchor);
     std::string UnitsToString(Units units);
@@ -0,0 +1,85 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_PLUGINS_LASERSCAN_BEAMS_H_
+#define MAPVIZ_PLUGINS_LASERSCAN_BEAMS_H_
+
+// C++ standard libraries
+#include <vector>
+
+// Boost libraries
+#include <boost/shared_ptr.hpp>
+
+namespace mapviz_plugins
+{
+  /**
+   * The cosine and sine of each beam angle of a LaserScan layout.
+   */
+  struct BeamTable
+  {
+    float angle_min;
+    float angle_increment;
+    size_t count;
+    std::vector<float> cos;
+    std::vector<float> sin;
+  };
+  typedef boost::shared_ptr<const BeamTable> BeamTablePtr;
+
+  /**
+   * Returns the table for a layout, computing it only if nothing else is
+   * holding on to one already.  Every scan with the same layout shares a
+   * table, even across plugins, so several identical lidars only pay for it
+   * once.  Safe to call from any thread.
+   */
+  BeamTablePtr GetBeamTable(float angle_min, float angle_increment, size_t count);
+
+  /**
+   * Converts the ranges of a scan to x, y in the sensor frame, dropping the
+   * beams outside of [range_min, range_max].  Every beam is projected in a
+   * branch-free loop that the compiler vectorizes; the kept beams are only
+   * compacted in a second pass when some are out of range.
+   * @param table             The table for the scan's layout
+   * @param ranges            table.count ranges
+   * @param intensities       table.count intensities, or NULL
+   * @param xy                Room for 2 * table.count floats
+   * @param kept_ranges       Room for table.count floats
+   * @param kept_intensities  Room for table.count floats, or NULL
+   * @return The number of beams that were kept
+   */
+  size_t ProjectBeams(const BeamTable& table,
+                      const float* ranges,
+                      const float* intensities,
+                      float range_min,
+                      float range_max,
+                      float* xy,
+                      float* kept_ranges,
+                      float* kept_intensities);
+}
+
+#endif  // MAPVIZ_PLUGINS_LASERSCAN_BEAMS_H_
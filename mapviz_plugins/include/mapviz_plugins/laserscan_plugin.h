@@ -31,11 +31,16 @@
 #define MAPVIZ_PLUGINS_LASERSCAN_PLUGIN_H_
 
 // C++ standard libraries
+#include <atomic>
 #include <string>
 #include <deque>
 #include <vector>
 
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/mailbox.h>
+#include <mapviz/renderer.h>
+#include <mapviz_plugins/laserscan_beams.h>
+#include <mapviz_plugins/scan_persistence.h>
 
 // QT libraries
 #include <QGLWidget>
@@ -67,12 +72,15 @@ namespace mapviz_plugins
       virtual ~LaserScanPlugin();
 
       bool Initialize(QGLWidget* canvas);
-      void Shutdown()
-      {
-      }
+      void Shutdown();
 
       void ClearHistory();
 
+      bool SupportsThreadedCallbacks()
+      {
+        return true;
+      }
+
       void Draw(double x, double y, double scale);
 
       void Transform();
@@ -100,30 +108,38 @@ namespace mapviz_plugins
       void UpdateColors();    
       void DrawIcon();
       void ResetTransformedScans();
+      void HalfLifeChanged(double value);
+      void FixedFrameEdited();
+      void ExtentChanged(double value);
 
     private:
-      struct StampedPoint
-      {
-        tf::Point point;
-        tf::Point transformed_point;
-        QColor color;
-        float range;
-        float intensity;
-      };
-
       struct Scan
       {
         ros::Time stamp;
         QColor color;
-        std::vector<StampedPoint> points;
+        // Columns of the beams that were in range, in the source frame
+        std::vector<float> xy;
+        std::vector<float> ranges;
+        std::vector<float> intensities;
+        // Only filled in for values that aren't one of the columns above
+        std::vector<float> values;
+        // Kept instead of the columns when the beams are projected on the
+        // GPU, straight from the message's ranges
+        sensor_msgs::LaserScanConstPtr message;
         std::string source_frame_;
+        tf::Transform transform;
         bool transformed;
         bool has_intensity;
       };
 
       void laserScanCallback(const sensor_msgs::LaserScanConstPtr& scan);
-      QColor CalculateColor(const StampedPoint& point, bool has_intensity);
-      void updatePreComputedTriginometic(const sensor_msgs::LaserScanConstPtr& msg);
+      void UpdateValues();
+      void UpdateScanValues(Scan& scan);
+      const float* ScanValues(const Scan& scan, size_t& stride) const;
+      void DrawScan(const Scan& scan, float alpha);
+      void DrawPersistence();
+      bool Persisting() const;
+      mapviz::BeamValue BeamSource(const Scan& scan, float& constant) const;
 
       Ui::laserscan_config ui_;
       QWidget* config_widget_;
@@ -137,17 +153,30 @@ namespace mapviz_plugins
 
       bool has_message_;
 
+      // Persistence is on while the half-life is positive; scans are then
+      // transformed to fixed_frame_, or the target frame if it's empty, and
+      // only kept until they've been drawn into persistence_.
+      double half_life_;
+      std::string fixed_frame_;
+      bool persistence_supported_;
+      ScanPersistence persistence_;
+
       // Use a list instead of a deque for scans to facilitate removing
       // timed-out scans in the middle of the list in case I ever re-implement
       // decay time (evenator)
       std::deque<Scan> scans_;
+      mapviz::Colormap colormap_;
+      // Scans decoded on the callback thread, waiting to be colored and
+      // transformed on the GUI thread
+      mapviz::Mailbox<Scan> incoming_scans_;
       ros::Subscriber laserscan_sub_;
-      std::vector<double> precomputed_cos_;
-      std::vector<double> precomputed_sin_;
-      size_t prev_ranges_size_;
-      float  prev_angle_min_;
-      float  prev_increment_;
+      // Only used on the callback thread
+      BeamTablePtr beam_table_;
+      // Set once the renderer is known to have shaders, so that the callback
+      // thread can skip projecting the beams
+      std::atomic<bool> project_on_gpu_;
       bool GetScanTransform(const Scan &scan, swri_transform_util::Transform& transform);
+      bool GetFixedTransform(const Scan &scan, swri_transform_util::Transform& transform);
   };
 }
 
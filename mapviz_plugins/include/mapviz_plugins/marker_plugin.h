@@ -31,15 +31,25 @@
 #define MAPVIZ_PLUGINS_MARKER_PLUGIN_H_
 
 // C++ standard libraries
+#include <functional>
+#include <map>
+#include <queue>
 #include <string>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/renderer.h>
+#include <mapviz/text_renderer.h>
 
 // QT libraries
 #include <QGLWidget>
 
 // ROS libraries
+#include <ros/serialization.h>
 #include <tf/transform_datatypes.h>
 #include <topic_tools/shape_shifter.h>
 #include <visualization_msgs/MarkerArray.h>
@@ -71,10 +81,9 @@ namespace mapviz_plugins
     virtual ~MarkerPlugin();
 
     bool Initialize(QGLWidget* canvas);
-    void Shutdown() {}
+    void Shutdown();
 
     void Draw(double x, double y, double scale);
-    void Paint(QPainter* painter, double x, double y, double scale);
 
     void Transform();
 
@@ -83,11 +92,6 @@ namespace mapviz_plugins
 
     QWidget* GetConfigWidget(QWidget* parent);
 
-    bool SupportsPainting()
-    {
-      return true;
-    }
-
   protected:
     void PrintError(const std::string& message);
     void PrintInfo(const std::string& message);
@@ -130,6 +134,8 @@ namespace mapviz_plugins
 
       std::vector<StampedPoint> points;
       std::string text;
+      // Laid out on the first draw after the text changes
+      mapviz::TextRenderer::LayoutPtr layout;
 
       float scale_x;
       float scale_y;
@@ -137,10 +143,41 @@ namespace mapviz_plugins
 
       std::string source_frame;
       tf::Transform local_transform;
+      // The transform the points were last transformed with
+      tf::Transform applied_transform;
       
       bool transformed;
     };
 
+    // Markers are drawn in groups that share a primitive type and point
+    // size/line width, or an instanced mesh; each group is one draw call.
+    struct GroupKey
+    {
+      GroupKey() : mesh(-1), mode(GL_POINTS), width(0) {}
+
+      // An InstanceMesh, or -1 for plain vertices
+      int mesh;
+      GLenum mode;
+      float width;
+
+      bool operator<(const GroupKey& other) const
+      {
+        return std::tie(mesh, mode, width) < std::tie(other.mesh, other.mode, other.width);
+      }
+    };
+
+    // A group's geometry is kept on the GPU and only rebuilt when one of its
+    // markers is added, modified, deleted or moved.
+    struct Group
+    {
+      Group() : dirty(true) {}
+
+      std::unordered_set<MarkerId, MarkerIdHash> markers;
+      bool dirty;
+      mapviz::ColorBatch vertices;
+      mapviz::InstanceBatch instances;
+    };
+
     Ui::marker_config ui_;
     QWidget* config_widget_;
 
@@ -152,11 +189,70 @@ namespace mapviz_plugins
 
     std::unordered_map<MarkerId, MarkerData, MarkerIdHash> markers_;
 
+    // Markers are indexed by source frame, so that each frame's transform
+    // is looked up once per pass rather than once per marker.
+    struct FrameState
+    {
+      FrameState() : transformed(false), latest(true) {}
+
+      std::unordered_set<MarkerId, MarkerIdHash> markers;
+      // Markers added since the frame was last transformed
+      std::unordered_set<MarkerId, MarkerIdHash> pending;
+      // The latest transform, when the markers were last transformed with it
+      tf::Transform transform;
+      bool transformed;
+      bool latest;
+    };
+    std::map<std::string, FrameState> frames_;
+
+    std::unordered_set<MarkerId, MarkerIdHash> text_markers_;
+    mapviz::TextRenderer text_;
+    QFont font_;
+
+    // Markers with a lifetime, soonest to expire first
+    typedef std::pair<ros::Time, MarkerId> Expiry;
+    typedef std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry> > ExpiryQueue;
+    ExpiryQueue expiry_queue_;
+
+    std::map<GroupKey, Group> groups_;
+
+    // The serialized message being read, reused between messages
+    std::vector<uint8_t> message_buffer_;
+
+    static mapviz::ColorVertex MakeVertex(const tf::Point& point, const Color& color);
+    static mapviz::Instance MakeInstance(const tf::Point& origin,
+                                         const tf::Vector3& x_axis,
+                                         const tf::Vector3& y_axis,
+                                         const Color& color);
+
     void handleMessage(const topic_tools::ShapeShifter::ConstPtr& msg);
-    void handleMarker(const visualization_msgs::Marker &marker);
-    void handleMarkerArray(const visualization_msgs::MarkerArray &markers);
+    void handleMarker(ros::serialization::IStream& stream);
+    void readMarker(ros::serialization::IStream& stream,
+                    const std_msgs::Header& header,
+                    int32_t type,
+                    const geometry_msgs::Pose& pose,
+                    const geometry_msgs::Vector3& scale,
+                    const std_msgs::ColorRGBA& color,
+                    const ros::Duration& lifetime,
+                    uint32_t point_count,
+                    MarkerData& markerData);
+    static tf::Point readPoint(ros::serialization::IStream& stream);
     void transformArrow(MarkerData& markerData,
                         const swri_transform_util::Transform& transform);
+    void transformMarker(MarkerData& marker,
+                         const swri_transform_util::Transform& transform);
+    void untransformMarker(MarkerData& marker);
+
+    static bool groupKey(const MarkerData& marker, GroupKey& key);
+    void groupMarker(const MarkerId& id, const MarkerData& marker);
+    void ungroupMarker(const MarkerId& id, const MarkerData& marker);
+    void markDirty(const MarkerData& marker);
+    void indexMarker(const MarkerId& id, const MarkerData& marker);
+    void unindexMarker(const MarkerId& id, const MarkerData& marker);
+    void expireMarkers(const ros::Time& now);
+    void clearMarkers();
+    void drawText();
+    void buildGroup(const GroupKey& key, Group& group);
   };
 }
 
@@ -31,16 +31,28 @@
 #define MAPVIZ_PLUGINS_GRID_PLUGIN_H_
 
 // C++ standard libraries
+#include <array>
+#include <map>
 #include <string>
 #include <list>
+#include <vector>
+
+// Boost libraries
+#include <boost/shared_ptr.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
 
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/mailbox.h>
+#include <mapviz/renderer.h>
 
 // QT libraries
 #include <QGLWidget>
 #include <QObject>
 #include <QWidget>
+#include <QMutex>
 #include <QTimer>
+#include <QThreadPool>
 
 // ROS libraries
 #include <ros/ros.h>
@@ -55,6 +67,48 @@
 
 namespace mapviz_plugins
 {
+  /**
+   * The cells of an occupancy grid, split into square blocks.  Updates
+   * replace only the blocks they touch, so a copy of the grid, which shares
+   * its blocks, can be read on one thread while it's updated on another.
+   */
+  struct OccupancyGridCells
+  {
+    /** The number of cells along each side of a block. */
+    static const int32_t BLOCK_SIZE = 512;
+
+    OccupancyGridCells() : width(0), height(0), columns(0) {}
+
+    /** Splits cells, row by row, into blocks. */
+    OccupancyGridCells(const int8_t* cells, int32_t width, int32_t height);
+
+    /**
+     * The cell at x, y; the cells after it up to the end of its block's row
+     * follow it in memory.
+     */
+    const int8_t* Cell(int32_t x, int32_t y) const
+    {
+      const std::vector<int8_t>& block =
+          *blocks[static_cast<size_t>(y / BLOCK_SIZE) * columns + x / BLOCK_SIZE];
+      return &block[static_cast<size_t>(y % BLOCK_SIZE) * BLOCK_SIZE + x % BLOCK_SIZE];
+    }
+
+    /**
+     * Copies a rectangle of cells, row by row, into the grid, first copying
+     * any block it touches that another grid is sharing.
+     */
+    void Write(int32_t x, int32_t y, int32_t width, int32_t height,
+               const int8_t* cells, size_t stride);
+
+    int32_t width;
+    int32_t height;
+    // Blocks per row of the grid
+    int32_t columns;
+    // Blocks along the right and top edges are padded to full size
+    std::vector<boost::shared_ptr<std::vector<int8_t> > > blocks;
+  };
+  typedef boost::shared_ptr<const OccupancyGridCells> OccupancyGridCellsPtr;
+
   class OccupancyGridPlugin : public mapviz::MapvizPlugin
   {
     Q_OBJECT
@@ -68,6 +122,11 @@ namespace mapviz_plugins
     bool Initialize(QGLWidget* canvas);
     void Shutdown();
 
+    bool SupportsThreadedCallbacks()
+    {
+      return true;
+    }
+
     void Draw(double x, double y, double scale);
 
     void Transform();
@@ -94,10 +153,73 @@ namespace mapviz_plugins
     void FrameChanged(std::string);
 
   private:
+    // Level of detail, column and row; a tile at level n has a texel for
+    // every 2^n cells along each side
+    typedef boost::tuple<int, int32_t, int32_t> TileKey;
+
+    struct Tile
+    {
+      Tile() :
+        texture(0),
+        generation(1),
+        built_generation(0),
+        building(false),
+        wanted(false),
+        dirty_x0(0), dirty_y0(0), dirty_x1(0), dirty_y1(0)
+      {}
+
+      GLuint texture;
+      // Bumped whenever the tile's cells or colors change; a build that
+      // doesn't match it when it's done is thrown away
+      uint64_t generation;
+      // The generation the texture holds; 0 before the first build
+      uint64_t built_generation;
+      bool building;
+      // Whether the tile was in view at the current level of detail
+      bool wanted;
+      // Cells of a level 0 tile that have changed since it was built, in
+      // texels; empty when x1 <= x0
+      int32_t dirty_x0, dirty_y0, dirty_x1, dirty_y1;
+    };
+
+    struct TileImage
+    {
+      TileKey key;
+      uint64_t epoch;
+      uint64_t generation;
+      int32_t width;
+      int32_t height;
+      // Either palette indices, one byte per texel, or RGBA
+      bool indexed;
+      std::vector<uchar> texels;
+    };
+
+    /**
+     * A map or an update to it, handed from the callback thread to the GUI
+     * thread along with the cells as they are afterwards.
+     */
+    struct GridUpdate
+    {
+      // A new map rather than an update to the current one
+      bool full;
+      nav_msgs::MapMetaData info;
+      std::string frame;
+      ros::Time stamp;
+      // The cells an update changed
+      int32_t x;
+      int32_t y;
+      int32_t width;
+      int32_t height;
+      OccupancyGridCellsPtr cells;
+    };
+
+    class TileBuilder;
+
     Ui::occupancy_grid_config ui_;
     QWidget* config_widget_;
 
-    nav_msgs::OccupancyGridConstPtr grid_;
+    bool has_map_;
+    nav_msgs::MapMetaData info_;
 
     ros::Subscriber grid_sub_;
     ros::Subscriber update_sub_;
@@ -105,20 +227,60 @@ namespace mapviz_plugins
     bool transformed_;
     swri_transform_util::Transform transform_;
 
-    GLuint texture_id_;
-    
-    QPointF map_origin_;
-    float texture_x_, texture_y_;
-    std::vector<uchar> raw_buffer_;
-    std::vector<uchar> color_buffer_;
-    int32_t texture_size_;
+    // The map is split into tiles of at most TILE_SIZE texels square, at
+    // several levels of detail.  Only the tiles in view at the level that
+    // suits the zoom are resident; they're colored on build_pool_ and
+    // uploaded when they're drawn.  Level 0 tiles line up with the blocks
+    // of the cells.
+    static const int32_t TILE_SIZE = OccupancyGridCells::BLOCK_SIZE;
+
+    // The cells as of the last update the GUI thread has taken.  Tile builds
+    // hold on to the copy they started with, which is never written to.
+    OccupancyGridCellsPtr cells_;
+    // Maps are copied into blocks and updates applied on the callback
+    // thread; only the blocks an update touches are copied.
+    QMutex ingest_mutex_;
+    boost::shared_ptr<OccupancyGridCells> ingest_cells_;
+    mapviz::Mailbox<GridUpdate> incoming_updates_;
+    std::map<TileKey, Tile> tiles_;
+    int max_level_;
+    // Bumped when the map's geometry changes, to tell stale builds apart
+    uint64_t epoch_;
+    size_t pending_builds_;
+    // Textures of tiles dropped without a current GL context
+    std::vector<GLuint> stale_textures_;
+    // With shaders, tiles hold the cells themselves and are colored by
+    // looking them up in palette_ as they're drawn, so switching palettes
+    // doesn't touch them.  Otherwise they're colored when they're built.
+    bool indexed_tiles_;
+    mapviz::Colormap palette_;
+    // Stages changed cells for upload, when pixel buffers are supported
+    GLuint pixel_buffer_;
+    std::vector<uchar> texel_scratch_;
+    mapviz::Mailbox<TileImage> built_tiles_;
+    QThreadPool build_pool_;
 
     Palette map_palette_;
     Palette costmap_palette_;
+    // Palettes defined in the config, which take precedence over the built
+    // in ones
+    std::map<std::string, Palette> custom_palettes_;
+    std::string palette_file_;
+    YAML::Node palettes_config_;
 
     void Callback(const nav_msgs::OccupancyGridConstPtr& msg);
     void CallbackUpdate(const map_msgs::OccupancyGridUpdateConstPtr& msg);
-    void updateTexture();
+    const Palette& currentPalette() const;
+    void loadPalettes(const YAML::Node& palettes);
+    void clearTiles();
+    void invalidateTiles();
+    void receiveMap();
+    void invalidateCells(int32_t x, int32_t y, int32_t width, int32_t height);
+    void receiveTiles();
+    bool visibleCells(int& level, int32_t& x0, int32_t& y0, int32_t& x1, int32_t& y1) const;
+    void updateTiles(int level, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+    void updateDirtyCells(const TileKey& key, Tile& tile);
+    void drawTiles(int level);
 
   };
 }
@@ -65,6 +65,7 @@ namespace mapviz_plugins
     bool Initialize(QGLWidget* canvas);
     void Shutdown()
     {
+      destroyInstances();
     }
 
     void Paint(QPainter* painter, double x, double y, double scale);
@@ -0,0 +1,198 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_PLUGINS_POINT_CLOUD_ACCUMULATOR_H_
+#define MAPVIZ_PLUGINS_POINT_CLOUD_ACCUMULATOR_H_
+
+// C++ standard libraries
+#include <map>
+#include <utility>
+#include <vector>
+
+// QT libraries
+#include <QGLWidget>
+
+// ROS libraries
+#include <tf/transform_datatypes.h>
+
+#include <mapviz/renderer.h>
+
+namespace mapviz_plugins
+{
+  /**
+   * Accumulates point clouds into a fixed-resolution 2D grid in the target
+   * frame, keeping a few statistics per cell.
+   *
+   * The grid is sparse: it's split into square tiles that are only created
+   * where points land, and each tile is drawn as a single texture.  Drawing
+   * the grid costs the same no matter how many clouds went into it, and its
+   * memory is bounded by the number of tiles, which can be capped.
+   */
+  class PointCloudAccumulator
+  {
+  public:
+    enum Statistic
+    {
+      MAX_Z = 0,
+      MEAN_VALUE,
+      HIT_COUNT,
+      LAST_VALUE
+    };
+
+    /** The number of cells along each side of a tile. */
+    static const int TILE_SIZE = 64;
+
+    PointCloudAccumulator();
+    ~PointCloudAccumulator();
+
+    /** Sets the size of a cell, in meters; this clears the grid. */
+    void SetResolution(double resolution);
+    double Resolution() const { return resolution_; }
+
+    /** Selects the statistic that's drawn. */
+    void SetStatistic(Statistic statistic);
+    Statistic GetStatistic() const { return statistic_; }
+
+    /**
+     * Cells that haven't been hit for this long are cleared by Decay(); 0
+     * keeps them forever.
+     */
+    void SetDecayTime(double seconds);
+
+    /**
+     * Caps the number of tiles; when a new one is needed past the cap, the
+     * one that was updated longest ago is dropped.  0 for no cap.
+     */
+    void SetMaxTiles(size_t max_tiles);
+
+    /**
+     * Bins points into the grid.
+     * @param xyz        x, y, z of each point in the source frame
+     * @param values     A value per point, used for MEAN_VALUE and LAST_VALUE
+     * @param transform  Takes the points from the source frame to the grid's
+     * @param stamp      The time of the cloud, in seconds
+     */
+    void Add(const float* xyz, const float* values, size_t count,
+        const tf::Transform& transform, double stamp);
+
+    /**
+     * Clears the cells that have outlived the decay time as of now.  Scans
+     * every cell, so it only does any work once a second.
+     */
+    void Decay(double now);
+
+    /** Clears the grid.  Doesn't need a GL context. */
+    void Clear();
+
+    /**
+     * The range of the selected statistic over everything that has been
+     * added since the grid was last cleared.
+     * @return false if the grid is empty
+     */
+    bool Range(float& min, float& max) const;
+
+    /**
+     * Draws the grid, colored by looking the selected statistic up in
+     * colormap.  Tiles are only recolored when they or the colormap have
+     * changed.  Requires a current GL context.
+     * @param unpack_rgb  Treat LAST_VALUE as packed RGB instead
+     */
+    void Draw(mapviz::Renderer* renderer, const mapviz::Colormap& colormap,
+        float alpha, bool unpack_rgb);
+
+    size_t TileCount() const { return tiles_.size(); }
+
+    /** Approximate memory used by the grid, in bytes. */
+    size_t Bytes() const;
+
+    /**
+     * Releases the textures; requires a current GL context.  The destructor
+     * can't, so owners call this from their plugin's Shutdown().
+     */
+    void Destroy();
+
+  private:
+    struct Cell
+    {
+      Cell() : max_z(0), value_sum(0), last_value(0), count(0), stamp(0) {}
+
+      float max_z;
+      float value_sum;
+      float last_value;
+      uint32_t count;
+      // Seconds since time_origin_
+      float stamp;
+    };
+
+    struct Tile
+    {
+      Tile() : texture(0), dirty(true), colors_version(0), last_update(0) {}
+
+      std::vector<Cell> cells;
+      std::vector<uint8_t> rgba;
+      GLuint texture;
+      bool dirty;
+      uint32_t colors_version;
+      double last_update;
+    };
+
+    typedef std::pair<int32_t, int32_t> TileIndex;
+
+    Tile& GetTile(const TileIndex& index, double stamp);
+    void DropTile(std::map<TileIndex, Tile>::iterator it);
+    void ResetRange();
+    float CellValue(const Cell& cell) const;
+
+    double resolution_;
+    Statistic statistic_;
+    double decay_time_;
+    size_t max_tiles_;
+
+    std::map<TileIndex, Tile> tiles_;
+    // Textures of dropped tiles, deleted the next time there's a context
+    std::vector<GLuint> stale_textures_;
+
+    double time_origin_;
+    double last_decay_;
+    // Incremented when every tile has to be recolored
+    uint32_t version_;
+    uint32_t colormap_version_;
+    bool unpack_rgb_;
+
+    float z_min_;
+    float z_max_;
+    float value_min_;
+    float value_max_;
+    uint32_t count_max_;
+
+    std::vector<mapviz::TexturedVertex> quad_;
+  };
+}
+
+#endif  // MAPVIZ_PLUGINS_POINT_CLOUD_ACCUMULATOR_H_
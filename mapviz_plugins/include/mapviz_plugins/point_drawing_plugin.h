@@ -36,6 +36,8 @@
 
 #include <mapviz/mapviz_plugin.h>
 #include <mapviz/map_canvas.h>
+#include <mapviz/renderer.h>
+#include <mapviz_plugins/point_history.h>
 
 // QT libraries
 #include <QGLWidget>
@@ -45,6 +47,7 @@
 // ROS libraries
 #include <ros/ros.h>
 #include <tf/transform_datatypes.h>
+#include <opencv2/core/core.hpp>
 
 namespace mapviz_plugins
 {
@@ -53,22 +56,32 @@ namespace mapviz_plugins
     Q_OBJECT
 
    public:
+    /**
+     * A pose passed to pushPoint().  Only the current point is kept like
+     * this; the rest of the trajectory is stored compactly in a PointHistory.
+     */
     struct StampedPoint
     {
-      StampedPoint(): transformed(false) {}
+      StampedPoint():
+        orientation(tf::Quaternion::getIdentity()),
+        has_covariance(false),
+        transformed(false),
+        transformed_yaw(0)
+      {}
 
       tf::Point point;
       tf::Quaternion orientation;
-      tf::Point transformed_point;
-      tf::Point transformed_arrow_point;
-      tf::Point transformed_arrow_left;
-      tf::Point transformed_arrow_right;
       std::string source_frame;
-      bool transformed;
       ros::Time stamp;
 
-      std::vector<tf::Point> cov_points;
-      std::vector<tf::Point> transformed_cov_points;
+      // Position covariance in the xy-plane of the source frame
+      bool has_covariance;
+      cv::Matx22f covariance;
+
+      bool transformed;
+      tf::Point transformed_point;
+      float transformed_yaw;
+      cv::Matx22f transformed_covariance;
     };
 
     enum DrawStyle
@@ -88,13 +101,13 @@ namespace mapviz_plugins
     virtual void Transform();
     virtual bool DrawPoints(double scale);
     virtual bool DrawArrows();
-    virtual bool DrawArrow(const StampedPoint& point);
     virtual bool DrawLaps();
     virtual bool DrawLines();
     virtual void CollectLaps();
     virtual bool DrawLapsArrows();
     virtual bool TransformPoint(StampedPoint& point);
-    virtual void UpdateColor(QColor base_color, int i);
+    virtual bool TransformHistory(PointHistory& history);
+    virtual QColor UpdateColor(QColor base_color, int i);
     virtual void DrawCovariance();
 
    protected Q_SLOTS:
@@ -115,13 +128,54 @@ namespace mapviz_plugins
     void pushPoint(StampedPoint point);
     double bufferSize() const;
     double positionTolerance() const;
-    const std::deque<StampedPoint>& points() const;
+    const PointHistory& points() const;
+
+    /**
+     * Releases the buffers of the arrows and covariance ellipses;
+     * subclasses call this from Shutdown(), while the GL context is
+     * current.
+     */
+    void destroyInstances();
 
    private:
+    void pushHistory(PointHistory& history, const StampedPoint& point);
+    bool appendHistory(const PointHistory& history, const QColor& color);
+    static mapviz::Instance makeArrow(float x, float y, float yaw, const QColor& color);
+    static void appendArrows(const PointHistory& history, const QColor& color,
+                             std::vector<mapviz::Instance>& arrows);
+    float arrowLength() const;
+    static bool makeEllipse(float x, float y, const cv::Matx22f& covariance, float rotation,
+                            const QColor& color, mapviz::Instance& ellipse);
+    void markInstancesDirty() { instance_generation_++; }
+
+    /**
+     * Glyphs placed at the oldest points of points_, one per point.  The
+     * batch is drawn from first on, so points dropped from the front of the
+     * history only move first past their glyphs.
+     */
+    struct HistoryInstances
+    {
+      HistoryInstances() : generation(0), first(0), sequence(0) {}
+
+      // The number of glyphs that are drawn, starting from the oldest point
+      size_t Placed() const { return batch.Size() - first; }
+
+      mapviz::InstanceBatch batch;
+      uint64_t generation;
+      // The glyph of the point numbered sequence
+      size_t first;
+      uint64_t sequence;
+    };
+    bool resetInstances(HistoryInstances& instances);
+    void placeArrows(HistoryInstances& instances, const QColor& color);
+    bool makeEllipse(size_t i, const QColor& color, mapviz::Instance& ellipse) const;
+    void placeEllipses(HistoryInstances& instances, const QColor& color);
+
     int arrow_size_;
     DrawStyle draw_style_;
     StampedPoint cur_point_;
-    std::deque<StampedPoint> points_;
+    PointHistory points_;
+    FrameTable frames_;
     double position_tolerance_;
     int buffer_size_;
     bool covariance_checked_;
@@ -133,7 +187,23 @@ namespace mapviz_plugins
     bool static_arrow_sizes_;
 
    private:
-    std::vector<std::deque<StampedPoint> > laps_;
+    std::vector<PointHistory> laps_;
+    std::vector<mapviz::ColorVertex> vertices_;
+    std::vector<size_t> indices_;
+
+    // Arrows and covariance ellipses are unit glyphs placed on the GPU.
+    // New points only add glyphs to the end of a batch, and trimmed ones
+    // are skipped over; the batches are rebuilt when points are cleared,
+    // transformed again or recolored.  Glyphs that can't be kept yet, like
+    // the current point's, go in unplaced_ and are drawn afresh every frame.
+    uint64_t instance_generation_;
+    HistoryInstances arrows_;
+    // The arrows of finished laps, and of the lap in progress
+    mapviz::InstanceBatch lap_arrows_;
+    uint64_t lap_arrows_generation_;
+    HistoryInstances current_lap_arrows_;
+    std::vector<mapviz::Instance> unplaced_;
+    HistoryInstances ellipses_;
     bool got_begin_;
     tf::Point begin_;
   };
@@ -0,0 +1,202 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_PLUGINS_POINT_HISTORY_H_
+#define MAPVIZ_PLUGINS_POINT_HISTORY_H_
+
+// C++ standard libraries
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ROS libraries
+#include <ros/time.h>
+
+namespace mapviz_plugins
+{
+  /**
+   * Gives each frame id a small number, so that points don't each carry a
+   * copy of the string.
+   */
+  class FrameTable
+  {
+  public:
+    uint16_t Intern(const std::string& frame);
+    const std::string& Frame(uint16_t index) const { return frames_[index]; }
+
+  private:
+    std::vector<std::string> frames_;
+    std::unordered_map<std::string, uint16_t> indices_;
+  };
+
+  /**
+   * A trajectory of stamped poses, oldest first, kept in a ring buffer with
+   * one array per field.
+   *
+   * Only what can't be recomputed is kept: the position, the heading and
+   * where the point was when it was last transformed into the target frame.
+   * Anything drawn around a point, like an arrow, is derived from those when
+   * it's drawn.  Position covariances are only stored once a point has one,
+   * so histories without them don't pay for the space.
+   *
+   * The capacity isn't fixed: the buffer doubles when it fills up.  A
+   * history that's trimmed to a fixed size stops allocating once it reaches
+   * it, but one that's never trimmed, like a plugin's with a buffer size of
+   * 0, grows without bound.
+   *
+   * As points arrive they're also sorted into levels of detail by radial
+   * distance: a level keeps a point only if it's at least that level's
+   * tolerance from the last point the level kept, and the tolerance doubles
+   * with each level.  Drawing a level whose tolerance is under a pixel looks
+   * the same as drawing every point, but costs about as much as the length
+   * of the trajectory on screen rather than the number of points in it.
+   */
+  class PointHistory
+  {
+  public:
+    /** The tolerance of the finest level of detail, in meters. */
+    static const double LOD_TOLERANCE;
+    static const int LOD_LEVELS = 24;
+
+    PointHistory();
+
+    size_t Size() const { return size_; }
+
+    /**
+     * The number of the oldest point.  Points are numbered in the order
+     * they're pushed, and dropping them from the front doesn't renumber the
+     * rest.
+     */
+    uint64_t FirstSequence() const { return first_sequence_; }
+    bool Empty() const { return size_ == 0; }
+
+    void Clear();
+
+    /**
+     * Appends a point.
+     * @param yaw    The heading in the source frame
+     * @param frame  The source frame, from a FrameTable
+     */
+    void Push(double x, double y, double z, float yaw, const ros::Time& stamp, uint16_t frame);
+
+    void PopFront();
+    void PopBack();
+
+    /** Drops the oldest points until at most size are left. */
+    void Trim(size_t size);
+
+    // Points are indexed from the oldest
+    double X(size_t i) const { return x_[Slot(i)]; }
+    double Y(size_t i) const { return y_[Slot(i)]; }
+    double Z(size_t i) const { return z_[Slot(i)]; }
+    float Yaw(size_t i) const { return yaw_[Slot(i)]; }
+    const ros::Time& Stamp(size_t i) const { return stamps_[Slot(i)]; }
+    uint16_t Frame(size_t i) const { return frames_[Slot(i)]; }
+
+    bool Transformed(size_t i) const { return transformed_[Slot(i)] != 0; }
+    float TransformedX(size_t i) const { return transformed_x_[Slot(i)]; }
+    float TransformedY(size_t i) const { return transformed_y_[Slot(i)]; }
+    float TransformedYaw(size_t i) const { return transformed_yaw_[Slot(i)]; }
+
+    /**
+     * Records the xy-plane position covariance of a point in its source
+     * frame.  Points that are never given one have a covariance of zero.
+     */
+    void SetCovariance(size_t i, float xx, float xy, float yy);
+
+    bool HasCovariance() const { return !covariance_xx_.empty(); }
+    float CovarianceXX(size_t i) const { return covariance_xx_[Slot(i)]; }
+    float CovarianceXY(size_t i) const { return covariance_xy_[Slot(i)]; }
+    float CovarianceYY(size_t i) const { return covariance_yy_[Slot(i)]; }
+
+    /** Records where a point is in the target frame. */
+    void SetTransformed(size_t i, float x, float y, float yaw);
+
+    /** Marks every point as needing to be transformed again. */
+    void ResetTransformed();
+
+    bool AllTransformed() const { return transformed_count_ == size_; }
+    size_t TransformedCount() const { return transformed_count_; }
+
+    /**
+     * Gets the indices of the points to draw so that the trajectory stays
+     * within tolerance of where it really is, oldest first.  The oldest and
+     * newest points are always included.  The levels are built from the
+     * points' source positions, which rigid transforms don't stretch.
+     */
+    void Simplify(double tolerance, std::vector<size_t>& indices) const;
+
+  private:
+    size_t Slot(size_t i) const { return (head_ + i) & (capacity_ - 1); }
+    void Grow();
+    void Forget(size_t i);
+    void DropExpiredDetail();
+
+    // Always a power of two, so that wrapping is a mask
+    size_t capacity_;
+    size_t head_;
+    size_t size_;
+
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<float> z_;
+    std::vector<float> yaw_;
+    std::vector<ros::Time> stamps_;
+    std::vector<uint16_t> frames_;
+
+    // Empty until a point is given a covariance
+    std::vector<float> covariance_xx_;
+    std::vector<float> covariance_xy_;
+    std::vector<float> covariance_yy_;
+
+    std::vector<float> transformed_x_;
+    std::vector<float> transformed_y_;
+    std::vector<float> transformed_yaw_;
+    std::vector<uint8_t> transformed_;
+    size_t transformed_count_;
+
+    // Points are numbered in the order they arrived, so that the levels of
+    // detail don't have to be updated as the ring buffer wraps.
+    uint64_t first_sequence_;
+    struct Level
+    {
+      Level() : last_x(0), last_y(0) {}
+
+      // Sequence numbers of the points kept, oldest first
+      std::deque<uint64_t> points;
+      double last_x;
+      double last_y;
+    };
+    std::vector<Level> levels_;
+  };
+}
+
+#endif  // MAPVIZ_PLUGINS_POINT_HISTORY_H_
@@ -0,0 +1,113 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_PLUGINS_POINTCLOUD2_DECODER_H_
+#define MAPVIZ_PLUGINS_POINTCLOUD2_DECODER_H_
+
+// C++ standard libraries
+#include <string>
+#include <vector>
+
+// ROS libraries
+#include <sensor_msgs/PointCloud2.h>
+
+namespace mapviz_plugins
+{
+  /**
+   * Decodes PointCloud2 messages into columns: interleaved x, y, z floats
+   * that can be uploaded as they are, plus one float per point for the field
+   * that's used for coloring.
+   *
+   * The layout of a topic rarely changes, so Configure() works out which
+   * kernel to use once and Decode() only runs it.  The kernels are templates
+   * specialized on the field types and, for common lidar layouts, on the
+   * point step, so that the inner loops are free of per-field branches.
+   */
+  class PointCloud2Decoder
+  {
+  public:
+    PointCloud2Decoder();
+
+    /**
+     * Picks the kernels for cloud's layout.  This only does any work when
+     * the layout or value_field differ from the last call, so it's cheap to
+     * call for every message.
+     * @param value_field  Field to decode values from; empty for none
+     * @return false if the cloud doesn't have float32 x, y and z fields;
+     *         Error() says which
+     */
+    bool Configure(const sensor_msgs::PointCloud2& cloud, const std::string& value_field);
+
+    /** The number of points in cloud. */
+    static size_t PointCount(const sensor_msgs::PointCloud2& cloud);
+
+    /**
+     * Decodes points [begin, end) of cloud, which must have the layout given
+     * to Configure().
+     * @param xyz     Room for 3 * (end - begin) floats
+     * @param values  Room for end - begin floats; may be NULL, and is
+     *                filled with zeros if there is no value field
+     */
+    void Decode(const sensor_msgs::PointCloud2& cloud, size_t begin, size_t end,
+        float* xyz, float* values) const;
+
+    /** Decodes every point of cloud, resizing the columns to fit. */
+    void Decode(const sensor_msgs::PointCloud2& cloud,
+        std::vector<float>& xyz, std::vector<float>& values) const;
+
+    const std::string& ValueField() const { return value_field_; }
+
+    /** Why the last call to Configure() failed. */
+    const std::string& Error() const { return error_; }
+
+    /** A short description of the kernels in use, for debugging. */
+    std::string LayoutName() const;
+
+  private:
+    typedef void (*XyzKernel)(const uint8_t* data, size_t count, uint32_t step,
+        const uint32_t* offsets, float* xyz);
+    typedef void (*ValueKernel)(const uint8_t* data, size_t count, uint32_t step,
+        uint32_t offset, float* values);
+
+    bool configured_;
+    std::vector<sensor_msgs::PointField> fields_;
+    uint32_t point_step_;
+    std::string value_field_;
+    std::string error_;
+
+    uint32_t xyz_offsets_[3];
+    uint32_t value_offset_;
+    uint8_t value_datatype_;
+    bool packed_xyz_;
+    XyzKernel xyz_kernel_;
+    ValueKernel value_kernel_;
+  };
+}
+
+#endif  // MAPVIZ_PLUGINS_POINTCLOUD2_DECODER_H_
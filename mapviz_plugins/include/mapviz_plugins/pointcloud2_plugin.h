@@ -37,11 +37,16 @@
 #include <map>
 
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/mailbox.h>
+#include <mapviz/renderer.h>
+#include <mapviz_plugins/point_cloud_accumulator.h>
+#include <mapviz_plugins/pointcloud2_decoder.h>
 
 // QT libraries
 #include <QGLWidget>
 #include <QColor>
 #include <QMutex>
+#include <QThreadPool>
 
 // ROS libraries
 #include <sensor_msgs/PointCloud2.h>
@@ -72,12 +77,15 @@ namespace mapviz_plugins
     virtual ~PointCloud2Plugin();
 
     bool Initialize(QGLWidget* canvas);
-    void Shutdown()
-    {
-    }
+    void Shutdown();
 
     void ClearHistory();
 
+    bool SupportsThreadedCallbacks()
+    {
+      return true;
+    }
+
     void Draw(double x, double y, double scale);
 
     void Transform();
@@ -103,6 +111,9 @@ namespace mapviz_plugins
     void BufferSizeChanged(int value);
     void UseRainbowChanged(int check_state);
     void UseAutomaxminChanged(int check_state);
+    void AccumulateChanged(int index);
+    void CellSizeChanged(double value);
+    void DecayTimeChanged(int value);
     void UpdateColors();
     void DrawIcon();
     void ResetTransformedPointClouds();
@@ -110,30 +121,73 @@ namespace mapviz_plugins
     void SetSubscription(bool subscribe);
 
   private:
-    struct StampedPoint
+    /**
+     * The buffer objects holding one scan in video memory, along with how
+     * many bytes have been allocated for each.  These are recycled from scan
+     * to scan so that the history is a ring of resident buffers.
+     */
+    struct ScanBuffers
     {
-      tf::Point point;
-      std::vector<float> features;
+      ScanBuffers() :
+        point_vbo(0), value_vbo(0), color_vbo(0),
+        point_bytes(0), value_bytes(0), color_bytes(0)
+      {}
+
+      GLuint point_vbo;
+      GLuint value_vbo;
+      GLuint color_vbo;
+      size_t point_bytes;
+      size_t value_bytes;
+      size_t color_bytes;
     };
 
     struct Scan
     {
       ros::Time stamp;
       QColor color;
-      std::vector<StampedPoint> points;
       std::string source_frame;
       bool transformed;
       std::map<std::string, FieldInfo> new_features;
 
+      tf::Transform transform;
+
+      // Coordinates are x, y, z in the source frame; released once they've
+      // been uploaded
       std::vector<float> gl_point;
+      size_t point_count;
+      // The value of value_field for each point; colored by the colormap
+      // shader.  Only this field is kept, so scans decoded with a field
+      // other than the selected one aren't drawn.
+      std::vector<float> values;
+      std::string value_field;
+      // Only kept for the newest scan, so that it can be decoded again when
+      // the field changes; a latched cloud is never sent again.
+      sensor_msgs::PointCloud2ConstPtr cloud;
+      // Only filled in when the colors have to be computed on the CPU
       std::vector<uint8_t> gl_color;
-      GLuint point_vbo;
-      GLuint color_vbo;
+      ScanBuffers buffers;
+      bool points_uploaded;
+      bool values_uploaded;
+      bool colors_uploaded;
+      uint32_t colors_version;
     };
 
-    float PointFeature(const uint8_t*, const FieldInfo&);
     void PointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr& scan);
-    QColor CalculateColor(const StampedPoint& point);
+    std::string SelectedField() const;
+    void UpdateMinMax(const Scan& scan);
+    void RedecodeNewestScan(const std::string& field);
+    void UpdateCpuColors(Scan& scan);
+    void UpdateColormap();
+    bool Accumulating() const;
+    bool ColorIsFlat() const;
+    void AccumulateScans();
+    void AcquireBuffers(Scan& scan);
+    void ReleaseBuffers(Scan& scan);
+    void ReleaseAllBuffers();
+    void TrimBufferPool();
+    void Upload(GLuint buffer, size_t& capacity, const void* data, size_t bytes);
+    void UpdateFeatureList(const std::map<std::string, FieldInfo>& features);
+    void AdmitIncomingScans();
     void UpdateMinMaxWidgets();
 
     Ui::PointCloud2_config ui_;
@@ -153,10 +207,44 @@ namespace mapviz_plugins
     bool need_minmax_;
     std::vector<double> max_;
     std::vector<double> min_;
+    mapviz::Colormap colormap_;
+    // Used instead of scans_ when accumulating
+    PointCloudAccumulator accumulator_;
+    // Incremented whenever CPU-computed colors become stale
+    uint32_t color_version_;
     // Use a list instead of a deque for scans to facilitate removing
     // timed-out scans in the middle of the list in case I ever re-implement
     // decay time (evenator)
     std::deque<Scan> scans_;
+    // Clouds decoded on the callback thread, waiting to be colored,
+    // transformed and given buffer objects on the GUI thread
+    mapviz::Mailbox<Scan> incoming_scans_;
+    // Only used on the callback thread
+    PointCloud2Decoder decoder_;
+    // Decodes the chunks of large clouds in parallel
+    QThreadPool decode_pool_;
+
+    // Decoding settings shared with the callback thread
+    QMutex decode_mutex_;
+    // The field to decode values from
+    std::string value_field_;
+    // Clouds with at least this many points are decoded in parallel; 0
+    // disables it
+    size_t parallel_decode_threshold_;
+    // The size of decode_pool_, or 0 for one thread per core
+    int decode_threads_;
+    // Set when a cloud couldn't be decoded, so that the status is shown
+    // again once one can
+    bool decode_failed_;
+    // Buffers of evicted scans, waiting to be reused by new ones.  Only
+    // touched on the GUI thread.
+    std::vector<ScanBuffers> free_buffers_;
+    // Bytes allocated in buffer objects by this plugin
+    size_t vram_bytes_;
+    // The tile count and video memory last shown in the status, so that
+    // it's only rebuilt when they change
+    size_t reported_tiles_;
+    size_t reported_vram_bytes_;
     ros::Subscriber pc2_sub_;
 
     QMutex scan_mutex_;
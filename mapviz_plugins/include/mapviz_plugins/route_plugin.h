@@ -112,7 +112,9 @@ namespace mapviz_plugins
 
     swri_route_util::Route src_route_;
     marti_nav_msgs::RoutePositionConstPtr src_route_position_;
-    
+
+    std::vector<mapviz::ColorVertex> vertices_;
+
     void RouteCallback(const marti_nav_msgs::RouteConstPtr &msg);
     void PositionCallback(const marti_nav_msgs::RoutePositionConstPtr &msg);
   };
@@ -0,0 +1,141 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_PLUGINS_SCAN_PERSISTENCE_H_
+#define MAPVIZ_PLUGINS_SCAN_PERSISTENCE_H_
+
+// C++ standard libraries
+#include <vector>
+
+// QT libraries
+#include <QGLWidget>
+
+// ROS libraries
+#include <tf/transform_datatypes.h>
+
+#include <mapviz/renderer.h>
+
+namespace mapviz_plugins
+{
+  /**
+   * Keeps a fading history of scans in an offscreen texture.
+   *
+   * Each scan is drawn into the texture once, when it arrives, and the
+   * texture's opacity then decays with a configurable half-life, so drawing
+   * the history costs a single textured quad no matter how much of it there
+   * is.  The texture covers a square of a fixed frame that is moved along
+   * with the sensor, and is drawn through the current transform from the
+   * fixed frame so that it stays put while the target frame moves.
+   */
+  class ScanPersistence
+  {
+  public:
+    /** The number of pixels along each side of the texture. */
+    static const int TEXTURE_SIZE = 1024;
+
+    ScanPersistence();
+    ~ScanPersistence();
+
+    /** Sets the width of the area kept, in meters; this clears it. */
+    void SetExtent(double extent);
+    double Extent() const { return extent_; }
+
+    /**
+     * Sets how long it takes the history to fade to half of its opacity, in
+     * seconds; 0 never fades it.
+     */
+    void SetHalfLife(double half_life);
+    double HalfLife() const { return half_life_; }
+
+    /**
+     * Whether the GL implementation can draw into textures.  Requires a
+     * current GL context.
+     */
+    static bool Supported();
+
+    /** Clears the history.  Doesn't need a GL context. */
+    void Clear();
+
+    /**
+     * Fades the history by the time since it was last faded.  Requires a
+     * current GL context.
+     * @param now  The current time, in seconds
+     */
+    void Fade(mapviz::Renderer* renderer, double now);
+
+    /**
+     * Starts drawing into the history: until End(), everything drawn in the
+     * fixed frame lands in the texture instead of on the canvas.  Requires a
+     * current GL context.
+     * @param x, y  Where the sensor is in the fixed frame; the area kept is
+     *              moved once the sensor gets near its edge
+     * @return false if the texture can't be drawn into, in which case End()
+     *         must not be called
+     */
+    bool Begin(mapviz::Renderer* renderer, double x, double y);
+    void End();
+
+    /**
+     * Draws the history.  Requires a current GL context.
+     * @param transform  Takes the fixed frame to the target frame
+     */
+    void Draw(mapviz::Renderer* renderer, const tf::Transform& transform,
+        float alpha);
+
+    /**
+     * Releases the textures and framebuffer; requires a current GL context.
+     * Owners call this from their plugin's Shutdown().
+     */
+    void Destroy();
+
+  private:
+    bool Allocate();
+    bool Bind(int texture);
+    void LoadProjection();
+    void Quad(double x, double y, std::vector<mapviz::TexturedVertex>& quad) const;
+
+    double extent_;
+    double half_life_;
+
+    GLuint framebuffer_;
+    // Two textures, so that the history can be copied across when the area
+    // that's kept moves
+    GLuint textures_[2];
+    int current_;
+    GLint previous_framebuffer_;
+
+    // The center of the area kept, in the fixed frame
+    double center_x_;
+    double center_y_;
+    bool cleared_;
+    double last_fade_;
+  };
+}
+
+#endif  // MAPVIZ_PLUGINS_SCAN_PERSISTENCE_H_
@@ -34,15 +34,14 @@
 #include <string>
 
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/text_renderer.h>
 
 #include <QObject>
 #include <QString>
 #include <QColor>
 #include <QWidget>
 #include <QGLWidget>
-#include <QPainter>
 #include <QFont>
-#include <QStaticText>
 
 
 #include <ros/ros.h>
@@ -79,10 +78,9 @@ namespace mapviz_plugins
     virtual ~StringPlugin();
 
     bool Initialize(QGLWidget* canvas);
-    void Shutdown() {}
+    void Shutdown();
 
     void Draw(double x, double y, double scale);
-    void Paint(QPainter* painter, double x, double y, double scale);
 
     void Transform() {}
 
@@ -91,13 +89,8 @@ namespace mapviz_plugins
 
     QWidget* GetConfigWidget(QWidget* parent);
 
-    bool SupportsPainting()
-    {
-      return true;
-    }
-
   protected:
-    void PaintText(QPainter* painter);
+    void DrawText();
     void PrintError(const std::string& message);
     void PrintInfo(const std::string& message);
     void PrintWarning(const std::string& message);
@@ -124,11 +117,13 @@ namespace mapviz_plugins
 
     ros::Subscriber string_sub_;
     bool has_message_;
-    bool has_painted_;
 
     QColor color_;
     QFont font_;
-    QStaticText message_;
+    QString message_;
+    mapviz::TextRenderer text_;
+    // Laid out again on the next draw when the message or font changes
+    mapviz::TextRenderer::LayoutPtr layout_;
 
     void stringCallback(const std_msgs::StringConstPtr& str);
 
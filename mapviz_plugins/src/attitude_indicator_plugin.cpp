@@ -168,7 +168,7 @@ namespace mapviz_plugins
     pitch_ = pitch_ * (180.0 / M_PI);
     yaw_ = yaw_ * (180.0 / M_PI);
 
-    canvas_->update();
+    Q_EMIT Dirty();
   }
 
   void AttitudeIndicatorPlugin::PrintError(const std::string& message)
@@ -197,7 +197,6 @@ namespace mapviz_plugins
     initialized_ = true;
     canvas_ = canvas;
     placer_.setContainer(canvas_);
-    startTimer(50);
     return true;
   }
 
@@ -206,11 +205,6 @@ namespace mapviz_plugins
     placer_.setContainer(NULL);
   }
 
-  void AttitudeIndicatorPlugin::timerEvent(QTimerEvent*)
-  {
-    canvas_->update();
-  }
-
   void AttitudeIndicatorPlugin::drawBall()
   {
     GLdouble eqn[4] = {0.0, 0.0, 1.0, 0.0};
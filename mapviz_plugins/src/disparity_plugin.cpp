@@ -62,11 +62,28 @@ namespace mapviz_plugins
     width_(320),
     height_(240),
     has_image_(false),
-    last_width_(0),
-    last_height_(0)
+    texture_(0),
+    texture_indexed_(false),
+    texture_width_(0),
+    texture_height_(0)
   {
     ui_.setupUi(config_widget_);
 
+    // Only the newest disparity image is ever shown
+    incoming_indices_.SetCapacity(1);
+
+    std::vector<uint8_t> rgba(mapviz::Colormap::SIZE * 4);
+    lut_.create(1, 256, CV_8UC3);
+    for (int i = 0; i < 256; i++)
+    {
+      rgba[i * 4 + 0] = COLOR_MAP[3*i + 0];
+      rgba[i * 4 + 1] = COLOR_MAP[3*i + 1];
+      rgba[i * 4 + 2] = COLOR_MAP[3*i + 2];
+      rgba[i * 4 + 3] = 255;
+      lut_.at<cv::Vec3b>(0, i) = cv::Vec3b(COLOR_MAP[3*i + 0], COLOR_MAP[3*i + 1], COLOR_MAP[3*i + 2]);
+    }
+    palette_.SetTable(rgba.data());
+
     // Set background white
     QPalette p(config_widget_->palette());
     p.setColor(QPalette::Background, Qt::white);
@@ -92,6 +109,19 @@ namespace mapviz_plugins
   {
   }
 
+  void DisparityPlugin::Shutdown()
+  {
+    if (texture_ != 0)
+    {
+      glDeleteTextures(1, &texture_);
+      texture_ = 0;
+    }
+    // The next image allocates the texture's storage again
+    texture_width_ = 0;
+    texture_height_ = 0;
+    palette_.Destroy();
+  }
+
   void DisparityPlugin::SetOffsetX(int offset)
   {
     offset_x_ = offset;
@@ -239,48 +269,65 @@ namespace mapviz_plugins
       has_message_ = true;
     }
 
+    // This runs on the plugin's callback thread; the quantized image is
+    // picked up by the GUI thread in Draw().
     if (disparity->min_disparity == 0.0 && disparity->max_disparity == 0.0)
     {
       PrintError("Min and max disparity not set.");
-      has_image_ = false;
+      incoming_indices_.Post(cv::Mat());
       return;
     }
 
     if (disparity->image.encoding != sensor_msgs::image_encodings::TYPE_32FC1)
     {
       PrintError("Invalid encoding.");
-      has_image_ = false;
+      incoming_indices_.Post(cv::Mat());
       return;
     }
 
-    disparity_ = *disparity;
-
-    // Colormap and display the disparity image
     float min_disparity = disparity->min_disparity;
     float max_disparity = disparity->max_disparity;
     float multiplier = 255.0f / (max_disparity - min_disparity);
 
+    // Wraps the message's buffer rather than copying it
     cv_bridge::CvImageConstPtr cv_disparity = 
       cv_bridge::toCvShare(disparity->image, disparity);
 
-    disparity_color_.create(disparity->image.height, disparity->image.width);
+    // Scales, rounds and saturates to a COLOR_MAP index in one vectorized
+    // pass; the coloring itself is left to the GPU.
+    cv::Mat indices;
+    cv_disparity->image.convertTo(indices, CV_8U, multiplier, -min_disparity * multiplier);
+
+    incoming_indices_.Post(indices);
 
-    for (int row = 0; row < disparity_color_.rows; row++)
+    Q_EMIT Dirty();
+  }
+
+  void DisparityPlugin::AdmitLatestImage()
+  {
+    cv::Mat indices;
+    if (!incoming_indices_.TakeLatest(indices))
     {
-      const float* d = cv_disparity->image.ptr<float>(row);
-      for (int col = 0; col < disparity_color_.cols; col++)
-      {
-        int index = static_cast<int>((d[col] - min_disparity) * multiplier + 0.5);
-        index = std::min(255, std::max(0, index));
-        // Fill as BGR
-        disparity_color_(row, col)[2] = COLOR_MAP[3*index + 0];
-        disparity_color_(row, col)[1] = COLOR_MAP[3*index + 1];
-        disparity_color_(row, col)[0] = COLOR_MAP[3*index + 2];
-      }
+      return;
+    }
+
+    if (indices.empty())
+    {
+      has_image_ = false;
+      return;
     }
 
-    last_width_ = 0;
-    last_height_ = 0;
+    if (renderer_->Initialize() && renderer_->ShadersSupported())
+    {
+      UploadImage(indices, true);
+    }
+    else
+    {
+      cv::Mat colors;
+      cv::cvtColor(indices, colors, CV_GRAY2RGB);
+      cv::LUT(colors, lut_, colors);
+      UploadImage(colors, false);
+    }
 
     has_image_ = true;
   }
@@ -314,53 +361,51 @@ namespace mapviz_plugins
     return true;
   }
 
-  void DisparityPlugin::ScaleImage(double width, double height)
+  /**
+   * Copies an image into the texture, which is only reallocated when the
+   * image's size or kind changes.
+   */
+  void DisparityPlugin::UploadImage(const cv::Mat& image, bool indexed)
   {
-    if (!has_image_)
+    if (texture_ == 0)
     {
-      return;
+      glGenTextures(1, &texture_);
     }
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    cv::resize(disparity_color_, scaled_image_, cvSize2D32f(width, height), 0, 0, CV_INTER_AREA);
-  }
-
-  void DisparityPlugin::DrawIplImage(cv::Mat *image)
-  {
-    // TODO(malban): glTexture2D may be more efficient than glDrawPixels
-
-    if (!has_image_)
-      return;
-
-    if (image == NULL)
-      return;
-
-    if (image->cols == 0 || image->rows == 0)
-      return;
-
-    GLenum format;
-    switch (image->channels())
+    const GLenum format = indexed ? GL_LUMINANCE : GL_RGB;
+    if (image.cols != texture_width_ || image.rows != texture_height_ || indexed != texture_indexed_)
     {
-      case 1:
-        format = GL_LUMINANCE;
-        break;
-      case 2:
-        format = GL_LUMINANCE_ALPHA;
-        break;
-      case 3:
-        format = GL_BGR;
-        break;
-      default:
-        return;
+      // Interpolated indices are meaningless, so indexed texels aren't blended
+      const GLint filter = indexed ? GL_NEAREST : GL_LINEAR;
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexImage2D(GL_TEXTURE_2D, 0, indexed ? GL_LUMINANCE8 : GL_RGB8, image.cols, image.rows, 0,
+                   format, GL_UNSIGNED_BYTE, image.data);
+      texture_width_ = image.cols;
+      texture_height_ = image.rows;
+      texture_indexed_ = indexed;
+    }
+    else
+    {
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.cols, image.rows,
+                      format, GL_UNSIGNED_BYTE, image.data);
     }
 
-    glPixelZoom(1.0, -1.0f);
-    glDrawPixels(image->cols, image->rows, format, GL_UNSIGNED_BYTE, image->ptr());
-
-    PrintInfo("OK");
+    glBindTexture(GL_TEXTURE_2D, 0);
   }
 
   void DisparityPlugin::Draw(double x, double y, double scale)
   {
+    AdmitLatestImage();
+    if (!has_image_)
+    {
+      return;
+    }
+
     // Calculate the correct offsets and dimensions
     double x_offset = offset_x_;
     double y_offset = offset_y_;
@@ -374,12 +419,6 @@ namespace mapviz_plugins
       height = height_ * canvas_->height() / 100.0;
     }
 
-    // Scale the source image if necessary
-    if (width != last_width_ || height != last_height_)
-    {
-      ScaleImage(width, height);
-    }
-
     // Calculate the correct render position
     double x_pos = 0;
     double y_pos = 0;
@@ -433,15 +472,31 @@ namespace mapviz_plugins
     glPushMatrix();
     glLoadIdentity();
     glOrtho(0, canvas_->width(), canvas_->height(), 0, -0.5f, 0.5f);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
 
-    glRasterPos2d(x_pos, y_pos);
-
-    DrawIplImage(&scaled_image_);
+    std::vector<mapviz::TexturedVertex> quad;
+    quad.reserve(4);
+    quad.push_back(mapviz::TexturedVertex(x_pos, y_pos, 0, 0));
+    quad.push_back(mapviz::TexturedVertex(x_pos + width, y_pos, 1, 0));
+    quad.push_back(mapviz::TexturedVertex(x_pos + width, y_pos + height, 1, 1));
+    quad.push_back(mapviz::TexturedVertex(x_pos, y_pos + height, 0, 1));
+    if (texture_indexed_)
+    {
+      renderer_->DrawPaletteQuads(texture_, quad, palette_);
+    }
+    else
+    {
+      renderer_->DrawTexturedQuads(texture_, quad);
+    }
 
     glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
 
-    last_width_ = width;
-    last_height_ = height;
+    PrintInfo("OK");
   }
 
   void DisparityPlugin::LoadConfig(const YAML::Node& node, const std::string& path)
@@ -212,17 +212,16 @@ namespace mapviz_plugins
     if (transformed_)
     {
       QColor color = ui_.color->color();
-      
-      glLineWidth(3);
-      glColor4d(color.redF(), color.greenF(), color.blueF(), alpha_);
-      glBegin(GL_LINES);
+      color.setAlphaF(alpha_);
+
+      vertices_.clear();
 
         std::list<tf::Point>::iterator transformed_left_it = transformed_left_points_.begin();
         std::list<tf::Point>::iterator transformed_right_it = transformed_right_points_.begin();
         for (; transformed_left_it != transformed_left_points_.end(); ++transformed_left_it)
         {
-          glVertex2d(transformed_left_it->getX(), transformed_left_it->getY());
-          glVertex2d(transformed_right_it->getX(), transformed_right_it->getY());
+          vertices_.push_back(mapviz::ColorVertex(transformed_left_it->getX(), transformed_left_it->getY(), color));
+          vertices_.push_back(mapviz::ColorVertex(transformed_right_it->getX(), transformed_right_it->getY(), color));
 
           ++transformed_right_it;
         }
@@ -231,13 +230,13 @@ namespace mapviz_plugins
         std::list<tf::Point>::iterator transformed_bottom_it = transformed_bottom_points_.begin();
         for (; transformed_top_it != transformed_top_points_.end(); ++transformed_top_it)
         {
-          glVertex2d(transformed_top_it->getX(), transformed_top_it->getY());
-          glVertex2d(transformed_bottom_it->getX(), transformed_bottom_it->getY());
+          vertices_.push_back(mapviz::ColorVertex(transformed_top_it->getX(), transformed_top_it->getY(), color));
+          vertices_.push_back(mapviz::ColorVertex(transformed_bottom_it->getX(), transformed_bottom_it->getY(), color));
 
           ++transformed_bottom_it;
         }
 
-      glEnd();
+      renderer_->DrawLines(vertices_, 3);
 
       PrintInfo("OK");
     }
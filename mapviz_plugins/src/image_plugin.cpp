@@ -27,10 +27,13 @@
 //
 // *****************************************************************************
 
+#include <GL/glew.h>
+
 #include <mapviz_plugins/image_plugin.h>
 
 // C++ standard libraries
 #include <cstdio>
+#include <cstring>
 #include <vector>
 
 // QT libraries
@@ -40,7 +43,6 @@
 // ROS libraries
 #include <ros/master.h>
 #include <sensor_msgs/image_encodings.h>
-#include <opencv2/imgproc/imgproc.hpp>
 
 #include <mapviz/select_topic_dialog.h>
 
@@ -50,6 +52,49 @@ PLUGINLIB_EXPORT_CLASS(mapviz_plugins::ImagePlugin, mapviz::MapvizPlugin)
 
 namespace mapviz_plugins
 {
+  namespace
+  {
+    /**
+     * The GL pixel format an encoding can be uploaded in as is, or 0 if it
+     * has to be converted first.
+     */
+    GLenum uploadFormat(const std::string& encoding)
+    {
+      namespace enc = sensor_msgs::image_encodings;
+      if (encoding == enc::BGR8)
+      {
+        return GL_BGR;
+      }
+      else if (encoding == enc::RGB8)
+      {
+        return GL_RGB;
+      }
+      else if (encoding == enc::BGRA8)
+      {
+        return GL_BGRA;
+      }
+      else if (encoding == enc::RGBA8)
+      {
+        return GL_RGBA;
+      }
+      else if (encoding == enc::MONO8)
+      {
+        return GL_LUMINANCE;
+      }
+      return 0;
+    }
+
+    void generateMipmaps()
+    {
+      // Without glGenerateMipmap, GL_GENERATE_MIPMAP was set on the texture
+      // and the driver keeps the levels up to date itself.
+      if (GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object)
+      {
+        glGenerateMipmap(GL_TEXTURE_2D);
+      }
+    }
+  }
+
   ImagePlugin::ImagePlugin() :
     config_widget_(new QWidget()),
     anchor_(TOP_LEFT),
@@ -60,12 +105,18 @@ namespace mapviz_plugins
     height_(240),
     transport_("default"),
     has_image_(false),
-    last_width_(0),
-    last_height_(0),
-    original_aspect_ratio_(1.0)
+    original_aspect_ratio_(1.0),
+    texture_(0),
+    pixel_buffer_(0),
+    texture_format_(0),
+    texture_width_(0),
+    texture_height_(0)
   {
     ui_.setupUi(config_widget_);
 
+    // Only the newest image is ever shown, so don't queue up old ones
+    incoming_images_.SetCapacity(1);
+
     // Set background white
     QPalette p(config_widget_->palette());
     p.setColor(QPalette::Background, Qt::white);
@@ -97,6 +148,24 @@ namespace mapviz_plugins
   {
   }
 
+  void ImagePlugin::Shutdown()
+  {
+    if (texture_ != 0)
+    {
+      glDeleteTextures(1, &texture_);
+      texture_ = 0;
+    }
+    if (pixel_buffer_ != 0)
+    {
+      glDeleteBuffers(1, &pixel_buffer_);
+      pixel_buffer_ = 0;
+    }
+    // The next image allocates the texture's storage again
+    texture_width_ = 0;
+    texture_height_ = 0;
+    texture_format_ = 0;
+  }
+
   void ImagePlugin::SetOffsetX(int offset)
   {
     offset_x_ = offset;
@@ -317,11 +386,20 @@ namespace mapviz_plugins
       has_message_ = true;
     }
 
-    image_ = *image;
-
+    // This runs on the plugin's callback thread; the decoded image is
+    // picked up by the GUI thread in Draw().  Encodings GL can read are
+    // shared with the message rather than copied.
+    cv_bridge::CvImageConstPtr cv_image;
     try
     {
-      cv_image_ = cv_bridge::toCvCopy(image, sensor_msgs::image_encodings::BGR8);
+      if (uploadFormat(image->encoding) != 0)
+      {
+        cv_image = cv_bridge::toCvShare(image);
+      }
+      else
+      {
+        cv_image = cv_bridge::toCvCopy(image, sensor_msgs::image_encodings::BGR8);
+      }
     }
     catch (const cv_bridge::Exception& e)
     {
@@ -329,9 +407,29 @@ namespace mapviz_plugins
       return;
     }
 
-    last_width_ = 0;
-    last_height_ = 0;
-    original_aspect_ratio_ = (double)image->height / (double)image->width;
+    incoming_images_.Post(cv_image);
+
+    Q_EMIT Dirty();
+  }
+
+  void ImagePlugin::AdmitLatestImage()
+  {
+    // Images that arrived since the last frame are dropped unseen
+    cv_bridge::CvImageConstPtr cv_image;
+    if (!incoming_images_.TakeLatest(cv_image))
+    {
+      return;
+    }
+
+    const cv::Mat& image = cv_image->image;
+    if (image.cols == 0 || image.rows == 0)
+    {
+      return;
+    }
+
+    UploadImage(image, uploadFormat(cv_image->encoding));
+
+    original_aspect_ratio_ = (double)image.rows / (double)image.cols;
 
     if( ui_.keep_ratio->isChecked() )
     {
@@ -346,6 +444,82 @@ namespace mapviz_plugins
     has_image_ = true;
   }
 
+  /**
+   * Copies an image into the texture, which is only reallocated when the
+   * image's size or format changes.
+   */
+  void ImagePlugin::UploadImage(const cv::Mat& image, GLenum format)
+  {
+    if (texture_ == 0)
+    {
+      glGenTextures(1, &texture_);
+      glBindTexture(GL_TEXTURE_2D, texture_);
+      // Mipmaps keep a large image from aliasing when it's drawn small
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      if (!(GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object))
+      {
+        glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+      }
+    }
+    else
+    {
+      glBindTexture(GL_TEXTURE_2D, texture_);
+    }
+
+    // Rows may be padded; GL is told their length rather than having the
+    // image repacked.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(image.step[0] / image.elemSize()));
+
+    if (image.cols != texture_width_ || image.rows != texture_height_ || format != texture_format_)
+    {
+      glTexImage2D(GL_TEXTURE_2D, 0, format == GL_LUMINANCE ? GL_LUMINANCE8 : GL_RGBA8,
+                   image.cols, image.rows, 0, format, GL_UNSIGNED_BYTE, NULL);
+      texture_width_ = image.cols;
+      texture_height_ = image.rows;
+      texture_format_ = format;
+    }
+
+    bool uploaded = false;
+    if (GLEW_ARB_pixel_buffer_object)
+    {
+      // Staging the image in a pixel buffer lets the driver copy it into the
+      // texture without stalling the GUI thread.
+      const size_t bytes = image.step[0] * image.rows;
+      if (pixel_buffer_ == 0)
+      {
+        glGenBuffers(1, &pixel_buffer_);
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer_);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+      void* dest = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+      if (dest)
+      {
+        std::memcpy(dest, image.data, bytes);
+        uploaded = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        if (uploaded)
+        {
+          glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.cols, image.rows,
+                          format, GL_UNSIGNED_BYTE, 0);
+        }
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (!uploaded)
+    {
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.cols, image.rows,
+                      format, GL_UNSIGNED_BYTE, image.data);
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    generateMipmaps();
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
   void ImagePlugin::PrintError(const std::string& message)
   {
     PrintErrorHelper(ui_.status, message);
@@ -375,50 +549,10 @@ namespace mapviz_plugins
     return true;
   }
 
-  void ImagePlugin::ScaleImage(double width, double height)
-  {
-    if (!has_image_)
-    {
-      return;
-    }
-
-    cv::resize(cv_image_->image, scaled_image_, cvSize2D32f(width, height), 0, 0, CV_INTER_AREA);
-  }
-
-  void ImagePlugin::DrawIplImage(cv::Mat *image)
-  {
-    // TODO(malban) glTexture2D may be more efficient than glDrawPixels
-
-    if (image == NULL || image->cols == 0 || image->rows == 0)
-    {
-      return;
-    }
-
-    GLenum format;
-    switch (image->channels())
-    {
-      case 1:
-        format = GL_LUMINANCE;
-        break;
-      case 2:
-        format = GL_LUMINANCE_ALPHA;
-        break;
-      case 3:
-        format = GL_BGR;
-        break;
-      default:
-        return;
-    }
-
-    glPixelZoom(1.0f, -1.0f);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glDrawPixels(image->cols, image->rows, format, GL_UNSIGNED_BYTE, image->ptr());
-
-    PrintInfo("OK");
-  }
-
   void ImagePlugin::Draw(double x, double y, double scale)
   {
+    AdmitLatestImage();
+
     // Calculate the correct offsets and dimensions
     double x_offset = offset_x_;
     double y_offset = offset_y_;
@@ -438,10 +572,9 @@ namespace mapviz_plugins
       height = original_aspect_ratio_ * width;
     }
 
-    // Scale the source image if necessary
-    if (width != last_width_ || height != last_height_)
+    if (!has_image_)
     {
-      ScaleImage(width, height);
+      return;
     }
 
     // Calculate the correct render position
@@ -497,15 +630,26 @@ namespace mapviz_plugins
     glPushMatrix();
     glLoadIdentity();
     glOrtho(0, canvas_->width(), canvas_->height(), 0, -0.5f, 0.5f);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
 
-    glRasterPos2d(x_pos, y_pos);
-
-    DrawIplImage(&scaled_image_);
+    // The texture is sampled at whatever size it's drawn, so resizing the
+    // overlay costs nothing.
+    std::vector<mapviz::TexturedVertex> quad;
+    quad.reserve(4);
+    quad.push_back(mapviz::TexturedVertex(x_pos, y_pos, 0, 0));
+    quad.push_back(mapviz::TexturedVertex(x_pos + width, y_pos, 1, 0));
+    quad.push_back(mapviz::TexturedVertex(x_pos + width, y_pos + height, 1, 1));
+    quad.push_back(mapviz::TexturedVertex(x_pos, y_pos + height, 0, 1));
+    renderer_->DrawTexturedQuads(texture_, quad);
 
     glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
 
-    last_width_ = width;
-    last_height_ = height;
+    PrintInfo("OK");
   }
 
   void ImagePlugin::LoadConfig(const YAML::Node& node, const std::string& path)
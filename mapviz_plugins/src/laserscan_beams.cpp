@@ -0,0 +1,164 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <mapviz_plugins/laserscan_beams.h>
+
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+// Boost libraries
+#include <boost/make_shared.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
+#include <boost/weak_ptr.hpp>
+
+// QT libraries
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace mapviz_plugins
+{
+  BeamTablePtr GetBeamTable(float angle_min, float angle_increment, size_t count)
+  {
+    typedef boost::tuple<float, float, size_t> Key;
+    static QMutex mutex;
+    static std::map<Key, boost::weak_ptr<const BeamTable> > tables;
+
+    QMutexLocker locker(&mutex);
+
+    const Key key(angle_min, angle_increment, count);
+    BeamTablePtr table = tables[key].lock();
+    if (table)
+    {
+      return table;
+    }
+
+    // Tables nothing is using anymore don't need to be kept around
+    std::map<Key, boost::weak_ptr<const BeamTable> >::iterator it = tables.begin();
+    while (it != tables.end())
+    {
+      if (it->second.expired())
+      {
+        tables.erase(it++);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    boost::shared_ptr<BeamTable> new_table = boost::make_shared<BeamTable>();
+    new_table->angle_min = angle_min;
+    new_table->angle_increment = angle_increment;
+    new_table->count = count;
+    new_table->cos.resize(count);
+    new_table->sin.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+      double angle = angle_min + angle_increment * i;
+      new_table->cos[i] = static_cast<float>(std::cos(angle));
+      new_table->sin[i] = static_cast<float>(std::sin(angle));
+    }
+
+    tables[key] = new_table;
+    return new_table;
+  }
+
+  size_t ProjectBeams(const BeamTable& table,
+                      const float* ranges,
+                      const float* intensities,
+                      float range_min,
+                      float range_max,
+                      float* xy,
+                      float* kept_ranges,
+                      float* kept_intensities)
+  {
+    if (table.count == 0)
+    {
+      return 0;
+    }
+
+    const float* cos = &table.cos[0];
+    const float* sin = &table.sin[0];
+    const size_t count = table.count;
+
+    // Every beam is projected in a straight loop over the arrays, which the
+    // compiler vectorizes; the beams in range are only counted here.  NaN
+    // ranges fail both comparisons.
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      const float range = ranges[i];
+      xy[i * 2] = cos[i] * range;
+      xy[i * 2 + 1] = sin[i] * range;
+      kept += (range >= range_min) & (range <= range_max);
+    }
+
+    std::copy(ranges, ranges + count, kept_ranges);
+    if (kept_intensities)
+    {
+      if (intensities)
+      {
+        std::copy(intensities, intensities + count, kept_intensities);
+      }
+      else
+      {
+        std::fill(kept_intensities, kept_intensities + count, 0.0f);
+      }
+    }
+
+    if (kept == count)
+    {
+      return kept;
+    }
+
+    // Only scans with beams out of range pay for a second pass, which moves
+    // the kept beams down over the dropped ones.
+    size_t next = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      const float range = ranges[i];
+      if (range >= range_min && range <= range_max)
+      {
+        xy[next * 2] = xy[i * 2];
+        xy[next * 2 + 1] = xy[i * 2 + 1];
+        kept_ranges[next] = range;
+        if (kept_intensities)
+        {
+          kept_intensities[next] = kept_intensities[i];
+        }
+        next++;
+      }
+    }
+
+    return kept;
+  }
+}
@@ -33,6 +33,7 @@
 #include <cmath>
 #include <cstdio>
 #include <algorithm>
+#include <utility>
 #include <vector>
 
 // Boost libraries
@@ -59,6 +60,14 @@ PLUGINLIB_EXPORT_CLASS(mapviz_plugins::LaserScanPlugin, mapviz::MapvizPlugin)
 
 namespace mapviz_plugins
 {
+  namespace
+  {
+    // While persisting, scans are only buffered until they've been drawn
+    // into the history, but allow a few more than the buffer size so that
+    // scans arriving between frames aren't lost.
+    const size_t MIN_PENDING_SCANS = 64;
+  }
+
   LaserScanPlugin::LaserScanPlugin() :
       config_widget_(new QWidget()),
           topic_(""),
@@ -66,9 +75,9 @@ namespace mapviz_plugins
           min_value_(0.0),
           max_value_(100.0),
           point_size_(3),
-          prev_ranges_size_(0),
-          prev_angle_min_(0.0),
-          prev_increment_(0.0)
+          half_life_(0.0),
+          persistence_supported_(true),
+          project_on_gpu_(false)
   {
     ui_.setupUi(config_widget_);
 
@@ -138,6 +147,18 @@ namespace mapviz_plugins
         SIGNAL(stateChanged(int)),
         this,
         SLOT(UseRainbowChanged(int)));
+    QObject::connect(ui_.halfLife,
+        SIGNAL(valueChanged(double)),
+        this,
+        SLOT(HalfLifeChanged(double)));
+    QObject::connect(ui_.fixedFrame,
+        SIGNAL(editingFinished()),
+        this,
+        SLOT(FixedFrameEdited()));
+    QObject::connect(ui_.extent,
+        SIGNAL(valueChanged(double)),
+        this,
+        SLOT(ExtentChanged(double)));
 
     QObject::connect(ui_.max_color,
         SIGNAL(colorEdited(const QColor &)),
@@ -152,6 +173,9 @@ namespace mapviz_plugins
         this,
         SLOT(ResetTransformedScans()));
 
+    UpdateColors();
+    HalfLifeChanged(ui_.halfLife->value());
+
     PrintInfo("Constructed LaserScanPlugin");
   }
 
@@ -159,9 +183,17 @@ namespace mapviz_plugins
   {
   }
 
+  void LaserScanPlugin::Shutdown()
+  {
+    persistence_.Destroy();
+    colormap_.Destroy();
+  }
+
   void LaserScanPlugin::ClearHistory()
   {
+    incoming_scans_.Clear();
     scans_.clear();
+    persistence_.Clear();
   }
 
   void LaserScanPlugin::DrawIcon()
@@ -204,69 +236,181 @@ namespace mapviz_plugins
     {
       scan.transformed = false;
     }
+
+    if (fixed_frame_.empty())
+    {
+      // The history was kept in the old target frame
+      persistence_.Clear();
+    }
+  }
+
+  void LaserScanPlugin::HalfLifeChanged(double value)
+  {
+    const bool was_persisting = Persisting();
+    half_life_ = value;
+    persistence_.SetHalfLife(half_life_);
+    if (Persisting() != was_persisting)
+    {
+      // Scans are transformed to a different frame in each mode
+      ResetTransformedScans();
+      persistence_.Clear();
+    }
+
+    ui_.fixedFrame->setEnabled(half_life_ > 0);
+    ui_.extent->setEnabled(half_life_ > 0);
+    Q_EMIT Dirty();
+  }
+
+  void LaserScanPlugin::FixedFrameEdited()
+  {
+    std::string fixed_frame = ui_.fixedFrame->text().trimmed().toStdString();
+    if (fixed_frame != fixed_frame_)
+    {
+      fixed_frame_ = fixed_frame;
+      ResetTransformedScans();
+      persistence_.Clear();
+      Q_EMIT Dirty();
+    }
+  }
+
+  void LaserScanPlugin::ExtentChanged(double value)
+  {
+    persistence_.SetExtent(value);
+    Q_EMIT Dirty();
+  }
+
+  bool LaserScanPlugin::Persisting() const
+  {
+    return half_life_ > 0 && persistence_supported_;
   }
 
-  QColor LaserScanPlugin::CalculateColor(const StampedPoint& point,
-      bool has_intensity)
+  /**
+   * Updates the colormap used to color the scans.  This only touches the
+   * colormap, so it's cheap no matter how many points are buffered.
+   */
+  void LaserScanPlugin::UpdateColors()
   {
-    double val;
-    int color_transformer = ui_.color_transformer->currentIndex();
-    if (color_transformer == COLOR_RANGE)
+    if (ui_.color_transformer->currentIndex() == COLOR_FLAT)
     {
-      val = point.range;
+      colormap_.SetGradient(ui_.min_color->color(), ui_.min_color->color());
     }
-    else if (color_transformer == COLOR_INTENSITY && has_intensity)
+    else if (ui_.use_rainbow->isChecked())
     {
-      val = point.intensity;
+      colormap_.SetRainbow();
     }
-    else if (color_transformer == COLOR_X)
+    else
     {
-      val = point.point.x();
+      colormap_.SetGradient(ui_.min_color->color(), ui_.max_color->color());
     }
-    else if (color_transformer == COLOR_Y)
+    colormap_.SetRange(min_value_, max_value_);
+
+    Q_EMIT Dirty();
+  }
+
+  /**
+   * Recomputes the values that are colored for every scan; only needed when
+   * the color transformer changes.
+   */
+  void LaserScanPlugin::UpdateValues()
+  {
+    std::deque<Scan>::iterator scan_it = scans_.begin();
+    for (; scan_it != scans_.end(); ++scan_it)
     {
-      val = point.point.y();
+      UpdateScanValues(*scan_it);
     }
-    else if (color_transformer == COLOR_Z)
+  }
+
+  /**
+   * Fills in the values of a scan that don't already have a column of their
+   * own: Z, which depends on the transform, and intensity when the scan
+   * doesn't have any.
+   */
+  void LaserScanPlugin::UpdateScanValues(Scan& scan)
+  {
+    if (scan.message)
     {
-      val = point.transformed_point.z();
+      // The shader works out every value itself
+      return;
     }
-    else  // No intensity or  (color_transformer == COLOR_FLAT)
+
+    const int color_transformer = ui_.color_transformer->currentIndex();
+    const size_t count = scan.ranges.size();
+    if (color_transformer == COLOR_Z && scan.transformed)
     {
-      return ui_.min_color->color();
+      // The beams are at z = 0 in the source frame
+      const tf::Matrix3x3& basis = scan.transform.getBasis();
+      const float zx = basis[2][0];
+      const float zy = basis[2][1];
+      const float z0 = scan.transform.getOrigin().z();
+      scan.values.resize(count);
+      for (size_t i = 0; i < count; i++)
+      {
+        scan.values[i] = zx * scan.xy[i * 2] + zy * scan.xy[i * 2 + 1] + z0;
+      }
     }
-    if (max_value_ > min_value_)
-      val = (val - min_value_) / (max_value_ - min_value_);
-    val = std::max(0.0, std::min(val, 1.0));
-    if (ui_.use_rainbow->isChecked())
+    else if (color_transformer == COLOR_INTENSITY && !scan.has_intensity)
     {
-      // Hue Interpolation
-      int hue = static_cast<int>(val * 255);
-      return QColor::fromHsl(hue, 255, 127, 255);
+      // The bottom of the range maps to the min color
+      scan.values.assign(count, min_value_);
     }
     else
     {
-      const QColor min_color = ui_.min_color->color();
-      const QColor max_color = ui_.max_color->color();
-      // RGB Interpolation
-      int red, green, blue;
-      red = static_cast<int>(val * max_color.red()   + ((1.0 - val) * min_color.red()));
-      green = static_cast<int>(val * max_color.green() + ((1.0 - val) * min_color.green()));
-      blue = static_cast<int>(val * max_color.blue()  + ((1.0 - val) * min_color.blue()));
-      return QColor(red, green, blue, 255);
+      std::vector<float>().swap(scan.values);
     }
   }
 
-  void LaserScanPlugin::UpdateColors()
+  /**
+   * Picks the column that a scan is colored by.
+   * @param stride  Set to the number of floats between values
+   */
+  const float* LaserScanPlugin::ScanValues(const Scan& scan, size_t& stride) const
   {
-    std::deque<Scan>::iterator scan_it = scans_.begin();
-    for (; scan_it != scans_.end(); ++scan_it)
+    stride = 1;
+    if (!scan.values.empty())
     {
-      std::vector<StampedPoint>::iterator point_it = scan_it->points.begin();
-      for (; point_it != scan_it->points.end(); point_it++)
-      {
-        point_it->color = CalculateColor(*point_it, scan_it->has_intensity);
-      }
+      return &scan.values[0];
+    }
+
+    switch (ui_.color_transformer->currentIndex())
+    {
+      case COLOR_INTENSITY:
+        return &scan.intensities[0];
+      case COLOR_X:
+        stride = 2;
+        return &scan.xy[0];
+      case COLOR_Y:
+        stride = 2;
+        return &scan.xy[1];
+      case COLOR_FLAT:
+      case COLOR_RANGE:
+      default:
+        // A flat colormap is the same color everywhere, so any column does
+        return &scan.ranges[0];
+    }
+  }
+
+  /**
+   * Picks what the beam shader colors a scan that's projected on the GPU by.
+   * @param constant  Set to the value used for BEAM_CONSTANT
+   */
+  mapviz::BeamValue LaserScanPlugin::BeamSource(const Scan& scan, float& constant) const
+  {
+    constant = min_value_;
+    switch (ui_.color_transformer->currentIndex())
+    {
+      case COLOR_INTENSITY:
+        return scan.has_intensity ? mapviz::BEAM_INTENSITY : mapviz::BEAM_CONSTANT;
+      case COLOR_RANGE:
+        return mapviz::BEAM_RANGE;
+      case COLOR_X:
+        return mapviz::BEAM_X;
+      case COLOR_Y:
+        return mapviz::BEAM_Y;
+      case COLOR_Z:
+        return mapviz::BEAM_Z;
+      case COLOR_FLAT:
+      default:
+        return mapviz::BEAM_CONSTANT;
     }
   }
 
@@ -288,7 +432,9 @@ namespace mapviz_plugins
     if (topic != topic_)
     {
       initialized_ = false;
+      incoming_scans_.Clear();
       scans_.clear();
+      persistence_.Clear();
       has_message_ = false;
       PrintWarning("No messages received.");
 
@@ -310,6 +456,11 @@ namespace mapviz_plugins
   void LaserScanPlugin::MinValueChanged(double value)
   {
     min_value_ = value;
+    if (ui_.color_transformer->currentIndex() == COLOR_INTENSITY)
+    {
+      // Scans without intensities are drawn at the min value
+      UpdateValues();
+    }
     UpdateColors();
   }
 
@@ -337,28 +488,6 @@ namespace mapviz_plugins
     point_size_ = static_cast<size_t>(value);
   }
 
-  void LaserScanPlugin::updatePreComputedTriginometic(const sensor_msgs::LaserScanConstPtr& msg)
-  {
-      if( msg->ranges.size() != prev_ranges_size_ ||
-          msg->angle_min !=  prev_angle_min_  ||
-          msg->angle_increment != prev_increment_   )
-      {
-          prev_ranges_size_ = msg->ranges.size();
-          prev_angle_min_ = msg->angle_min;
-          prev_increment_ = msg->angle_increment;
-
-          precomputed_cos_.resize( msg->ranges.size() );
-          precomputed_sin_.resize( msg->ranges.size() );
-
-          for (size_t i = 0; i < msg->ranges.size(); i++)
-          {
-              double angle = msg->angle_min + msg->angle_increment * i;
-              precomputed_cos_[i] = cos(angle);
-              precomputed_sin_[i] = sin(angle);
-          }
-      }
-  }
-
   bool LaserScanPlugin::GetScanTransform(const Scan& scan, swri_transform_util::Transform& transform)
   {
       bool was_using_latest_transforms = this->use_latest_transforms_;
@@ -376,6 +505,22 @@ namespace mapviz_plugins
       return has_tranform;
   }
 
+  /**
+   * Gets the transform that a scan is drawn into the persistent history
+   * with.
+   */
+  bool LaserScanPlugin::GetFixedTransform(const Scan& scan, swri_transform_util::Transform& transform)
+  {
+    if (fixed_frame_.empty())
+    {
+      return GetScanTransform(scan, transform);
+    }
+
+    return tf_manager_->GetTransform(fixed_frame_, scan.source_frame_, scan.stamp, transform) ||
+        (use_latest_transforms_ &&
+         tf_manager_->GetTransform(fixed_frame_, scan.source_frame_, ros::Time(), transform));
+  }
+
   void LaserScanPlugin::laserScanCallback(const sensor_msgs::LaserScanConstPtr& msg)
   {
     if (!has_message_)
@@ -389,51 +534,71 @@ namespace mapviz_plugins
     // messages with different source frames, so we need to store and transform
     // them individually.
 
+    // This runs on the plugin's callback thread, so only decode the ranges
+    // here; coloring and transforming depend on the GUI settings and the
+    // target frame and are done in Transform().
     Scan scan;
     scan.stamp = msg->header.stamp;
     scan.color = QColor::fromRgbF(1.0f, 0.0f, 0.0f, 1.0f);
     scan.source_frame_ = msg->header.frame_id;
+    scan.transformed = false;
     scan.has_intensity = !msg->intensities.empty();
-    scan.points.reserve( msg->ranges.size() );
 
-    double x, y;
-    updatePreComputedTriginometic(msg);
+    const size_t count = msg->ranges.size();
+    if (project_on_gpu_)
+    {
+      // The ranges are uploaded as they are and the shader does the rest, so
+      // there's nothing to decode; just hold on to the message.
+      scan.has_intensity = msg->intensities.size() >= count;
+      scan.message = msg;
+      incoming_scans_.Post(std::move(scan));
 
-    swri_transform_util::Transform transform;
-    scan.transformed = GetScanTransform(scan, transform);
+      Q_EMIT Dirty();
+      return;
+    }
 
-    for (size_t i = 0; i < msg->ranges.size(); i++)
+    if (!beam_table_ ||
+        beam_table_->count != count ||
+        beam_table_->angle_min != msg->angle_min ||
+        beam_table_->angle_increment != msg->angle_increment)
     {
-      // Discard the point if it's out of range
-      if (msg->ranges[i] > msg->range_max || msg->ranges[i] < msg->range_min)
-      {
-        continue;
-      }
-      StampedPoint point;
-      x = precomputed_cos_[i] * msg->ranges[i];
-      y = precomputed_sin_[i] * msg->ranges[i];
-      point.point = tf::Point(x, y, 0.0f);
-      point.range = msg->ranges[i];
-      if (i < msg->intensities.size())
-        point.intensity = msg->intensities[i];
-
-      if (scan.transformed)
-      {
-        point.transformed_point = transform * point.point;
-      }
-      point.color = CalculateColor(point, scan.has_intensity);
-      scan.points.push_back(point);
+      beam_table_ = GetBeamTable(msg->angle_min, msg->angle_increment, count);
     }
-    scans_.push_back(scan);
 
-    // If there are more items in the scan buffer than buffer_size_, remove them
-    if (buffer_size_ > 0)
+    // Project every beam, dropping the ones that are out of range, and then
+    // trim the columns to the beams that were kept.
+    const bool has_all_intensities = msg->intensities.size() >= count;
+    scan.xy.resize(count * 2);
+    scan.ranges.resize(count);
+    if (scan.has_intensity)
     {
-      while (scans_.size() > buffer_size_)
-      {
-        scans_.pop_front();
-      }
+      scan.intensities.resize(count);
     }
+    const size_t kept = ProjectBeams(*beam_table_,
+        count > 0 ? &msg->ranges[0] : NULL,
+        count > 0 && has_all_intensities ? &msg->intensities[0] : NULL,
+        msg->range_min,
+        msg->range_max,
+        count > 0 ? &scan.xy[0] : NULL,
+        count > 0 ? &scan.ranges[0] : NULL,
+        scan.has_intensity && count > 0 ? &scan.intensities[0] : NULL);
+    scan.xy.resize(kept * 2);
+    scan.ranges.resize(kept);
+    if (scan.has_intensity)
+    {
+      scan.intensities.resize(kept);
+    }
+    if (kept < count)
+    {
+      // Give back what the out of range beams took
+      std::vector<float>(scan.xy).swap(scan.xy);
+      std::vector<float>(scan.ranges).swap(scan.ranges);
+      std::vector<float>(scan.intensities).swap(scan.intensities);
+    }
+
+    incoming_scans_.Post(std::move(scan));
+
+    Q_EMIT Dirty();
   }
 
   void LaserScanPlugin::PrintError(const std::string& message)
@@ -469,31 +634,119 @@ namespace mapviz_plugins
 
   void LaserScanPlugin::Draw(double x, double y, double scale)
   {
-    glPointSize(point_size_);
-    glBegin(GL_POINTS);
+    project_on_gpu_ = renderer_->Initialize() && renderer_->ShadersSupported();
+
+    if (half_life_ > 0 && persistence_supported_ && !ScanPersistence::Supported())
+    {
+      // Without framebuffer objects the history can't be kept; fall back to
+      // drawing the buffered scans.
+      persistence_supported_ = false;
+      ResetTransformedScans();
+    }
+
+    if (Persisting())
+    {
+      DrawPersistence();
+      return;
+    }
 
     std::deque<Scan>::const_iterator scan_it = scans_.begin();
     while (scan_it != scans_.end())
     {
       if (scan_it->transformed)
       {
-        std::vector<StampedPoint>::const_iterator point_it = scan_it->points.begin();
-        for (; point_it != scan_it->points.end(); ++point_it)
-        {
-          glColor4d(
-              point_it->color.redF(),
-              point_it->color.greenF(),
-              point_it->color.blueF(),
-              alpha_);
-          glVertex2d(
-              point_it->transformed_point.getX(),
-              point_it->transformed_point.getY());
-        }
+        DrawScan(*scan_it, alpha_);
       }
       ++scan_it;
     }
 
-    glEnd();
+    if (half_life_ > 0)
+    {
+      PrintWarning("Persistence needs framebuffer objects, which aren't supported.");
+    }
+    else
+    {
+      PrintInfo("OK");
+    }
+  }
+
+  /**
+   * Draws a scan that has been transformed, through its transform.
+   */
+  void LaserScanPlugin::DrawScan(const Scan& scan, float alpha)
+  {
+    if (scan.message)
+    {
+      const sensor_msgs::LaserScan& msg = *scan.message;
+      mapviz::BeamScan beams;
+      beams.count = msg.ranges.size();
+      beams.ranges = beams.count > 0 ? &msg.ranges[0] : NULL;
+      beams.intensities = scan.has_intensity && beams.count > 0 ? &msg.intensities[0] : NULL;
+      beams.angle_min = msg.angle_min;
+      beams.angle_increment = msg.angle_increment;
+      beams.range_min = msg.range_min;
+      beams.range_max = msg.range_max;
+
+      float constant;
+      const mapviz::BeamValue source = BeamSource(scan, constant);
+      renderer_->DrawBeams(beams, scan.transform, source, constant,
+          colormap_, alpha, point_size_);
+    }
+    else if (!scan.ranges.empty())
+    {
+      size_t stride;
+      const float* values = ScanValues(scan, stride);
+      mapviz::Renderer::PushTransform(scan.transform);
+      renderer_->DrawScalarPoints(&scan.xy[0], values, stride,
+          scan.ranges.size(), colormap_, alpha, point_size_);
+      mapviz::Renderer::PopTransform();
+    }
+  }
+
+  /**
+   * Draws the scans that have come in since the last frame into the
+   * persistent history, which they're then dropped in favor of, and draws
+   * the history.
+   */
+  void LaserScanPlugin::DrawPersistence()
+  {
+    persistence_.Fade(renderer_, ros::Time::now().toSec());
+
+    std::deque<Scan>::iterator scan_it = scans_.begin();
+    while (scan_it != scans_.end())
+    {
+      if (!scan_it->transformed)
+      {
+        ++scan_it;
+        continue;
+      }
+
+      // The history follows the sensor around
+      const tf::Vector3& origin = scan_it->transform.getOrigin();
+      if (!persistence_.Begin(renderer_, origin.x(), origin.y()))
+      {
+        PrintError("Failed to draw into the persistent history.");
+        return;
+      }
+      // The history's opacity is applied when it's drawn
+      DrawScan(*scan_it, 1.0f);
+      persistence_.End();
+
+      scan_it = scans_.erase(scan_it);
+    }
+
+    tf::Transform fixed_to_target = tf::Transform::getIdentity();
+    if (!fixed_frame_.empty())
+    {
+      swri_transform_util::Transform transform;
+      if (!tf_manager_->GetTransform(target_frame_, fixed_frame_, ros::Time(), transform))
+      {
+        PrintError("No transform between " + fixed_frame_ + " and " + target_frame_);
+        return;
+      }
+      fixed_to_target = transform.GetTF();
+    }
+    persistence_.Draw(renderer_, fixed_to_target, alpha_);
 
     PrintInfo("OK");
   }
@@ -519,6 +772,29 @@ namespace mapviz_plugins
 
   void LaserScanPlugin::Transform()
   {
+    std::deque<Scan> incoming;
+    if (incoming_scans_.Take(incoming))
+    {
+      for (Scan& scan: incoming)
+      {
+        scans_.push_back(std::move(scan));
+      }
+
+      // If there are more items in the scan buffer than buffer_size_, remove them
+      size_t max_scans = buffer_size_;
+      if (Persisting() && max_scans > 0)
+      {
+        max_scans = std::max(max_scans, MIN_PENDING_SCANS);
+      }
+      if (max_scans > 0)
+      {
+        while (scans_.size() > max_scans)
+        {
+          scans_.pop_front();
+        }
+      }
+    }
+
     std::deque<Scan>::iterator scan_it = scans_.begin();
     for (; scan_it != scans_.end(); ++scan_it)
     {
@@ -526,28 +802,25 @@ namespace mapviz_plugins
 
       if( !scan.transformed )
       {
+          // Only the scan's transform is resolved here; its points stay in
+          // the source frame and the transform is applied when drawing.
           swri_transform_util::Transform transform;
+          const bool has_transform = Persisting() ?
+              GetFixedTransform(scan, transform) :
+              GetScanTransform(scan, transform);
 
-          if ( GetScanTransform( scan, transform) )
+          if ( has_transform )
           {
+              scan.transform = transform.GetTF();
               scan.transformed = true;
-              std::vector<StampedPoint>::iterator point_it = scan.points.begin();
-              for (; point_it != scan.points.end(); ++point_it)
-              {
-                  point_it->transformed_point = transform * point_it->point;
-              }
+              UpdateScanValues(scan);
           }
           else{
-              PrintError("No transform between " + scan.source_frame_ + " and " + target_frame_);
+              const std::string& frame = Persisting() && !fixed_frame_.empty() ? fixed_frame_ : target_frame_;
+              PrintError("No transform between " + scan.source_frame_ + " and " + frame);
           }
       }
     }
-    // Z color is based on transformed color, so it is dependent on the
-    // transform
-    if (ui_.color_transformer->currentIndex() == COLOR_Z)
-    {
-      UpdateColors();
-    }
   }
 
   void LaserScanPlugin::LoadConfig(const YAML::Node& node,
@@ -630,6 +903,28 @@ namespace mapviz_plugins
       ui_.use_rainbow->setChecked(use_rainbow);
     }
 
+    if (node["fixed_frame"])
+    {
+      std::string fixed_frame;
+      node["fixed_frame"] >> fixed_frame;
+      ui_.fixedFrame->setText(QString::fromStdString(fixed_frame));
+      FixedFrameEdited();
+    }
+
+    if (node["persistent_area"])
+    {
+      double extent;
+      node["persistent_area"] >> extent;
+      ui_.extent->setValue(extent);
+    }
+
+    if (node["half_life"])
+    {
+      double half_life;
+      node["half_life"] >> half_life;
+      ui_.halfLife->setValue(half_life);
+    }
+
     // UseRainbowChanged must be called *before* ColorTransformerChanged
     UseRainbowChanged(ui_.use_rainbow->checkState());
     // ColorTransformerChanged will also update colors of all points
@@ -669,6 +964,7 @@ namespace mapviz_plugins
         ui_.use_rainbow->setVisible(true);
         break;
     }
+    UpdateValues();
     UpdateColors();
   }
 
@@ -678,6 +974,7 @@ namespace mapviz_plugins
   void LaserScanPlugin::AlphaEdited(double val)
   {
     alpha_ = std::max(0.0f, std::min((float)val, 1.0f));
+    Q_EMIT Dirty();
   }
 
   void LaserScanPlugin::SaveConfig(YAML::Emitter& emitter,
@@ -703,6 +1000,12 @@ namespace mapviz_plugins
                YAML::Value << ui_.maxValue->text().toDouble();
     emitter << YAML::Key << "use_rainbow" <<
                YAML::Value << ui_.use_rainbow->isChecked();
+    emitter << YAML::Key << "half_life" <<
+               YAML::Value << half_life_;
+    emitter << YAML::Key << "fixed_frame" <<
+               YAML::Value << fixed_frame_;
+    emitter << YAML::Key << "persistent_area" <<
+               YAML::Value << persistence_.Extent();
   }
 }
 
@@ -29,6 +29,10 @@
 
 #include <mapviz_plugins/marker_plugin.h>
 
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+
 #include <mapviz/select_topic_dialog.h>
 
 #include <swri_math_util/constants.h>
@@ -44,9 +48,51 @@ namespace mapviz_plugins
 #define IS_INSTANCE(msg, type) \
   (msg->getDataType() == ros::message_traits::datatype<type>())
 
+  namespace
+  {
+    inline uint8_t colorByte(float value)
+    {
+      return static_cast<uint8_t>(std::max(0.0f, std::min(value, 1.0f)) * 255.0f);
+    }
+
+    // Sizes of a serialized geometry_msgs/Point and std_msgs/ColorRGBA
+    const uint32_t POINT_SIZE = 3 * sizeof(double);
+    const uint32_t COLOR_SIZE = 4 * sizeof(float);
+
+    /**
+     * Skips count elements of a fixed size, checking the count first so that
+     * a corrupt one can't overflow.
+     * @return The start of the elements
+     */
+    uint8_t* skipElements(ros::serialization::IStream& stream, uint32_t count, uint32_t element_size)
+    {
+      if (count > stream.getLength() / element_size)
+      {
+        throw ros::serialization::StreamOverrunException(
+            "Array runs past the end of the message");
+      }
+      return stream.advance(count * element_size);
+    }
+
+    void skipString(ros::serialization::IStream& stream)
+    {
+      uint32_t length;
+      stream.next(length);
+      stream.advance(length);
+    }
+
+    void skipArray(ros::serialization::IStream& stream, uint32_t element_size)
+    {
+      uint32_t length;
+      stream.next(length);
+      skipElements(stream, length, element_size);
+    }
+  }
+
   MarkerPlugin::MarkerPlugin() :
     config_widget_(new QWidget()),
-    connected_(false)
+    connected_(false),
+    font_("Helvetica", 10)
   {
     ui_.setupUi(config_widget_);
 
@@ -71,10 +117,20 @@ namespace mapviz_plugins
   {
   }
 
+  void MarkerPlugin::Shutdown()
+  {
+    text_.Destroy();
+    for (auto& entry: groups_)
+    {
+      entry.second.vertices.Destroy();
+      entry.second.instances.Destroy();
+    }
+  }
+
   void MarkerPlugin::ClearHistory()
   {
     ROS_INFO("Marker Clear all");
-    markers_.clear();
+    clearMarkers();
   }
 
   void MarkerPlugin::SelectTopic()
@@ -98,7 +154,7 @@ namespace mapviz_plugins
     if (topic != topic_)
     {
       initialized_ = false;
-      markers_.clear();
+      clearMarkers();
       has_message_ = false;
       PrintWarning("No messages received.");
 
@@ -119,24 +175,89 @@ namespace mapviz_plugins
   void MarkerPlugin::handleMessage(const topic_tools::ShapeShifter::ConstPtr& msg)
   {
     connected_ = true;
-    if (IS_INSTANCE(msg, visualization_msgs::Marker))
+    const bool is_marker = IS_INSTANCE(msg, visualization_msgs::Marker);
+    if (!is_marker && !IS_INSTANCE(msg, visualization_msgs::MarkerArray))
     {
-      handleMarker(*(msg->instantiate<visualization_msgs::Marker>()));
+      PrintError("Unknown message type: " + msg->getDataType());
+      Q_EMIT Dirty();
+      return;
     }
-    else if (IS_INSTANCE(msg, visualization_msgs::MarkerArray))
+
+    // Markers are read straight out of the serialized message into
+    // markers_, rather than instantiating the message and then copying
+    // every point out of it again.
+    message_buffer_.resize(msg->size());
+    ros::serialization::OStream out(message_buffer_.data(), message_buffer_.size());
+    msg->write(out);
+
+    ros::serialization::IStream in(message_buffer_.data(), message_buffer_.size());
+    try
     {
-      handleMarkerArray(*(msg->instantiate<visualization_msgs::MarkerArray>()));
+      if (is_marker)
+      {
+        handleMarker(in);
+      }
+      else
+      {
+        uint32_t count;
+        in.next(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+          handleMarker(in);
+        }
+      }
     }
-    else
+    catch (const ros::serialization::StreamOverrunException& e)
     {
-      PrintError("Unknown message type: " + msg->getDataType());
+      PrintError(std::string("Truncated marker message: ") + e.what());
     }
+
+    Q_EMIT Dirty();
   }
 
-  void MarkerPlugin::handleMarker(const visualization_msgs::Marker &marker)
+  /**
+   * Reads one serialized visualization_msgs/Marker, leaving the stream at
+   * the end of it.
+   */
+  void MarkerPlugin::handleMarker(ros::serialization::IStream& stream)
   {
-    if (marker.type == visualization_msgs::Marker::ARROW &&
-        marker.points.size() == 1)
+    // Everything up to the points is small and fixed, so it's read as is.
+    std_msgs::Header header;
+    MarkerId id;
+    int32_t type;
+    int32_t action;
+    geometry_msgs::Pose pose;
+    geometry_msgs::Vector3 scale;
+    std_msgs::ColorRGBA color;
+    ros::Duration lifetime;
+    uint8_t frame_locked;
+    uint32_t point_count;
+    stream.next(header);
+    stream.next(id.first);
+    stream.next(id.second);
+    stream.next(type);
+    stream.next(action);
+    stream.next(pose);
+    stream.next(scale);
+    stream.next(color);
+    stream.next(lifetime);
+    stream.next(frame_locked);
+    stream.next(point_count);
+
+    if (action != visualization_msgs::Marker::ADD ||
+        (type == visualization_msgs::Marker::ARROW && point_count == 1))
+    {
+      // Skip the points, colors, text, mesh_resource and
+      // mesh_use_embedded_materials
+      skipElements(stream, point_count, POINT_SIZE);
+      skipArray(stream, COLOR_SIZE);
+      skipString(stream);
+      skipString(stream);
+      stream.advance(1);
+    }
+
+    if (type == visualization_msgs::Marker::ARROW &&
+        point_count == 1)
     {
       // Arrow markers must have either 0 or >1 points; exactly one point is
       // invalid.  If we get one with 1 point, assume it's corrupt and ignore it.
@@ -153,170 +274,388 @@ namespace mapviz_plugins
     // messages with different source frames, so we need to store and transform
     // them individually.
 
-    if (marker.action == visualization_msgs::Marker::ADD)
-    {
-      MarkerData& markerData = markers_[std::make_pair(marker.ns, marker.id)];
-      markerData.points.clear(); // clear marker points
-      markerData.text.clear(); // clear marker text
-      markerData.stamp = marker.header.stamp;
-      markerData.display_type = marker.type;
-      markerData.color = {marker.color.r, marker.color.g, marker.color.b, marker.color.a};
-      markerData.scale_x = static_cast<float>(marker.scale.x);
-      markerData.scale_y = static_cast<float>(marker.scale.y);
-      markerData.scale_z = static_cast<float>(marker.scale.z);
-      markerData.transformed = true;
-      markerData.source_frame = marker.header.frame_id;
-
-
-      // Since orientation was not implemented, many markers publish
-      // invalid all-zero orientations, so we need to check for this
-      // and provide a default identity transform.
-      tf::Quaternion orientation(0.0, 0.0, 0.0, 1.0);
-      if (marker.pose.orientation.x ||
-          marker.pose.orientation.y ||
-          marker.pose.orientation.z ||
-          marker.pose.orientation.w)
+    if (action == visualization_msgs::Marker::ADD)
+    {
+      auto existing = markers_.find(id);
+      if (existing != markers_.end())
       {
-        orientation = tf::Quaternion(marker.pose.orientation.x,
-                                     marker.pose.orientation.y,
-                                     marker.pose.orientation.z,
-                                     marker.pose.orientation.w);
+        unindexMarker(id, existing->second);
       }
 
-      markerData.local_transform = tf::Transform(
-          orientation,
-          tf::Vector3(marker.pose.position.x,
-                      marker.pose.position.y,
-                      marker.pose.position.z));
-
-      markerData.points.clear();
-      markerData.text = std::string();
+      MarkerData& markerData = markers_[id];
+      try
+      {
+        readMarker(stream, header, type, pose, scale, color, lifetime, point_count, markerData);
+      }
+      catch (...)
+      {
+        // The marker was only partly read, so it's dropped
+        markers_.erase(id);
+        throw;
+      }
 
-      swri_transform_util::Transform transform;
-      if (!GetTransform(markerData.source_frame, marker.header.stamp, transform))
+      indexMarker(id, markerData);
+    }
+    else if (action == visualization_msgs::Marker::DELETE)
+    {
+      auto existing = markers_.find(id);
+      if (existing != markers_.end())
       {
-        markerData.transformed = false;
-        PrintError("No transform between " + markerData.source_frame + " and " + target_frame_);
+        unindexMarker(id, existing->second);
+        markers_.erase(existing);
       }
+    }
+    else if (action == 3) // The DELETEALL enum doesn't exist in Indigo
+    {
+      clearMarkers();
+    }
+  }
+
+  /**
+   * Fills in an added marker, reading its points, colors and text straight
+   * from the stream.
+   */
+  void MarkerPlugin::readMarker(ros::serialization::IStream& stream,
+                                const std_msgs::Header& header,
+                                int32_t type,
+                                const geometry_msgs::Pose& pose,
+                                const geometry_msgs::Vector3& scale,
+                                const std_msgs::ColorRGBA& color,
+                                const ros::Duration& lifetime,
+                                uint32_t point_count,
+                                MarkerData& markerData)
+  {
+    markerData.points.clear(); // clear marker points
+    markerData.text.clear(); // clear marker text
+    markerData.layout.reset();
+    markerData.stamp = header.stamp;
+    markerData.display_type = type;
+    markerData.color = {color.r, color.g, color.b, color.a};
+    markerData.scale_x = static_cast<float>(scale.x);
+    markerData.scale_y = static_cast<float>(scale.y);
+    markerData.scale_z = static_cast<float>(scale.z);
+    // Markers are transformed along with the rest of their frame
+    markerData.transformed = false;
+
+    // Spheres may be specified w/ only one scale value
+    if ((markerData.display_type == visualization_msgs::Marker::CYLINDER ||
+         markerData.display_type == visualization_msgs::Marker::SPHERE ||
+         markerData.display_type == visualization_msgs::Marker::SPHERE_LIST) &&
+        markerData.scale_y == 0.0)
+    {
+      markerData.scale_y = markerData.scale_x;
+    }
+    markerData.source_frame = header.frame_id;
+
+
+    // Since orientation was not implemented, many markers publish
+    // invalid all-zero orientations, so we need to check for this
+    // and provide a default identity transform.
+    tf::Quaternion orientation(0.0, 0.0, 0.0, 1.0);
+    if (pose.orientation.x ||
+        pose.orientation.y ||
+        pose.orientation.z ||
+        pose.orientation.w)
+    {
+      orientation = tf::Quaternion(pose.orientation.x,
+                                   pose.orientation.y,
+                                   pose.orientation.z,
+                                   pose.orientation.w);
+    }
+
+    markerData.local_transform = tf::Transform(
+        orientation,
+        tf::Vector3(pose.position.x,
+                    pose.position.y,
+                    pose.position.z));
+
+    // Handle lifetime parameter
+    if (lifetime.isZero())
+    {
+      markerData.expire_time = ros::TIME_MAX;
+    }
+    else
+    {
+      // Temporarily add 5 seconds to fix some existing markers.
+      markerData.expire_time = ros::Time::now() + lifetime + ros::Duration(5);
+    }
+
+    bool has_text = false;
+    bool per_point_colors = false;
+    if (markerData.display_type == visualization_msgs::Marker::ARROW)
+    {
+      StampedPoint point;
+      point.color = markerData.color;
+      point.orientation = orientation;
 
-      // Handle lifetime parameter
-      ros::Duration lifetime = marker.lifetime;
-      if (lifetime.isZero())
+      if (point_count == 0)
       {
-        markerData.expire_time = ros::TIME_MAX;
+        // If the "points" array is empty, we'll use the pose as the base of
+        // the arrow and scale its size based on the scale_x value.
+        point.point = markerData.local_transform * tf::Point(0.0, 0.0, 0.0);
+        point.arrow_point = markerData.local_transform * tf::Point(1.0, 0.0, 0.0);
       }
       else
       {
-        // Temporarily add 5 seconds to fix some existing markers.
-        markerData.expire_time = ros::Time::now() + lifetime + ros::Duration(5);
+        // Otherwise the "points" array should have exactly two values, the
+        // start and end of the arrow.
+        point.point = markerData.local_transform * readPoint(stream);
+        point.arrow_point = markerData.local_transform * readPoint(stream);
+        skipElements(stream, point_count - 2, POINT_SIZE);
       }
 
-      if (markerData.display_type == visualization_msgs::Marker::ARROW)
+      markerData.points.push_back(point);
+
+      if (point_count != 0)
       {
-        StampedPoint point;
-        point.color = markerData.color;
-        point.orientation = orientation;
+        // The point we just pushed back has both the start and end of the
+        // arrow, so the point we're pushing here is useless; we use it later
+        // only to indicate whether the original message had two points or not.
+        markerData.points.push_back(StampedPoint());
+      }
+    }
+    else if (markerData.display_type == visualization_msgs::Marker::CYLINDER ||
+      markerData.display_type == visualization_msgs::Marker::SPHERE ||
+      markerData.display_type == visualization_msgs::Marker::TEXT_VIEW_FACING)
+    {
+      StampedPoint point;
+      point.point = tf::Point(0.0, 0.0, 0.0);
+      point.color = markerData.color;
+      markerData.points.push_back(point);
+      has_text = true;
+      skipElements(stream, point_count, POINT_SIZE);
+    }
+    else if (markerData.display_type == visualization_msgs::Marker::CUBE)
+    {
+      StampedPoint point;
+      point.color = markerData.color;
 
-        if (marker.points.empty())
-        {
-          // If the "points" array is empty, we'll use the pose as the base of
-          // the arrow and scale its size based on the scale_x value.
-          point.point = markerData.local_transform * tf::Point(0.0, 0.0, 0.0);
-          point.arrow_point = markerData.local_transform * tf::Point(1.0, 0.0, 0.0);
-        }
-        else
-        {
-          // Otherwise the "points" array should have exactly two values, the
-          // start and end of the arrow.
-          point.point = markerData.local_transform * tf::Point(marker.points[0].x, marker.points[0].y, marker.points[0].z);
-          point.arrow_point = markerData.local_transform * tf::Point(marker.points[1].x, marker.points[1].y, marker.points[1].z);
-        }
+      point.point = tf::Point(scale.x / 2, scale.y / 2, 0.0);
+      markerData.points.push_back(point);
 
-        markerData.points.push_back(point);
+      point.point = tf::Point(-scale.x / 2, scale.y / 2, 0.0);
+      markerData.points.push_back(point);
 
-        if (!marker.points.empty())
-        {
-          // The point we just pushed back has both the start and end of the
-          // arrow, so the point we're pushing here is useless; we use it later
-          // only to indicate whether the original message had two points or not.
-          markerData.points.push_back(StampedPoint());
-        }
+      point.point = tf::Point(-scale.x / 2, -scale.y / 2, 0.0);
+      markerData.points.push_back(point);
 
-        transformArrow(markerData, transform);
-      }
-      else if (markerData.display_type == visualization_msgs::Marker::CYLINDER ||
-        markerData.display_type == visualization_msgs::Marker::SPHERE ||
-        markerData.display_type == visualization_msgs::Marker::TEXT_VIEW_FACING)
+      point.point = tf::Point(scale.x / 2, -scale.y / 2, 0.0);
+      markerData.points.push_back(point);
+      skipElements(stream, point_count, POINT_SIZE);
+    }
+    else if (markerData.display_type == visualization_msgs::Marker::LINE_STRIP ||
+      markerData.display_type == visualization_msgs::Marker::LINE_LIST ||
+      markerData.display_type == visualization_msgs::Marker::CUBE_LIST ||
+      markerData.display_type == visualization_msgs::Marker::SPHERE_LIST ||
+      markerData.display_type == visualization_msgs::Marker::POINTS ||
+      markerData.display_type == visualization_msgs::Marker::TRIANGLE_LIST)
+    {
+      // Make sure the whole array is there before allocating for it
+      uint8_t* points = skipElements(stream, point_count, POINT_SIZE);
+      ros::serialization::IStream point_stream(points, point_count * POINT_SIZE);
+
+      markerData.points.resize(point_count);
+      for (auto& point: markerData.points)
       {
-        StampedPoint point;
-        point.point = tf::Point(0.0, 0.0, 0.0);
-        point.transformed_point = transform * (markerData.local_transform * point.point);
+        point.point = readPoint(point_stream);
         point.color = markerData.color;
-        markerData.points.push_back(point);
-        markerData.text = marker.text;
       }
-      else if (markerData.display_type == visualization_msgs::Marker::CUBE)
+      per_point_colors = true;
+    }
+    else
+    {
+      ROS_WARN_ONCE("Unsupported marker type: %d", markerData.display_type);
+      skipElements(stream, point_count, POINT_SIZE);
+    }
+
+    uint32_t color_count;
+    stream.next(color_count);
+    uint8_t* colors = skipElements(stream, color_count, COLOR_SIZE);
+    if (per_point_colors)
+    {
+      // Points without a color of their own keep the marker's
+      const uint32_t used = std::min(color_count, static_cast<uint32_t>(markerData.points.size()));
+      ros::serialization::IStream color_stream(colors, used * COLOR_SIZE);
+      for (uint32_t i = 0; i < used; i++)
       {
-        StampedPoint point;
-        point.color = markerData.color;
+        Color& point_color = markerData.points[i].color;
+        color_stream.next(point_color.r);
+        color_stream.next(point_color.g);
+        color_stream.next(point_color.b);
+        color_stream.next(point_color.a);
+      }
+    }
+
+    if (has_text)
+    {
+      stream.next(markerData.text);
+    }
+    else
+    {
+      skipString(stream);
+    }
+    // mesh_resource and mesh_use_embedded_materials
+    skipString(stream);
+    stream.advance(1);
+  }
+
+  tf::Point MarkerPlugin::readPoint(ros::serialization::IStream& stream)
+  {
+    double x, y, z;
+    stream.next(x);
+    stream.next(y);
+    stream.next(z);
+    return tf::Point(x, y, z);
+  }
+
+  /**
+   * Picks the group a marker is drawn with.
+   * @return false if the marker isn't drawn with OpenGL
+   */
+  bool MarkerPlugin::groupKey(const MarkerData& marker, GroupKey& key)
+  {
+    key = GroupKey();
+    switch (marker.display_type)
+    {
+      case visualization_msgs::Marker::ARROW:
+        key.mode = GL_LINES;
+        // With only one point, scale_y is the arrow width; with both start
+        // and end points explicitly specified, scale_x is the shaft diameter.
+        key.width = (marker.points.size() == 1) ? marker.scale_y : marker.scale_x;
+        return true;
+      case visualization_msgs::Marker::LINE_STRIP:
+      case visualization_msgs::Marker::LINE_LIST:
+        key.mode = GL_LINES;
+        key.width = marker.scale_x;
+        return true;
+      case visualization_msgs::Marker::POINTS:
+        key.mode = GL_POINTS;
+        key.width = marker.scale_x;
+        return true;
+      case visualization_msgs::Marker::TRIANGLE_LIST:
+        key.mode = GL_TRIANGLES;
+        return true;
+      case visualization_msgs::Marker::CYLINDER:
+      case visualization_msgs::Marker::SPHERE:
+      case visualization_msgs::Marker::SPHERE_LIST:
+        key.mesh = mapviz::MESH_DISC;
+        return true;
+      case visualization_msgs::Marker::CUBE:
+      case visualization_msgs::Marker::CUBE_LIST:
+        key.mesh = mapviz::MESH_SQUARE;
+        return true;
+      default:
+        return false;
+    }
+  }
 
-        point.point = tf::Point(marker.scale.x / 2, marker.scale.y / 2, 0.0);
-        point.transformed_point = transform * (markerData.local_transform * point.point);
-        markerData.points.push_back(point);
+  void MarkerPlugin::groupMarker(const MarkerId& id, const MarkerData& marker)
+  {
+    GroupKey key;
+    if (groupKey(marker, key))
+    {
+      Group& group = groups_[key];
+      group.markers.insert(id);
+      group.dirty = true;
+    }
+  }
 
-        point.point = tf::Point(-marker.scale.x / 2, marker.scale.y / 2, 0.0);
-        point.transformed_point = transform * (markerData.local_transform * point.point);
-        markerData.points.push_back(point);
+  void MarkerPlugin::ungroupMarker(const MarkerId& id, const MarkerData& marker)
+  {
+    GroupKey key;
+    if (groupKey(marker, key))
+    {
+      Group& group = groups_[key];
+      group.markers.erase(id);
+      group.dirty = true;
+    }
+  }
 
-        point.point = tf::Point(-marker.scale.x / 2, -marker.scale.y / 2, 0.0);
-        point.transformed_point = transform * (markerData.local_transform * point.point);
-        markerData.points.push_back(point);
+  void MarkerPlugin::markDirty(const MarkerData& marker)
+  {
+    GroupKey key;
+    if (groupKey(marker, key))
+    {
+      groups_[key].dirty = true;
+    }
+  }
 
-        point.point = tf::Point(marker.scale.x / 2, -marker.scale.y / 2, 0.0);
-        point.transformed_point = transform * (markerData.local_transform * point.point);
-        markerData.points.push_back(point);
-      }
-      else if (markerData.display_type == visualization_msgs::Marker::LINE_STRIP ||
-        markerData.display_type == visualization_msgs::Marker::LINE_LIST ||
-        markerData.display_type == visualization_msgs::Marker::CUBE_LIST ||
-        markerData.display_type == visualization_msgs::Marker::SPHERE_LIST ||
-        markerData.display_type == visualization_msgs::Marker::POINTS ||
-        markerData.display_type == visualization_msgs::Marker::TRIANGLE_LIST)
-      {
-        tf::Transform tfTransform(transform.GetTF());
-        tfTransform *= markerData.local_transform;
+  /**
+   * Adds a marker to its group, its source frame and the expiry queue.
+   */
+  void MarkerPlugin::indexMarker(const MarkerId& id, const MarkerData& marker)
+  {
+    groupMarker(id, marker);
 
-        markerData.points.reserve(marker.points.size());
-        StampedPoint point;
-        for (unsigned int i = 0; i < marker.points.size(); i++)
-        {
-          point.point = tf::Point(marker.points[i].x, marker.points[i].y, marker.points[i].z);
-          point.transformed_point = tfTransform * point.point;
+    FrameState& frame = frames_[marker.source_frame];
+    frame.markers.insert(id);
+    frame.pending.insert(id);
 
-          if (i < marker.colors.size())
-          {
-            point.color = {marker.colors[i].r, marker.colors[i].g, marker.colors[i].b, marker.colors[i].a};
-          }
-          else
-          {
-            point.color = markerData.color;
-          }
+    if (marker.display_type == visualization_msgs::Marker::TEXT_VIEW_FACING)
+    {
+      text_markers_.insert(id);
+    }
 
-          markerData.points.push_back(point);
-        }
-      }
-      else
+    if (marker.expire_time != ros::TIME_MAX)
+    {
+      expiry_queue_.push(Expiry(marker.expire_time, id));
+    }
+  }
+
+  /**
+   * Removes a marker from everything but markers_ and the expiry queue; a
+   * queued expiry is ignored unless it matches the marker's expire_time.
+   */
+  void MarkerPlugin::unindexMarker(const MarkerId& id, const MarkerData& marker)
+  {
+    ungroupMarker(id, marker);
+
+    auto frame = frames_.find(marker.source_frame);
+    if (frame != frames_.end())
+    {
+      frame->second.markers.erase(id);
+      frame->second.pending.erase(id);
+      if (frame->second.markers.empty())
       {
-        ROS_WARN_ONCE("Unsupported marker type: %d", markerData.display_type);
+        frames_.erase(frame);
       }
     }
-    else if (marker.action == visualization_msgs::Marker::DELETE)
+
+    text_markers_.erase(id);
+  }
+
+  /**
+   * Deletes markers whose lifetime is up.
+   */
+  void MarkerPlugin::expireMarkers(const ros::Time& now)
+  {
+    while (!expiry_queue_.empty() && !(expiry_queue_.top().first > now))
     {
-      markers_.erase(std::make_pair(marker.ns, marker.id));
+      const Expiry expiry = expiry_queue_.top();
+      expiry_queue_.pop();
+
+      // The marker may have been deleted or re-added with a new lifetime
+      // since this was queued.
+      auto markerIter = markers_.find(expiry.second);
+      if (markerIter != markers_.end() && markerIter->second.expire_time == expiry.first)
+      {
+        unindexMarker(markerIter->first, markerIter->second);
+        markers_.erase(markerIter);
+      }
     }
-    else if (marker.action == 3) // The DELETEALL enum doesn't exist in Indigo
+  }
+
+  void MarkerPlugin::clearMarkers()
+  {
+    markers_.clear();
+    frames_.clear();
+    text_markers_.clear();
+    expiry_queue_ = ExpiryQueue();
+    // Groups keep their buffers, since they can only be released from Draw()
+    for (auto& group: groups_)
     {
-      markers_.clear();
+      group.second.markers.clear();
+      group.second.dirty = true;
     }
   }
 
@@ -368,14 +707,6 @@ namespace mapviz_plugins
     point.transformed_arrow_right = point.transformed_arrow_point + right_tf * arrowOffset;
   }
 
-  void MarkerPlugin::handleMarkerArray(const visualization_msgs::MarkerArray &markers)
-  {
-    for (unsigned int i = 0; i < markers.markers.size(); i++)
-    {
-      handleMarker(markers.markers[i]);
-    }
-  }
-
   void MarkerPlugin::PrintError(const std::string& message)
   {
     PrintErrorHelper(ui_.status, message);
@@ -405,239 +736,332 @@ namespace mapviz_plugins
     return true;
   }
 
-  void MarkerPlugin::Draw(double x, double y, double scale)
+  mapviz::ColorVertex MarkerPlugin::MakeVertex(const tf::Point& point, const Color& color)
   {
-    ros::Time now = ros::Time::now();
+    return mapviz::ColorVertex(
+        point.getX(),
+        point.getY(),
+        colorByte(color.r),
+        colorByte(color.g),
+        colorByte(color.b),
+        colorByte(color.a));
+  }
 
-    for (auto markerIter = markers_.begin(); markerIter != markers_.end(); ++markerIter)
-    {
-      MarkerData& marker = markerIter->second;
+  mapviz::Instance MarkerPlugin::MakeInstance(const tf::Point& origin,
+                                              const tf::Vector3& x_axis,
+                                              const tf::Vector3& y_axis,
+                                              const Color& color)
+  {
+    mapviz::Instance instance;
+    instance.x = origin.getX();
+    instance.y = origin.getY();
+    instance.x_axis_x = x_axis.getX();
+    instance.x_axis_y = x_axis.getY();
+    instance.y_axis_x = y_axis.getX();
+    instance.y_axis_y = y_axis.getY();
+    instance.r = colorByte(color.r);
+    instance.g = colorByte(color.g);
+    instance.b = colorByte(color.b);
+    instance.a = colorByte(color.a);
+    return instance;
+  }
 
-      if (!(marker.expire_time > now)) {
-        PrintInfo("OK");
-        markerIter = markers_.erase(markerIter);
-        continue;
-      }
+  /**
+   * Gathers the geometry of every marker in a group into its buffer.
+   */
+  void MarkerPlugin::buildGroup(const GroupKey& key, Group& group)
+  {
+    if (key.mesh >= 0)
+    {
+      std::vector<mapviz::Instance>& instances = group.instances.Edit();
+      instances.clear();
 
-      if (!marker.transformed) {
-        continue;
-      }
+      for (const auto& id: group.markers)
+      {
+        auto markerIter = markers_.find(id);
+        if (markerIter == markers_.end() || !markerIter->second.transformed)
+        {
+          continue;
+        }
+        const MarkerData& marker = markerIter->second;
 
-      glColor4f(marker.color.r, marker.color.g, marker.color.b, marker.color.a);
+        if (marker.display_type == visualization_msgs::Marker::CUBE) {
+          if (marker.points.size() < 4) {
+            continue;
+          }
 
-      if (marker.display_type == visualization_msgs::Marker::ARROW) {
-        if (marker.points.size() == 1) {
-          // If the marker only has one point, use scale_y as the arrow width.
-          glLineWidth(marker.scale_y);
+          // The corners go around the cube's top face, starting at +x, +y.
+          const tf::Point& p0 = marker.points[0].transformed_point;
+          const tf::Point& p1 = marker.points[1].transformed_point;
+          const tf::Point& p2 = marker.points[2].transformed_point;
+          instances.push_back(MakeInstance((p0 + p2) * 0.5, p0 - p1, p1 - p2, marker.color));
         }
         else {
-          // If the marker has both start and end points explicitly specified, use
-          // scale_x as the shaft diameter.
-          glLineWidth(marker.scale_x);
+          // Spheres, cylinders and every point of a sphere or cube list
+          const tf::Vector3 x_axis(marker.scale_x, 0.0, 0.0);
+          const tf::Vector3 y_axis(0.0, marker.scale_y, 0.0);
+          for (const auto &point : marker.points) {
+            instances.push_back(MakeInstance(point.transformed_point, x_axis, y_axis, point.color));
+          }
         }
-        glBegin(GL_LINES);
+      }
+      return;
+    }
 
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
-
-          glVertex2d(
-            point.transformed_point.getX(),
-            point.transformed_point.getY());
-          glVertex2d(
-            point.transformed_arrow_point.getX(),
-            point.transformed_arrow_point.getY());
-          glVertex2d(
-            point.transformed_arrow_point.getX(),
-            point.transformed_arrow_point.getY());
-          glVertex2d(
-            point.transformed_arrow_left.getX(),
-            point.transformed_arrow_left.getY());
-          glVertex2d(
-            point.transformed_arrow_point.getX(),
-            point.transformed_arrow_point.getY());
-          glVertex2d(
-            point.transformed_arrow_right.getX(),
-            point.transformed_arrow_right.getY());
-        }
+    std::vector<mapviz::ColorVertex>& vertices = group.vertices.Edit();
+    vertices.clear();
 
-        glEnd();
+    for (const auto& id: group.markers)
+    {
+      auto markerIter = markers_.find(id);
+      if (markerIter == markers_.end() || !markerIter->second.transformed)
+      {
+        continue;
       }
-      else if (marker.display_type == visualization_msgs::Marker::LINE_STRIP) {
-        glLineWidth(marker.scale_x);
-        glBegin(GL_LINE_STRIP);
+      const MarkerData& marker = markerIter->second;
 
+      if (marker.display_type == visualization_msgs::Marker::ARROW) {
         for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
-
-          glVertex2d(
-            point.transformed_point.getX(),
-            point.transformed_point.getY());
+          const mapviz::ColorVertex tip = MakeVertex(point.transformed_arrow_point, point.color);
+          vertices.push_back(MakeVertex(point.transformed_point, point.color));
+          vertices.push_back(tip);
+          vertices.push_back(tip);
+          vertices.push_back(MakeVertex(point.transformed_arrow_left, point.color));
+          vertices.push_back(tip);
+          vertices.push_back(MakeVertex(point.transformed_arrow_right, point.color));
+        }
+      }
+      else if (marker.display_type == visualization_msgs::Marker::LINE_STRIP) {
+        // Line strips are split into segments so that every strip with the
+        // same width can share a draw call.
+        for (size_t i = 1; i < marker.points.size(); i++) {
+          vertices.push_back(MakeVertex(marker.points[i - 1].transformed_point, marker.points[i - 1].color));
+          vertices.push_back(MakeVertex(marker.points[i].transformed_point, marker.points[i].color));
         }
-
-        glEnd();
       }
       else if (marker.display_type == visualization_msgs::Marker::LINE_LIST) {
-        glLineWidth(marker.scale_x);
-        glBegin(GL_LINES);
-
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
-
-          glVertex2d(
-            point.transformed_point.getX(),
-            point.transformed_point.getY());
+        // GL_LINES ignores an unpaired trailing vertex, but it would pair up
+        // with the next marker's first vertex in a shared batch.
+        const size_t count = marker.points.size() & ~static_cast<size_t>(1);
+        for (size_t i = 0; i < count; i++) {
+          vertices.push_back(MakeVertex(marker.points[i].transformed_point, marker.points[i].color));
         }
-
-        glEnd();
       }
       else if (marker.display_type == visualization_msgs::Marker::POINTS) {
-        glPointSize(marker.scale_x);
-        glBegin(GL_POINTS);
-
         for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
-
-          glVertex2d(
-            point.transformed_point.getX(),
-            point.transformed_point.getY());
+          vertices.push_back(MakeVertex(point.transformed_point, point.color));
         }
-
-        glEnd();
       }
       else if (marker.display_type == visualization_msgs::Marker::TRIANGLE_LIST) {
-        glBegin(GL_TRIANGLES);
-
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
-
-          glVertex2d(
-            point.transformed_point.getX(),
-            point.transformed_point.getY());
+        const size_t count = marker.points.size() - marker.points.size() % 3;
+        for (size_t i = 0; i < count; i++) {
+          vertices.push_back(MakeVertex(marker.points[i].transformed_point, marker.points[i].color));
         }
-
-        glEnd();
       }
-      else if (marker.display_type == visualization_msgs::Marker::CYLINDER ||
-        marker.display_type == visualization_msgs::Marker::SPHERE ||
-        marker.display_type == visualization_msgs::Marker::SPHERE_LIST) {
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
-
-          glBegin(GL_TRIANGLE_FAN);
-
+    }
+  }
 
-          double marker_x = point.transformed_point.getX();
-          double marker_y = point.transformed_point.getY();
+  void MarkerPlugin::Draw(double x, double y, double scale)
+  {
+    ros::Time now = ros::Time::now();
 
-          glVertex2d(marker_x, marker_y);
+    expireMarkers(now);
 
-          for (int32_t i = 0; i <= 360; i += 10) {
-            double radians = static_cast<double>(i) * static_cast<double>(swri_math_util::_deg_2_rad);
-            // Spheres may be specified w/ only one scale value
-            if (marker.scale_y == 0.0) {
-              marker.scale_y = marker.scale_x;
-            }
-            glVertex2d(
-              marker_x + std::sin(radians) * marker.scale_x,
-              marker_y + std::cos(radians) * marker.scale_y);
-          }
+    for (auto& entry: groups_)
+    {
+      const GroupKey& key = entry.first;
+      Group& group = entry.second;
+      if (group.dirty)
+      {
+        buildGroup(key, group);
+        group.dirty = false;
+      }
 
-          glEnd();
-        }
+      if (key.mesh >= 0)
+      {
+        renderer_->DrawInstances(static_cast<mapviz::InstanceMesh>(key.mesh), group.instances);
+        continue;
       }
-      else if (marker.display_type == visualization_msgs::Marker::CUBE ||
-        marker.display_type == visualization_msgs::Marker::CUBE_LIST) {
-        glBegin(GL_TRIANGLE_FAN);
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
 
-          glVertex2d(point.transformed_point.getX(), point.transformed_point.getY());
-        }
-        glEnd();
+      if (key.mode == GL_POINTS)
+      {
+        glPointSize(key.width);
       }
+      else if (key.mode == GL_LINES)
+      {
+        glLineWidth(key.width);
+      }
+      renderer_->Draw(key.mode, group.vertices);
+    }
 
+    if (!text_markers_.empty())
+    {
+      drawText();
+    }
+
+    if (!markers_.empty())
+    {
       PrintInfo("OK");
     }
   }
 
-  void MarkerPlugin::Paint(QPainter* painter, double x, double y, double scale)
+  /**
+   * Draws the TEXT_VIEW_FACING labels, which stay upright and a constant
+   * size.  A label that would overlap one drawn before it is dropped.
+   */
+  void MarkerPlugin::drawText()
   {
-    // Most of the marker drawing is done using OpenGL commands, but text labels
-    // are rendered using a QPainter.  This is intended primarily as an example
-    // of how the QPainter works.
-    ros::Time now = ros::Time::now();
-
-    // We don't want the text to be rotated or scaled, but we do want it to be
-    // translated appropriately.  So, we save off the current world transform
-    // and reset it; when we actually draw the text, we'll manually translate
-    // it to the right place.
-    QTransform tf = painter->worldTransform();
-    QFont font("Helvetica", 10);
-    painter->setFont(font);
-    painter->save();
-    painter->resetTransform();
-
-    for (auto markerIter = markers_.begin(); markerIter != markers_.end(); ++markerIter)
+    // Everything is laid out before any label is added, since a layout that
+    // fills the atlas discards the labels added so far.
+    for (const auto& id: text_markers_)
     {
-      MarkerData& marker = markerIter->second;
+      MarkerData& marker = markers_[id];
+      if (!text_.IsCurrent(marker.layout))
+      {
+        marker.layout = text_.GetLayout(QString::fromStdString(marker.text), font_);
+      }
+    }
 
-      if (marker.display_type != visualization_msgs::Marker::TEXT_VIEW_FACING ||
-          marker.expire_time <= now ||
-          !marker.transformed)
+    text_.Begin();
+    for (const auto& id: text_markers_)
+    {
+      const MarkerData& marker = markers_[id];
+      if (!marker.transformed || marker.points.empty())
       {
         continue;
       }
 
-      QPen pen(QBrush(QColor::fromRgbF(marker.color.r, marker.color.g,
-                             marker.color.b, marker.color.a)), 1);
-      painter->setPen(pen);
-
-      StampedPoint& rosPoint = marker.points.front();
-      QPointF point = tf.map(QPointF(rosPoint.transformed_point.x(),
-                                     rosPoint.transformed_point.y()));
+      const tf::Point& point = marker.points.front().transformed_point;
+      float window_x;
+      float window_y;
+      if (text_.Project(point.x(), point.y(), window_x, window_y))
+      {
+        text_.Add(marker.layout, window_x, window_y,
+                  QColor::fromRgbF(marker.color.r, marker.color.g, marker.color.b, marker.color.a),
+                  true);
+      }
+    }
+    text_.Draw(*renderer_);
+  }
 
-      auto text = QString::fromStdString(marker.text);
-      // Get bounding rectangle
-      QRectF rect(point, QSizeF(10,10));
-      rect = painter->boundingRect(rect, Qt::AlignLeft | Qt::AlignHCenter, text);
-      painter->drawText(rect, text);
+  /**
+   * Transforms a marker's points into the target frame, unless they were
+   * already transformed with the same transform.
+   */
+  void MarkerPlugin::transformMarker(MarkerData& marker,
+                                     const swri_transform_util::Transform& transform)
+  {
+    const tf::Transform applied_transform = transform.GetTF();
+    if (marker.transformed && applied_transform == marker.applied_transform)
+    {
+      return;
+    }
+    marker.transformed = true;
+    marker.applied_transform = applied_transform;
+    markDirty(marker);
 
-      PrintInfo("OK");
+    if (marker.display_type == visualization_msgs::Marker::ARROW)
+    {
+      // Points for the ARROW marker type are stored a bit differently
+      // than other types, so they have their own special transform case.
+      transformArrow(marker, transform);
+    }
+    else
+    {
+      tf::Transform tfTransform(applied_transform);
+      tfTransform *= marker.local_transform;
+      for (auto &point : marker.points)
+      {
+        point.transformed_point = tfTransform * point.point;
+      }
     }
+  }
 
-    painter->restore();
+  void MarkerPlugin::untransformMarker(MarkerData& marker)
+  {
+    if (marker.transformed)
+    {
+      marker.transformed = false;
+      markDirty(marker);
+    }
   }
 
   void MarkerPlugin::Transform()
   {
-    for (auto markerIter = markers_.begin(); markerIter != markers_.end(); ++markerIter)
+    for (auto& entry: frames_)
     {
-      MarkerData& marker = markerIter->second;
+      const std::string& frame_id = entry.first;
+      FrameState& frame = entry.second;
 
-      swri_transform_util::Transform transform;
-      if (GetTransform(marker.source_frame, marker.stamp, transform))
+      if (use_latest_transforms_)
       {
-        marker.transformed = true;
-
-        if (marker.display_type == visualization_msgs::Marker::ARROW)
-        {
-          // Points for the ARROW marker type are stored a bit differently
-          // than other types, so they have their own special transform case.
-          transformArrow(marker, transform);
-        }
-        else
+        // Every marker in the frame shares the latest transform, so it's
+        // looked up once; while it stays the same, only markers that have
+        // arrived since the last pass need any work.
+        swri_transform_util::Transform transform;
+        if (!GetTransform(frame_id, ros::Time(), transform))
         {
-          tf::Transform tfTransform(transform.GetTF());
-          tfTransform *= marker.local_transform;
-          for (auto &point : marker.points)
+          if (frame.transformed || !frame.latest)
           {
-            point.transformed_point = tfTransform * point.point;
+            for (const auto& id: frame.markers)
+            {
+              untransformMarker(markers_[id]);
+            }
           }
+          if (!frame.pending.empty())
+          {
+            PrintError("No transform between " + frame_id + " and " + target_frame_);
+          }
+          frame.transformed = false;
+          frame.latest = true;
+          continue;
         }
+
+        const tf::Transform frame_transform = transform.GetTF();
+        const bool moved = !frame.transformed || !frame.latest ||
+            !(frame_transform == frame.transform);
+        for (const auto& id: moved ? frame.markers : frame.pending)
+        {
+          transformMarker(markers_[id], transform);
+        }
+        frame.pending.clear();
+        frame.transform = frame_transform;
+        frame.transformed = true;
+        frame.latest = true;
       }
       else
       {
-        marker.transformed = false;
+        // Markers are transformed at their own stamps; each distinct stamp
+        // is looked up once, and markers whose transform is the same as
+        // last time are skipped.
+        std::map<ros::Time, std::pair<bool, swri_transform_util::Transform> > transforms;
+        for (const auto& id: frame.markers)
+        {
+          MarkerData& marker = markers_[id];
+          auto cached = transforms.find(marker.stamp);
+          if (cached == transforms.end())
+          {
+            swri_transform_util::Transform transform;
+            const bool found = GetTransform(frame_id, marker.stamp, transform);
+            cached = transforms.insert(std::make_pair(marker.stamp, std::make_pair(found, transform))).first;
+            if (!found && frame.pending.count(id))
+            {
+              PrintError("No transform between " + frame_id + " and " + target_frame_);
+            }
+          }
+
+          if (cached->second.first)
+          {
+            transformMarker(marker, cached->second.second);
+          }
+          else
+          {
+            untransformMarker(marker);
+          }
+        }
+        frame.pending.clear();
+        frame.transformed = false;
+        frame.latest = false;
       }
     }
   }
@@ -33,14 +33,22 @@
 #include <GL/glut.h>
 
 // C++ standard libraries
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <utility>
 #include <vector>
 
 // QT libraries
 #include <QGLWidget>
 #include <QPalette>
+#include <QRunnable>
 
 #include <mapviz/select_topic_dialog.h>
+#include <swri_yaml_util/yaml_util.h>
 
 // Declare plugin
 #include <pluginlib/class_list_macros.h>
@@ -145,12 +153,300 @@ namespace mapviz_plugins
     return palette;
   }
 
+  namespace
+  {
+    // Tile builds beyond this wait for a later frame, so that panning across
+    // a big map doesn't queue up work for tiles that are long out of view
+    const size_t MAX_PENDING_BUILDS = 8;
+
+    /**
+     * How many of the cells from x on, taking every step-th one, lie in the
+     * same block as x; their memory is step apart.
+     */
+    int32_t cellsInBlock(int32_t x, int32_t remaining, int32_t step)
+    {
+      const int32_t block_size = OccupancyGridCells::BLOCK_SIZE;
+      const int32_t block_end = (x / block_size + 1) * block_size;
+      return std::min(remaining, (block_end - x + step - 1) / step);
+    }
+
+    /**
+     * Colors a rectangle of cells, taking every step-th cell in each
+     * direction, into tightly packed RGBA.
+     */
+    void colorCells(const OccupancyGridCells& cells,
+                    int32_t x, int32_t y, int32_t width, int32_t height, int32_t step,
+                    const Palette& palette, uchar* rgba)
+    {
+      for (int32_t row = 0; row < height; row++)
+      {
+        const int32_t cell_y = y + row * step;
+        int32_t col = 0;
+        while (col < width)
+        {
+          const int32_t cell_x = x + col * step;
+          const int32_t count = cellsInBlock(cell_x, width - col, step);
+          const int8_t* src = cells.Cell(cell_x, cell_y);
+          for (int32_t i = 0; i < count; i++, rgba += CHANNELS)
+          {
+            const uchar color = static_cast<uchar>(src[i * step]);
+            memcpy(rgba, &palette[color * CHANNELS], CHANNELS);
+          }
+          col += count;
+        }
+      }
+    }
+
+    /**
+     * Copies every step-th cell of a rectangle in each direction, for tiles
+     * that are colored by a shader.
+     */
+    void sampleCells(const OccupancyGridCells& cells,
+                     int32_t x, int32_t y, int32_t width, int32_t height, int32_t step,
+                     uchar* indices)
+    {
+      for (int32_t row = 0; row < height; row++)
+      {
+        const int32_t cell_y = y + row * step;
+        int32_t col = 0;
+        while (col < width)
+        {
+          const int32_t cell_x = x + col * step;
+          const int32_t count = cellsInBlock(cell_x, width - col, step);
+          const int8_t* src = cells.Cell(cell_x, cell_y);
+          if (step == 1)
+          {
+            memcpy(indices, src, count);
+            indices += count;
+          }
+          else
+          {
+            for (int32_t i = 0; i < count; i++)
+            {
+              *indices++ = static_cast<uchar>(src[i * step]);
+            }
+          }
+          col += count;
+        }
+      }
+    }
+
+    /**
+     * Reads a palette from the config, e.g.
+     *
+     *   name: traversability
+     *   colors:
+     *     - {value: -1, color: "#708986", alpha: 160}
+     *     - {value: 0, color: "#ffffff"}
+     *     - {min: 1, max: 99, color: "#0000ff", max_color: "#ff0000"}
+     *     - {value: 100, color: "#000000"}
+     *
+     * Values are cell values, from -128 to 127; a range is interpolated from
+     * color to max_color.  Values that aren't listed are transparent.
+     */
+    bool readPalette(const YAML::Node& node, std::string& name, Palette& palette)
+    {
+      if (!node["name"] || !node["colors"])
+      {
+        return false;
+      }
+      node["name"] >> name;
+
+      palette.fill(0);
+      const YAML::Node& colors = node["colors"];
+      for (size_t i = 0; i < colors.size(); i++)
+      {
+        const YAML::Node& entry = colors[i];
+        int min_value;
+        int max_value;
+        if (entry["value"])
+        {
+          entry["value"] >> min_value;
+          max_value = min_value;
+        }
+        else if (entry["min"] && entry["max"])
+        {
+          entry["min"] >> min_value;
+          entry["max"] >> max_value;
+        }
+        else
+        {
+          return false;
+        }
+
+        if (!entry["color"])
+        {
+          return false;
+        }
+        std::string color_name;
+        entry["color"] >> color_name;
+        const QColor min_color(QString::fromStdString(color_name));
+        QColor max_color = min_color;
+        if (entry["max_color"])
+        {
+          entry["max_color"] >> color_name;
+          max_color = QColor(QString::fromStdString(color_name));
+        }
+        int alpha = 255;
+        if (entry["alpha"])
+        {
+          entry["alpha"] >> alpha;
+        }
+
+        min_value = std::max(min_value, -128);
+        max_value = std::min(max_value, 127);
+        for (int value = min_value; value <= max_value; value++)
+        {
+          const double t = max_value > min_value ?
+              static_cast<double>(value - min_value) / (max_value - min_value) : 0.0;
+          uchar* rgba = &palette[static_cast<uchar>(static_cast<int8_t>(value)) * CHANNELS];
+          rgba[0] = static_cast<uchar>(min_color.red() + t * (max_color.red() - min_color.red()));
+          rgba[1] = static_cast<uchar>(min_color.green() + t * (max_color.green() - min_color.green()));
+          rgba[2] = static_cast<uchar>(min_color.blue() + t * (max_color.blue() - min_color.blue()));
+          rgba[3] = static_cast<uchar>(std::max(0, std::min(alpha, 255)));
+        }
+      }
+      return true;
+    }
+
+    /**
+     * The cells a tile covers, clipped to the map.
+     */
+    void tileCells(int level, int32_t column, int32_t row, int32_t grid_width, int32_t grid_height,
+                   int32_t tile_size, int32_t& x, int32_t& y, int32_t& width, int32_t& height)
+    {
+      const int32_t span = tile_size << level;
+      x = column * span;
+      y = row * span;
+      width = std::min(span, grid_width - x);
+      height = std::min(span, grid_height - y);
+    }
+
+    void generateMipmaps()
+    {
+      // Without glGenerateMipmap, GL_GENERATE_MIPMAP was set on the texture
+      // and the driver keeps the levels up to date itself.
+      if (GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object)
+      {
+        glGenerateMipmap(GL_TEXTURE_2D);
+      }
+    }
+  }
+
+  OccupancyGridCells::OccupancyGridCells(const int8_t* cells, int32_t width, int32_t height) :
+    width(width),
+    height(height),
+    columns((width + BLOCK_SIZE - 1) / BLOCK_SIZE)
+  {
+    const int32_t rows = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    blocks.resize(static_cast<size_t>(columns) * rows);
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+      blocks[i].reset(new std::vector<int8_t>(BLOCK_SIZE * BLOCK_SIZE, -1));
+    }
+    Write(0, 0, width, height, cells, width);
+  }
+
+  void OccupancyGridCells::Write(int32_t x, int32_t y, int32_t width, int32_t height,
+                                 const int8_t* cells, size_t stride)
+  {
+    if (width <= 0 || height <= 0)
+    {
+      return;
+    }
+    for (int32_t block_y = y / BLOCK_SIZE; block_y <= (y + height - 1) / BLOCK_SIZE; block_y++)
+    {
+      for (int32_t block_x = x / BLOCK_SIZE; block_x <= (x + width - 1) / BLOCK_SIZE; block_x++)
+      {
+        boost::shared_ptr<std::vector<int8_t> >& block =
+            blocks[static_cast<size_t>(block_y) * columns + block_x];
+        if (!block.unique())
+        {
+          // Another copy of the grid is still reading it
+          block.reset(new std::vector<int8_t>(*block));
+        }
+
+        // The part of the rectangle in this block
+        const int32_t x0 = std::max(x, block_x * BLOCK_SIZE);
+        const int32_t y0 = std::max(y, block_y * BLOCK_SIZE);
+        const int32_t x1 = std::min(x + width, (block_x + 1) * BLOCK_SIZE);
+        const int32_t y1 = std::min(y + height, (block_y + 1) * BLOCK_SIZE);
+        for (int32_t row = y0; row < y1; row++)
+        {
+          memcpy(&(*block)[static_cast<size_t>(row - block_y * BLOCK_SIZE) * BLOCK_SIZE +
+                           (x0 - block_x * BLOCK_SIZE)],
+                 &cells[static_cast<size_t>(row - y) * stride + (x0 - x)],
+                 x1 - x0);
+        }
+      }
+    }
+  }
+
+  /**
+   * Colors a tile on a worker thread and posts the result back to the GUI
+   * thread, which uploads it.
+   */
+  class OccupancyGridPlugin::TileBuilder : public QRunnable
+  {
+  public:
+    TileBuilder(OccupancyGridPlugin* plugin,
+                const TileKey& key,
+                uint64_t generation) :
+      plugin_(plugin),
+      cells_(plugin->cells_),
+      palette_(plugin->currentPalette())
+    {
+      image_.indexed = plugin->indexed_tiles_;
+      image_.key = key;
+      image_.epoch = plugin->epoch_;
+      image_.generation = generation;
+    }
+
+    void run()
+    {
+      const int level = image_.key.get<0>();
+      const int32_t step = 1 << level;
+      int32_t x, y, width, height;
+      tileCells(level, image_.key.get<1>(), image_.key.get<2>(),
+                cells_->width, cells_->height, TILE_SIZE, x, y, width, height);
+      image_.width = (width + step - 1) / step;
+      image_.height = (height + step - 1) / step;
+      if (image_.indexed)
+      {
+        image_.texels.resize(static_cast<size_t>(image_.width) * image_.height);
+        sampleCells(*cells_, x, y, image_.width, image_.height, step,
+                    image_.texels.data());
+      }
+      else
+      {
+        image_.texels.resize(static_cast<size_t>(image_.width) * image_.height * CHANNELS);
+        colorCells(*cells_, x, y, image_.width, image_.height, step,
+                   palette_, image_.texels.data());
+      }
 
+      // Drop the cells before anything else, so that the callback thread
+      // can write to their blocks again without copying them
+      cells_.reset();
+      plugin_->built_tiles_.Post(std::move(image_));
+      QMetaObject::invokeMethod(plugin_, "Dirty", Qt::QueuedConnection);
+    }
+
+  private:
+    OccupancyGridPlugin* plugin_;
+    OccupancyGridCellsPtr cells_;
+    Palette palette_;
+    TileImage image_;
+  };
 
   OccupancyGridPlugin::OccupancyGridPlugin() :
     config_widget_(new QWidget()),
+    has_map_(false),
     transformed_(false),
-    texture_id_(0),
+    max_level_(0),
+    epoch_(0),
+    pending_builds_(0),
+    indexed_tiles_(false),
+    pixel_buffer_(0),
     map_palette_( makeMapPalette() ),
     costmap_palette_( makeCostmapPalette() )
   {
@@ -176,16 +472,39 @@ namespace mapviz_plugins
 
     QObject::connect(ui_.color_scheme, SIGNAL(currentTextChanged(const QString &)), this, SLOT(colorSchemeUpdated(const QString &)));
 
+    palette_.SetTable(currentPalette().data());
+
     PrintWarning("waiting for first message");
   }
 
   OccupancyGridPlugin::~OccupancyGridPlugin()
   {
-    Shutdown();
+    // Builds post back to this plugin, so they have to finish first.  There
+    // might not be a GL context here; textures are released in Shutdown().
+    build_pool_.clear();
+    build_pool_.waitForDone();
   }
 
   void OccupancyGridPlugin::Shutdown()
   {
+    // Builds post back to this plugin, so they have to finish first
+    build_pool_.clear();
+    build_pool_.waitForDone();
+
+    clearTiles();
+    if (!stale_textures_.empty())
+    {
+      glDeleteTextures(static_cast<GLsizei>(stale_textures_.size()), stale_textures_.data());
+      stale_textures_.clear();
+    }
+
+    if (pixel_buffer_ != 0)
+    {
+      glDeleteBuffers(1, &pixel_buffer_);
+      pixel_buffer_ = 0;
+    }
+
+    palette_.Destroy();
   }
 
   void OccupancyGridPlugin::DrawIcon()
@@ -237,11 +556,17 @@ namespace mapviz_plugins
     const std::string topic = ui_.topic_grid->text().trimmed().toStdString();
 
     initialized_ = false;
-    grid_.reset();
-    raw_buffer_.clear();
+    has_map_ = false;
+    cells_.reset();
+    clearTiles();
 
     grid_sub_.shutdown();
     update_sub_.shutdown();
+    {
+      QMutexLocker locker(&ingest_mutex_);
+      ingest_cells_.reset();
+    }
+    incoming_updates_.Clear();
 
     if (!topic.empty())
     {
@@ -267,24 +592,13 @@ namespace mapviz_plugins
 
   void OccupancyGridPlugin::colorSchemeUpdated(const QString &)
   {
-
-    if( grid_ && raw_buffer_.size()>0)
+    palette_.SetTable(currentPalette().data());
+    if (!indexed_tiles_)
     {
-      const size_t width  = grid_->info.width;
-      const size_t height = grid_->info.height;
-      const Palette& palette = (ui_.color_scheme->currentText() == "map") ?  map_palette_ : costmap_palette_;
-
-      for (size_t row = 0; row < height;  row++)
-      {
-        for (size_t col = 0; col < width; col++)
-        {
-          size_t index = (col + row * texture_size_);
-          uchar color = raw_buffer_[index];
-          memcpy( &color_buffer_[index*CHANNELS], &palette[color*CHANNELS], CHANNELS);
-        }
-      }
-      updateTexture();
+      // Tiles keep showing the old colors until they've been rebuilt
+      invalidateTiles();
     }
+    Q_EMIT Dirty();
   }
 
   void OccupancyGridPlugin::PrintError(const std::string& message)
@@ -316,117 +630,604 @@ namespace mapviz_plugins
     return true;
   }
 
-  void OccupancyGridPlugin::updateTexture()
+  const OccupancyGridPlugin::Palette& OccupancyGridPlugin::currentPalette() const
   {
-    if (texture_id_ != -1)
+    const std::string scheme = ui_.color_scheme->currentText().toStdString();
+    std::map<std::string, Palette>::const_iterator it = custom_palettes_.find(scheme);
+    if (it != custom_palettes_.end())
     {
-      glDeleteTextures(1, &texture_id_);
+      return it->second;
     }
+    return (scheme == "map") ?  map_palette_ : costmap_palette_;
+  }
+
+  /**
+   * Adds the palettes in a list of them to the color schemes.
+   */
+  void OccupancyGridPlugin::loadPalettes(const YAML::Node& palettes)
+  {
+    for (size_t i = 0; i < palettes.size(); i++)
+    {
+      std::string name;
+      Palette palette;
+      if (!readPalette(palettes[i], name, palette))
+      {
+        PrintError("Invalid palette in config");
+        continue;
+      }
 
-    // Get a new texture id.
-    glGenTextures(1, &texture_id_);
+      custom_palettes_[name] = palette;
+      if (ui_.color_scheme->findText(QString::fromStdString(name)) < 0)
+      {
+        ui_.color_scheme->addItem(QString::fromStdString(name));
+      }
+    }
+  }
 
-    // Bind the texture with the correct size and null memory.
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  /**
+   * Drops every tile.  Their textures are deleted the next time the map is
+   * drawn, since there might not be a current GL context.
+   */
+  void OccupancyGridPlugin::clearTiles()
+  {
+    for (std::map<TileKey, Tile>::iterator it = tiles_.begin(); it != tiles_.end(); ++it)
+    {
+      if (it->second.texture != 0)
+      {
+        stale_textures_.push_back(it->second.texture);
+      }
+    }
+    tiles_.clear();
+    epoch_++;
+  }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  /**
+   * Marks every tile as needing to be rebuilt.
+   */
+  void OccupancyGridPlugin::invalidateTiles()
+  {
+    for (std::map<TileKey, Tile>::iterator it = tiles_.begin(); it != tiles_.end(); ++it)
+    {
+      it->second.generation++;
+      it->second.dirty_x1 = it->second.dirty_x0;
+    }
+  }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  /**
+   * Uploads the tiles that have been built since the last frame.  Requires
+   * a current GL context.
+   */
+  void OccupancyGridPlugin::receiveTiles()
+  {
+    std::deque<TileImage> images;
+    built_tiles_.Take(images);
+    for (size_t i = 0; i < images.size(); i++)
+    {
+      TileImage& image = images[i];
+      pending_builds_--;
 
-    glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+      std::map<TileKey, Tile>::iterator it = tiles_.find(image.key);
+      if (image.epoch != epoch_ || it == tiles_.end())
+      {
+        continue;
+      }
+      Tile& tile = it->second;
+      tile.building = false;
+      if (image.generation != tile.generation)
+      {
+        // The cells changed while it was being built; it'll be built again
+        continue;
+      }
 
-    glTexImage2D(
-          GL_TEXTURE_2D,
-          0,
-          GL_RGBA,
-          texture_size_,
-          texture_size_,
-          0,
-          GL_RGBA,
-          GL_UNSIGNED_BYTE,
-          color_buffer_.data());
+      if (image.indexed != indexed_tiles_)
+      {
+        continue;
+      }
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+      if (tile.texture == 0)
+      {
+        // Indices can't be blended, so indexed tiles aren't mipmapped; the
+        // level of detail already keeps them close to a texel per pixel.
+        glGenTextures(1, &tile.texture);
+        glBindTexture(GL_TEXTURE_2D, tile.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                        image.indexed ? GL_NEAREST : GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if (!image.indexed && !(GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object))
+        {
+          glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+        }
+      }
+      else
+      {
+        glBindTexture(GL_TEXTURE_2D, tile.texture);
+      }
+
+      // Tiles along the right and top edges of the map are cut short rather
+      // than padded, so they're not a power of two
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glTexImage2D(
+            GL_TEXTURE_2D,
+            0,
+            image.indexed ? GL_LUMINANCE8 : GL_RGBA,
+            image.width,
+            image.height,
+            0,
+            image.indexed ? GL_LUMINANCE : GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            image.texels.data());
+      if (!image.indexed)
+      {
+        generateMipmaps();
+      }
+      glBindTexture(GL_TEXTURE_2D, 0);
+
+      tile.built_generation = image.generation;
+      tile.dirty_x1 = tile.dirty_x0;
+    }
   }
 
+  /**
+   * Works out which cells are in view and the level of detail they should be
+   * drawn at, from the current matrices, which have to take cells to the
+   * target frame.
+   * @return false if the map isn't in view
+   */
+  bool OccupancyGridPlugin::visibleCells(int& level, int32_t& x0, int32_t& y0, int32_t& x1, int32_t& y1) const
+  {
+    GLdouble modelview[16];
+    GLdouble projection[16];
+    GLint viewport[4];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // The rows of projection * modelview that take a cell on the map's plane
+    // to normalized x and y; the projection is orthographic.
+    double m[2][4];
+    for (int row = 0; row < 2; row++)
+    {
+      for (int col = 0; col < 4; col++)
+      {
+        m[row][col] = 0;
+        for (int k = 0; k < 4; k++)
+        {
+          m[row][col] += projection[k * 4 + row] * modelview[col * 4 + k];
+        }
+      }
+    }
 
-  void OccupancyGridPlugin::Callback(const nav_msgs::OccupancyGridConstPtr& msg)
+    const double det = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+    if (std::fabs(det) < 1e-12 || viewport[2] <= 0 || viewport[3] <= 0)
+    {
+      return false;
+    }
+
+    // Invert it for each corner of the view
+    double min_x = std::numeric_limits<double>::max();
+    double min_y = std::numeric_limits<double>::max();
+    double max_x = -std::numeric_limits<double>::max();
+    double max_y = -std::numeric_limits<double>::max();
+    const double corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+    for (int i = 0; i < 4; i++)
+    {
+      const double nx = corners[i][0] - m[0][3];
+      const double ny = corners[i][1] - m[1][3];
+      const double cx = (m[1][1] * nx - m[0][1] * ny) / det;
+      const double cy = (m[0][0] * ny - m[1][0] * nx) / det;
+      min_x = std::min(min_x, cx);
+      min_y = std::min(min_y, cy);
+      max_x = std::max(max_x, cx);
+      max_y = std::max(max_y, cy);
+    }
+
+    x0 = static_cast<int32_t>(std::max(0.0, std::floor(min_x)));
+    y0 = static_cast<int32_t>(std::max(0.0, std::floor(min_y)));
+    x1 = static_cast<int32_t>(std::min<double>(info_.width, std::ceil(max_x)));
+    y1 = static_cast<int32_t>(std::min<double>(info_.height, std::ceil(max_y)));
+    if (x1 <= x0 || y1 <= y0)
+    {
+      return false;
+    }
+
+    // Pick the level that has about one texel per pixel, and let mipmapping
+    // take care of the rest
+    const double pixels_per_cell = std::sqrt(std::fabs(det) * viewport[2] * viewport[3] / 4.0);
+    level = 0;
+    while (level < max_level_ && pixels_per_cell * (2 << level) <= 1.0)
+    {
+      level++;
+    }
+
+    return true;
+  }
+
+  /**
+   * Makes the tiles in view at the given level resident, starting builds for
+   * the ones that are missing or out of date, and drops the rest.  Coarser
+   * tiles are kept under the ones that haven't been built yet so there's
+   * something to see in the meantime.  Requires a current GL context.
+   */
+  void OccupancyGridPlugin::updateTiles(int level, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
   {
-    grid_ = msg;
-    const int width  = grid_->info.width;
-    const int height = grid_->info.height;
-    initialized_ = true;
-    source_frame_ = grid_->header.frame_id;
-    transformed_ = GetTransform( source_frame_, grid_->header.stamp, transform_);
-    if ( !transformed_ )
+    for (std::map<TileKey, Tile>::iterator it = tiles_.begin(); it != tiles_.end(); ++it)
     {
-      PrintError("No transform between " + source_frame_ + " and " + target_frame_);
+      it->second.wanted = false;
+    }
+
+    const int32_t span = TILE_SIZE << level;
+    std::set<TileKey> placeholders;
+    for (int32_t row = y0 / span; row <= (y1 - 1) / span; row++)
+    {
+      for (int32_t col = x0 / span; col <= (x1 - 1) / span; col++)
+      {
+        const TileKey key(level, col, row);
+        Tile& tile = tiles_[key];
+        tile.wanted = true;
+
+        if (tile.built_generation != tile.generation && !tile.building &&
+            pending_builds_ < MAX_PENDING_BUILDS)
+        {
+          tile.building = true;
+          pending_builds_++;
+          build_pool_.start(new TileBuilder(this, key, tile.generation));
+        }
+        else if (tile.dirty_x1 > tile.dirty_x0 && tile.texture != 0)
+        {
+          updateDirtyCells(key, tile);
+        }
+
+        if (tile.built_generation == 0)
+        {
+          for (int coarser = level + 1; coarser <= max_level_; coarser++)
+          {
+            const int shift = coarser - level;
+            placeholders.insert(TileKey(coarser, col >> shift, row >> shift));
+          }
+        }
+      }
+    }
+
+    std::map<TileKey, Tile>::iterator it = tiles_.begin();
+    while (it != tiles_.end())
+    {
+      if (it->second.wanted || placeholders.count(it->first) > 0)
+      {
+        ++it;
+        continue;
+      }
+
+      // A build that's still running is thrown away when it's done
+      if (it->second.texture != 0)
+      {
+        glDeleteTextures(1, &it->second.texture);
+      }
+      tiles_.erase(it++);
     }
+  }
 
-    int32_t max_dimension = std::max(height, width);
+  /**
+   * Recolors and uploads only the cells of a level 0 tile that have changed
+   * since it was built.  Requires a current GL context.
+   */
+  void OccupancyGridPlugin::updateDirtyCells(const TileKey& key, Tile& tile)
+  {
+    int32_t tile_x, tile_y, tile_width, tile_height;
+    tileCells(0, key.get<1>(), key.get<2>(), info_.width, info_.height, TILE_SIZE,
+              tile_x, tile_y, tile_width, tile_height);
+
+    const int32_t x = tile.dirty_x0;
+    const int32_t y = tile.dirty_y0;
+    const int32_t width = tile.dirty_x1 - tile.dirty_x0;
+    const int32_t height = tile.dirty_y1 - tile.dirty_y0;
+    tile.dirty_x1 = tile.dirty_x0;
+
+    const Palette& palette = currentPalette();
+    const size_t channels = indexed_tiles_ ? 1 : CHANNELS;
+    const GLenum format = indexed_tiles_ ? GL_LUMINANCE : GL_RGBA;
+    const size_t bytes = static_cast<size_t>(width) * height * channels;
+
+    glBindTexture(GL_TEXTURE_2D, tile.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    texture_size_ = 2;
-    while (texture_size_ < max_dimension){
-      texture_size_ = texture_size_ << 1;
+    bool uploaded = false;
+    if (GLEW_ARB_pixel_buffer_object)
+    {
+      // Color the cells straight into a pixel buffer so that the driver can
+      // copy them into the texture without stalling on it.
+      if (pixel_buffer_ == 0)
+      {
+        glGenBuffers(1, &pixel_buffer_);
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer_);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+      uchar* dest = static_cast<uchar*>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
+      if (dest)
+      {
+        if (indexed_tiles_)
+        {
+          sampleCells(*cells_, tile_x + x, tile_y + y, width, height, 1, dest);
+        }
+        else
+        {
+          colorCells(*cells_, tile_x + x, tile_y + y, width, height, 1, palette, dest);
+        }
+        uploaded = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        if (uploaded)
+        {
+          glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height,
+                          format, GL_UNSIGNED_BYTE, 0);
+        }
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
     }
 
-    const Palette& palette = (ui_.color_scheme->currentText() == "map") ?  map_palette_ : costmap_palette_;
+    if (!uploaded)
+    {
+      texel_scratch_.resize(bytes);
+      if (indexed_tiles_)
+      {
+        sampleCells(*cells_, tile_x + x, tile_y + y, width, height, 1,
+                    texel_scratch_.data());
+      }
+      else
+      {
+        colorCells(*cells_, tile_x + x, tile_y + y, width, height, 1,
+                   palette, texel_scratch_.data());
+      }
+      glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height,
+                      format, GL_UNSIGNED_BYTE, texel_scratch_.data());
+    }
 
-    raw_buffer_.resize(texture_size_*texture_size_, 0);
-    color_buffer_.resize(texture_size_*texture_size_*CHANNELS, 0);
+    if (!indexed_tiles_)
+    {
+      generateMipmaps();
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
 
-    for (size_t row = 0; row < height; row++)
+  /**
+   * Draws the resident tiles, coarsest first so that finer ones cover the
+   * placeholders under them.
+   */
+  void OccupancyGridPlugin::drawTiles(int level)
+  {
+    const QColor color(255, 255, 255, static_cast<int>(ui_.alpha->value() * 255.0));
+    std::vector<mapviz::TexturedVertex> quad(4);
+    std::map<TileKey, Tile>::reverse_iterator it = tiles_.rbegin();
+    for (; it != tiles_.rend(); ++it)
     {
-      for (size_t col = 0; col < width; col++)
+      const Tile& tile = it->second;
+      if (tile.texture == 0 || tile.built_generation == 0 || it->first.get<0>() < level)
+      {
+        continue;
+      }
+
+      int32_t x, y, width, height;
+      tileCells(it->first.get<0>(), it->first.get<1>(), it->first.get<2>(),
+                info_.width, info_.height, TILE_SIZE, x, y, width, height);
+      // The last texel of a coarse tile can hang off the edge of the map
+      const int32_t step = 1 << it->first.get<0>();
+      width = (width + step - 1) / step * step;
+      height = (height + step - 1) / step * step;
+      quad[0] = mapviz::TexturedVertex(x, y, 0, 0);
+      quad[1] = mapviz::TexturedVertex(x + width, y, 1, 0);
+      quad[2] = mapviz::TexturedVertex(x + width, y + height, 1, 1);
+      quad[3] = mapviz::TexturedVertex(x, y + height, 0, 1);
+      if (indexed_tiles_)
       {
-        size_t index_src = (col + row*width);
-        size_t index_dst = (col + row*texture_size_);
-        uchar color = static_cast<uchar>( grid_->data[ index_src ] );
-        raw_buffer_[index_dst] = color;
-        memcpy( &color_buffer_[index_dst*CHANNELS], &palette[color*CHANNELS], CHANNELS);
+        renderer_->DrawPaletteQuads(tile.texture, quad, palette_, color);
+      }
+      else
+      {
+        renderer_->DrawTexturedQuads(tile.texture, quad, color);
       }
     }
+  }
 
-    texture_x_ = static_cast<float>(width) / static_cast<float>(texture_size_);
-    texture_y_ = static_cast<float>(height) / static_cast<float>(texture_size_);
+  /**
+   * Copies a map into blocks on the callback thread; the GUI thread picks
+   * it up in receiveMap().
+   */
+  void OccupancyGridPlugin::Callback(const nav_msgs::OccupancyGridConstPtr& msg)
+  {
+    const size_t width  = msg->info.width;
+    const size_t height = msg->info.height;
+    if (msg->data.size() < width * height)
+    {
+      PrintError("Map has fewer cells than its size");
+      return;
+    }
+
+    GridUpdate update;
+    update.full = true;
+    update.info = msg->info;
+    update.frame = msg->header.frame_id;
+    update.stamp = msg->header.stamp;
+    update.x = 0;
+    update.y = 0;
+    update.width = static_cast<int32_t>(width);
+    update.height = static_cast<int32_t>(height);
+    {
+      QMutexLocker locker(&ingest_mutex_);
+      ingest_cells_.reset(new OccupancyGridCells(
+          msg->data.data(), static_cast<int32_t>(width), static_cast<int32_t>(height)));
+      // The GUI thread gets its own list of the blocks, which it shares
+      update.cells.reset(new OccupancyGridCells(*ingest_cells_));
+    }
 
-    updateTexture();
-    PrintInfo("Map received");
+    incoming_updates_.Post(std::move(update));
+    Q_EMIT Dirty();
   }
 
+  /**
+   * Applies an update on the callback thread.  The GUI thread and tile
+   * builds may still be reading the blocks it touches, so those are copied
+   * first, but the rest of the map isn't.
+   */
   void OccupancyGridPlugin::CallbackUpdate(const map_msgs::OccupancyGridUpdateConstPtr &msg)
   {
-    PrintInfo("Update Received");
+    GridUpdate update;
+    update.full = false;
+    {
+      QMutexLocker locker(&ingest_mutex_);
+      if (!ingest_cells_)
+      {
+        return;
+      }
+
+      // Clip the update to the map so that a bad one can't write past it
+      const int64_t x = msg->x;
+      const int64_t y = msg->y;
+      const int64_t cols = std::min<int64_t>(msg->width, ingest_cells_->width - x);
+      const int64_t rows = std::min<int64_t>(msg->height, ingest_cells_->height - y);
+      if (x < 0 || y < 0 || cols <= 0 || rows <= 0 ||
+          msg->data.size() < static_cast<size_t>(msg->width) * msg->height)
+      {
+        PrintError("Update is outside of the map");
+        return;
+      }
 
-    if( initialized_ )
+      update.x = static_cast<int32_t>(x);
+      update.y = static_cast<int32_t>(y);
+      update.width = static_cast<int32_t>(cols);
+      update.height = static_cast<int32_t>(rows);
+      ingest_cells_->Write(update.x, update.y, update.width, update.height,
+                           msg->data.data(), msg->width);
+      update.cells.reset(new OccupancyGridCells(*ingest_cells_));
+    }
+
+    incoming_updates_.Post(std::move(update));
+    Q_EMIT Dirty();
+  }
+
+  /**
+   * Takes the maps and updates the callback thread has finished with.
+   */
+  void OccupancyGridPlugin::receiveMap()
+  {
+    std::deque<GridUpdate> updates;
+    if (!incoming_updates_.Take(updates))
     {
-      const Palette& palette = (ui_.color_scheme->currentText() == "map") ?  map_palette_ : costmap_palette_;
+      return;
+    }
 
-      for (size_t row = 0; row < msg->height; row++)
+    for (size_t i = 0; i < updates.size(); i++)
+    {
+      const GridUpdate& update = updates[i];
+      if (update.full)
       {
-        for (size_t col = 0; col < msg->width; col++)
+        const bool same_geometry = has_map_ &&
+            info_.width == update.info.width &&
+            info_.height == update.info.height &&
+            info_.resolution == update.info.resolution &&
+            info_.origin.position.x == update.info.origin.position.x &&
+            info_.origin.position.y == update.info.origin.position.y;
+
+        initialized_ = true;
+        has_map_ = true;
+        info_ = update.info;
+        source_frame_ = update.frame;
+        transformed_ = GetTransform( source_frame_, update.stamp, transform_);
+        if ( !transformed_ )
+        {
+          PrintError("No transform between " + source_frame_ + " and " + target_frame_);
+        }
+
+        if (same_geometry)
+        {
+          // Keep showing the tiles that are resident until they've been rebuilt
+          invalidateTiles();
+        }
+        else
         {
-          size_t index_src = (col + row * msg->width);
-          size_t index_dst = ( (col + msg->x) + (row + msg->y)*texture_size_);
-          uchar color = static_cast<uchar>( msg->data[ index_src ] );
-          raw_buffer_[index_dst] = color;
-          memcpy( &color_buffer_[index_dst*CHANNELS], &palette[color*CHANNELS], CHANNELS);
+          clearTiles();
+          max_level_ = 0;
+          while ((TILE_SIZE << max_level_) < std::max(update.width, update.height))
+          {
+            max_level_++;
+          }
         }
+
+        PrintInfo("Map received");
+      }
+      else if (has_map_)
+      {
+        invalidateCells(update.x, update.y, update.width, update.height);
+        PrintInfo("Update Received");
+      }
+      cells_ = update.cells;
+    }
+  }
+
+  /**
+   * Resident level 0 tiles only upload the cells that changed; any other
+   * tile the cells are in is rebuilt.
+   */
+  void OccupancyGridPlugin::invalidateCells(int32_t x, int32_t y, int32_t width, int32_t height)
+  {
+    for (std::map<TileKey, Tile>::iterator it = tiles_.begin(); it != tiles_.end(); ++it)
+    {
+      int32_t tile_x, tile_y, tile_width, tile_height;
+      tileCells(it->first.get<0>(), it->first.get<1>(), it->first.get<2>(),
+                info_.width, info_.height, TILE_SIZE, tile_x, tile_y, tile_width, tile_height);
+      const int32_t x0 = std::max(x, tile_x) - tile_x;
+      const int32_t y0 = std::max(y, tile_y) - tile_y;
+      const int32_t x1 = std::min(x + width, tile_x + tile_width) - tile_x;
+      const int32_t y1 = std::min(y + height, tile_y + tile_height) - tile_y;
+      if (x1 <= x0 || y1 <= y0)
+      {
+        continue;
+      }
+
+      Tile& tile = it->second;
+      if (it->first.get<0>() != 0 || tile.building || tile.built_generation != tile.generation)
+      {
+        tile.generation++;
+      }
+      else if (tile.dirty_x1 <= tile.dirty_x0)
+      {
+        tile.dirty_x0 = x0;
+        tile.dirty_y0 = y0;
+        tile.dirty_x1 = x1;
+        tile.dirty_y1 = y1;
+      }
+      else
+      {
+        tile.dirty_x0 = std::min(tile.dirty_x0, x0);
+        tile.dirty_y0 = std::min(tile.dirty_y0, y0);
+        tile.dirty_x1 = std::max(tile.dirty_x1, x1);
+        tile.dirty_y1 = std::max(tile.dirty_y1, y1);
       }
-      updateTexture();
     }
   }
 
   void OccupancyGridPlugin::Draw(double x, double y, double scale)
   {
+    if (!stale_textures_.empty())
+    {
+      glDeleteTextures(static_cast<GLsizei>(stale_textures_.size()), stale_textures_.data());
+      stale_textures_.clear();
+    }
+
+    receiveMap();
+
+    const bool indexed = renderer_->Initialize() && renderer_->ShadersSupported();
+    if (indexed != indexed_tiles_)
+    {
+      // Tiles are stored differently with and without shaders
+      clearTiles();
+      indexed_tiles_ = indexed;
+    }
+    receiveTiles();
+
     glPushMatrix();
 
-    if( grid_ && transformed_)
+    if( has_map_ && cells_ && transformed_)
     {
-      double resolution = grid_->info.resolution;
+      double resolution = info_.resolution;
       glTranslatef( transform_.GetOrigin().getX(),
                     transform_.GetOrigin().getY(),
                     0.0);
@@ -441,48 +1242,29 @@ namespace mapviz_plugins
       glRotatef(roll  * RAD_TO_DEG, 1, 0, 0);
       glRotatef(yaw   * RAD_TO_DEG, 0, 0, 1);
 
-      glTranslatef( grid_->info.origin.position.x,
-                    grid_->info.origin.position.y,
+      glTranslatef( info_.origin.position.x,
+                    info_.origin.position.y,
                     0.0);
 
       glScalef( resolution, resolution, 1.0);
 
-      float width  = static_cast<float>(grid_->info.width);
-      float height = static_cast<float>(grid_->info.height);
-
-      glEnable(GL_TEXTURE_2D);
-      glBindTexture(GL_TEXTURE_2D, texture_id_);
-      glBegin(GL_TRIANGLES);
-
-      glColor4f(1.0f, 1.0f, 1.0f, ui_.alpha->value() );
-
-      glTexCoord2d(0, 0);
-      glVertex2d(0, 0);
-      glTexCoord2d(texture_x_, 0);
-      glVertex2d(width, 0);
-      glTexCoord2d(texture_x_, texture_y_);
-      glVertex2d(width, height);
-
-      glTexCoord2d(0, 0);
-      glVertex2d(0, 0);
-      glTexCoord2d(texture_x_, texture_y_);
-      glVertex2d(width, height);
-      glTexCoord2d(0, texture_y_);
-      glVertex2d(0, height);
-
-      glEnd();
-
-      glBindTexture(GL_TEXTURE_2D, 0);
-      glDisable(GL_TEXTURE_2D);
+      int level;
+      int32_t x0, y0, x1, y1;
+      if (visibleCells(level, x0, y0, x1, y1))
+      {
+        updateTiles(level, x0, y0, x1, y1);
+        drawTiles(level);
+      }
     }
     glPopMatrix();
   }
 
   void OccupancyGridPlugin::Transform()
   {
+    receiveMap();
     if( !initialized_ ) return;
     swri_transform_util::Transform transform;
-    if ( grid_ )
+    if ( has_map_ )
     {
       if( GetTransform( source_frame_, ros::Time(0), transform) )
       {
@@ -519,6 +1301,45 @@ namespace mapviz_plugins
       ui_.alpha->setValue(alpha);
     }
 
+    if (node["palette_file"])
+    {
+      node["palette_file"] >> palette_file_;
+      std::string filename = palette_file_;
+      if (!filename.empty() && filename[0] != '/' && !path.empty())
+      {
+        filename = path + "/" + filename;
+      }
+
+      YAML::Node doc;
+      if (swri_yaml_util::LoadFile(filename, doc) && doc["palettes"])
+      {
+        loadPalettes(doc["palettes"]);
+      }
+      else
+      {
+        PrintError("Failed to load palettes from " + filename);
+      }
+    }
+
+    if (node["palettes"])
+    {
+      palettes_config_ = node["palettes"];
+      loadPalettes(palettes_config_);
+    }
+
+    if (node["scheme"])
+    {
+      std::string scheme;
+      node["scheme"] >> scheme;
+      const int index = ui_.color_scheme->findText(QString::fromStdString(scheme));
+      if (index >= 0)
+      {
+        ui_.color_scheme->setCurrentIndex(index);
+      }
+    }
+    // A palette may have been redefined without the scheme changing
+    colorSchemeUpdated(ui_.color_scheme->currentText());
+
     TopicGridEdited();
   }
 
@@ -528,6 +1349,14 @@ namespace mapviz_plugins
     emitter << YAML::Key << "topic"  << YAML::Value << ui_.topic_grid->text().toStdString();
     emitter << YAML::Key << "update" << YAML::Value << ui_.checkbox_update->isChecked();
     emitter << YAML::Key << "scheme" << YAML::Value << ui_.color_scheme->currentText().toStdString();
+    if (!palette_file_.empty())
+    {
+      emitter << YAML::Key << "palette_file" << YAML::Value << palette_file_;
+    }
+    if (palettes_config_)
+    {
+      emitter << YAML::Key << "palettes" << YAML::Value << palettes_config_;
+    }
   }
 }
 
@@ -159,35 +159,35 @@ namespace mapviz_plugins
         odometry->pose.pose.orientation.z,
         odometry->pose.pose.orientation.w);
 
-    if ( ui_.show_covariance->isChecked() )
-    {
-      tf::Matrix3x3 tf_cov =
-          swri_transform_util::GetUpperLeft(odometry->pose.covariance);
+    // The covariance is kept whether or not it's shown, so that turning it on
+    // draws the whole history.
+    tf::Matrix3x3 tf_cov =
+        swri_transform_util::GetUpperLeft(odometry->pose.covariance);
 
-      if (tf_cov[0][0] < 100000 && tf_cov[1][1] < 100000)
+    if (tf_cov[0][0] < 100000 && tf_cov[1][1] < 100000)
+    {
+      cv::Mat cov_matrix_3d(3, 3, CV_32FC1);
+      for (int32_t r = 0; r < 3; r++)
       {
-        cv::Mat cov_matrix_3d(3, 3, CV_32FC1);
-        for (int32_t r = 0; r < 3; r++)
+        for (int32_t c = 0; c < 3; c++)
         {
-          for (int32_t c = 0; c < 3; c++)
-          {
-            cov_matrix_3d.at<float>(r, c) = tf_cov[r][c];
-          }
+          cov_matrix_3d.at<float>(r, c) = tf_cov[r][c];
         }
+      }
 
-        cv::Mat cov_matrix_2d = swri_image_util::ProjectEllipsoid(cov_matrix_3d);
-
-        if (!cov_matrix_2d.empty())
-        {
-          stamped_point.cov_points = swri_image_util::GetEllipsePoints(
-              cov_matrix_2d, stamped_point.point, 3, 32);
+      cv::Mat cov_matrix_2d = swri_image_util::ProjectEllipsoid(cov_matrix_3d);
 
-          stamped_point.transformed_cov_points = stamped_point.cov_points;
-        }
-        else
-        {
-          ROS_ERROR("Failed to project x, y, z covariance to xy-plane.");
-        }
+      if (!cov_matrix_2d.empty())
+      {
+        // Only the 2x2 matrix is kept; the ellipse is drawn from it.
+        stamped_point.has_covariance = true;
+        stamped_point.covariance = cv::Matx22f(
+            cov_matrix_2d.at<float>(0, 0), cov_matrix_2d.at<float>(0, 1),
+            cov_matrix_2d.at<float>(1, 0), cov_matrix_2d.at<float>(1, 1));
+      }
+      else if (ui_.show_covariance->isChecked())
+      {
+        ROS_ERROR("Failed to project x, y, z covariance to xy-plane.");
       }
     }
 
@@ -257,18 +257,17 @@ namespace mapviz_plugins
     QPen pen(QBrush(ui_.color->color()), 1);
     painter->setPen(pen);
 
-    int counter = 0;//used to alternate between rendering text on some points
-    for (const StampedPoint& point: points())
+    const PointHistory& history = points();
+    for (size_t i = 0; i < history.Size(); i += interval)//this renders a timestamp every 'interval' points
     {
-      if (point.transformed && counter % interval == 0)//this renders a timestamp every 'interval' points
+      if (history.Transformed(i))
       {
-        QPointF qpoint = tf.map(QPointF(point.transformed_point.getX(),
-                                        point.transformed_point.getY()));
+        QPointF qpoint = tf.map(QPointF(history.TransformedX(i),
+                                        history.TransformedY(i)));
         QString time;
-        time.setNum(point.stamp.toSec(), 'g', 12);
+        time.setNum(history.Stamp(i).toSec(), 'g', 12);
         painter->drawText(qpoint, time);
       }
-      counter++;
     }
 
     painter->restore();
@@ -0,0 +1,368 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <GL/glew.h>
+#include <mapviz_plugins/point_cloud_accumulator.h>
+
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mapviz_plugins
+{
+  PointCloudAccumulator::PointCloudAccumulator() :
+    resolution_(0.2),
+    statistic_(MAX_Z),
+    decay_time_(0),
+    max_tiles_(1024),
+    time_origin_(-1),
+    last_decay_(0),
+    version_(1),
+    colormap_version_(0),
+    unpack_rgb_(false)
+  {
+    ResetRange();
+  }
+
+  PointCloudAccumulator::~PointCloudAccumulator()
+  {
+  }
+
+  void PointCloudAccumulator::SetResolution(double resolution)
+  {
+    if (resolution > 0 && resolution != resolution_)
+    {
+      resolution_ = resolution;
+      Clear();
+    }
+  }
+
+  void PointCloudAccumulator::SetStatistic(Statistic statistic)
+  {
+    if (statistic != statistic_)
+    {
+      statistic_ = statistic;
+      version_++;
+    }
+  }
+
+  void PointCloudAccumulator::SetDecayTime(double seconds)
+  {
+    decay_time_ = std::max(0.0, seconds);
+  }
+
+  void PointCloudAccumulator::SetMaxTiles(size_t max_tiles)
+  {
+    max_tiles_ = max_tiles;
+  }
+
+  void PointCloudAccumulator::Add(const float* xyz, const float* values, size_t count,
+      const tf::Transform& transform, double stamp)
+  {
+    if (time_origin_ < 0)
+    {
+      time_origin_ = stamp;
+    }
+    const float cell_stamp = static_cast<float>(stamp - time_origin_);
+
+    // Points from a scan tend to land in the same tile as the one before
+    // them, so remember it rather than looking it up every time.
+    TileIndex current_index(0, 0);
+    Tile* current = NULL;
+
+    for (size_t i = 0; i < count; i++, xyz += 3)
+    {
+      if (!std::isfinite(xyz[0]) || !std::isfinite(xyz[1]) || !std::isfinite(xyz[2]))
+      {
+        continue;
+      }
+
+      const tf::Point point = transform * tf::Point(xyz[0], xyz[1], xyz[2]);
+      const int64_t cell_x = static_cast<int64_t>(std::floor(point.x() / resolution_));
+      const int64_t cell_y = static_cast<int64_t>(std::floor(point.y() / resolution_));
+      const TileIndex index(
+          static_cast<int32_t>(cell_x >= 0 ? cell_x / TILE_SIZE : (cell_x + 1) / TILE_SIZE - 1),
+          static_cast<int32_t>(cell_y >= 0 ? cell_y / TILE_SIZE : (cell_y + 1) / TILE_SIZE - 1));
+
+      if (current == NULL || index != current_index)
+      {
+        current = &GetTile(index, stamp);
+        current_index = index;
+      }
+
+      const int64_t local_x = cell_x - static_cast<int64_t>(index.first) * TILE_SIZE;
+      const int64_t local_y = cell_y - static_cast<int64_t>(index.second) * TILE_SIZE;
+      Cell& cell = current->cells[local_y * TILE_SIZE + local_x];
+
+      const float z = static_cast<float>(point.z());
+      const float value = values[i];
+      cell.max_z = cell.count == 0 ? z : std::max(cell.max_z, z);
+      cell.value_sum = cell.count == 0 ? value : cell.value_sum + value;
+      cell.last_value = value;
+      cell.count++;
+      cell.stamp = cell_stamp;
+      current->dirty = true;
+
+      z_min_ = std::min(z_min_, z);
+      z_max_ = std::max(z_max_, z);
+      value_min_ = std::min(value_min_, value);
+      value_max_ = std::max(value_max_, value);
+      count_max_ = std::max(count_max_, cell.count);
+    }
+  }
+
+  void PointCloudAccumulator::Decay(double now)
+  {
+    if (decay_time_ <= 0 || time_origin_ < 0 || now - last_decay_ < 1.0)
+    {
+      return;
+    }
+    last_decay_ = now;
+
+    const double cutoff = now - decay_time_;
+    const float cell_cutoff = static_cast<float>(cutoff - time_origin_);
+    std::map<TileIndex, Tile>::iterator it = tiles_.begin();
+    while (it != tiles_.end())
+    {
+      Tile& tile = it->second;
+      if (tile.last_update < cutoff)
+      {
+        DropTile(it++);
+        continue;
+      }
+
+      for (Cell& cell: tile.cells)
+      {
+        if (cell.count > 0 && cell.stamp < cell_cutoff)
+        {
+          cell = Cell();
+          tile.dirty = true;
+        }
+      }
+      ++it;
+    }
+  }
+
+  void PointCloudAccumulator::Clear()
+  {
+    while (!tiles_.empty())
+    {
+      DropTile(tiles_.begin());
+    }
+    time_origin_ = -1;
+    ResetRange();
+  }
+
+  bool PointCloudAccumulator::Range(float& min, float& max) const
+  {
+    if (count_max_ == 0)
+    {
+      return false;
+    }
+
+    switch (statistic_)
+    {
+      case MAX_Z:
+        min = z_min_;
+        max = z_max_;
+        break;
+      case HIT_COUNT:
+        min = 1;
+        max = count_max_;
+        break;
+      case MEAN_VALUE:
+      case LAST_VALUE:
+      default:
+        min = value_min_;
+        max = value_max_;
+        break;
+    }
+    return true;
+  }
+
+  float PointCloudAccumulator::CellValue(const Cell& cell) const
+  {
+    switch (statistic_)
+    {
+      case MAX_Z:
+        return cell.max_z;
+      case MEAN_VALUE:
+        return cell.value_sum / cell.count;
+      case HIT_COUNT:
+        return cell.count;
+      case LAST_VALUE:
+      default:
+        return cell.last_value;
+    }
+  }
+
+  void PointCloudAccumulator::Draw(mapviz::Renderer* renderer,
+      const mapviz::Colormap& colormap, float alpha, bool unpack_rgb)
+  {
+    if (!stale_textures_.empty())
+    {
+      glDeleteTextures(static_cast<GLsizei>(stale_textures_.size()), &stale_textures_[0]);
+      stale_textures_.clear();
+    }
+
+    if (colormap.Version() != colormap_version_ || unpack_rgb != unpack_rgb_)
+    {
+      colormap_version_ = colormap.Version();
+      unpack_rgb_ = unpack_rgb;
+      version_++;
+    }
+    const bool unpack = unpack_rgb_ && statistic_ == LAST_VALUE;
+
+    const float size = TILE_SIZE * resolution_;
+    const QColor color(255, 255, 255, static_cast<int>(alpha * 255.0f));
+    for (std::map<TileIndex, Tile>::iterator it = tiles_.begin(); it != tiles_.end(); ++it)
+    {
+      Tile& tile = it->second;
+      if (tile.dirty || tile.colors_version != version_)
+      {
+        // Empty cells are left transparent
+        tile.rgba.resize(TILE_SIZE * TILE_SIZE * 4);
+        for (size_t i = 0; i < tile.cells.size(); i++)
+        {
+          const Cell& cell = tile.cells[i];
+          uint8_t* rgba = &tile.rgba[i * 4];
+          if (cell.count == 0)
+          {
+            std::fill(rgba, rgba + 4, 0);
+          }
+          else if (unpack)
+          {
+            const uint8_t* packed = reinterpret_cast<const uint8_t*>(&cell.last_value);
+            rgba[0] = packed[2];
+            rgba[1] = packed[1];
+            rgba[2] = packed[0];
+            rgba[3] = 255;
+          }
+          else
+          {
+            colormap.Lookup(CellValue(cell), rgba);
+            rgba[3] = 255;
+          }
+        }
+
+        if (tile.texture == 0)
+        {
+          glGenTextures(1, &tile.texture);
+          glBindTexture(GL_TEXTURE_2D, tile.texture);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+          glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, TILE_SIZE, TILE_SIZE, 0,
+              GL_RGBA, GL_UNSIGNED_BYTE, &tile.rgba[0]);
+        }
+        else
+        {
+          glBindTexture(GL_TEXTURE_2D, tile.texture);
+          glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TILE_SIZE, TILE_SIZE,
+              GL_RGBA, GL_UNSIGNED_BYTE, &tile.rgba[0]);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        tile.dirty = false;
+        tile.colors_version = version_;
+      }
+
+      const float x0 = it->first.first * size;
+      const float y0 = it->first.second * size;
+      quad_.clear();
+      quad_.push_back(mapviz::TexturedVertex(x0, y0, 0, 0));
+      quad_.push_back(mapviz::TexturedVertex(x0 + size, y0, 1, 0));
+      quad_.push_back(mapviz::TexturedVertex(x0 + size, y0 + size, 1, 1));
+      quad_.push_back(mapviz::TexturedVertex(x0, y0 + size, 0, 1));
+      renderer->DrawTexturedQuads(tile.texture, quad_, color);
+    }
+  }
+
+  size_t PointCloudAccumulator::Bytes() const
+  {
+    return tiles_.size() * TILE_SIZE * TILE_SIZE * (sizeof(Cell) + 4);
+  }
+
+  void PointCloudAccumulator::Destroy()
+  {
+    Clear();
+    if (!stale_textures_.empty())
+    {
+      glDeleteTextures(static_cast<GLsizei>(stale_textures_.size()), &stale_textures_[0]);
+      stale_textures_.clear();
+    }
+  }
+
+  PointCloudAccumulator::Tile& PointCloudAccumulator::GetTile(const TileIndex& index, double stamp)
+  {
+    std::map<TileIndex, Tile>::iterator it = tiles_.find(index);
+    if (it == tiles_.end())
+    {
+      if (max_tiles_ > 0 && tiles_.size() >= max_tiles_)
+      {
+        std::map<TileIndex, Tile>::iterator oldest = tiles_.begin();
+        for (std::map<TileIndex, Tile>::iterator candidate = tiles_.begin();
+             candidate != tiles_.end(); ++candidate)
+        {
+          if (candidate->second.last_update < oldest->second.last_update)
+          {
+            oldest = candidate;
+          }
+        }
+        DropTile(oldest);
+      }
+
+      it = tiles_.insert(std::make_pair(index, Tile())).first;
+      it->second.cells.resize(TILE_SIZE * TILE_SIZE);
+    }
+
+    it->second.last_update = std::max(it->second.last_update, stamp);
+    return it->second;
+  }
+
+  void PointCloudAccumulator::DropTile(std::map<TileIndex, Tile>::iterator it)
+  {
+    if (it->second.texture != 0)
+    {
+      stale_textures_.push_back(it->second.texture);
+    }
+    tiles_.erase(it);
+  }
+
+  void PointCloudAccumulator::ResetRange()
+  {
+    z_min_ = std::numeric_limits<float>::max();
+    z_max_ = -std::numeric_limits<float>::max();
+    value_min_ = std::numeric_limits<float>::max();
+    value_max_ = -std::numeric_limits<float>::max();
+    count_max_ = 0;
+  }
+}
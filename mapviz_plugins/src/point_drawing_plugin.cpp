@@ -29,6 +29,8 @@
 
 #include <mapviz_plugins/point_drawing_plugin.h>
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include <list>
 
@@ -39,11 +41,36 @@
 
 #include <opencv2/core/core.hpp>
 
-#include <swri_image_util/geometry_util.h>
 #include <swri_transform_util/transform_util.h>
 
 namespace mapviz_plugins
 {
+  namespace
+  {
+    /**
+     * The heading that a yaw in a transform's source frame has in its target
+     * frame.
+     */
+    float transformYaw(const swri_transform_util::Transform& transform, double yaw)
+    {
+      const tf::Vector3 heading = tf::quatRotate(
+          transform.GetOrientation(), tf::Vector3(std::cos(yaw), std::sin(yaw), 0.0));
+      return static_cast<float>(std::atan2(heading.y(), heading.x()));
+    }
+
+    /**
+     * Rotates an xy-plane covariance into a transform's target frame.
+     */
+    cv::Matx22f transformCovariance(const swri_transform_util::Transform& transform,
+                                    const cv::Matx22f& covariance)
+    {
+      const tf::Matrix3x3 basis(transform.GetOrientation());
+      const cv::Matx22f rotation(basis[0][0], basis[0][1],
+                                 basis[1][0], basis[1][1]);
+      return rotation * covariance * rotation.t();
+    }
+  }
+
   PointDrawingPlugin::PointDrawingPlugin()
       : arrow_size_(25),
         draw_style_(LINES),
@@ -55,7 +82,9 @@ namespace mapviz_plugins
         buffer_holder_(false),
         scale_(1.0),
         static_arrow_sizes_(false),
-        got_begin_(false)
+        got_begin_(false),
+        instance_generation_(1),
+        lap_arrows_generation_(0)
   {
     QObject::connect(this,
                      SIGNAL(TargetFrameChanged(const std::string&)),
@@ -65,7 +94,8 @@ namespace mapviz_plugins
 
   void PointDrawingPlugin::ClearHistory()
   {
-    points_.clear();
+    points_.Clear();
+    markInstancesDirty();
   }
 
   void PointDrawingPlugin::DrawIcon()
@@ -111,7 +141,6 @@ namespace mapviz_plugins
   void PointDrawingPlugin::SetArrowSize(int arrowSize)
   {
     arrow_size_ = arrowSize;
-    ResetTransformedPoints();
   }
 
   void PointDrawingPlugin::SetDrawStyle(QString style)
@@ -128,7 +157,6 @@ namespace mapviz_plugins
     {
       draw_style_ = ARROWS;
     }
-    ResetTransformedPoints();
     DrawIcon();
   }
 
@@ -141,7 +169,6 @@ namespace mapviz_plugins
   void PointDrawingPlugin::SetStaticArrowSizes(bool isChecked)
   {
     static_arrow_sizes_ = isChecked;
-    ResetTransformedPoints();
   }
 
   void PointDrawingPlugin::PositionToleranceChanged(double value)
@@ -161,43 +188,58 @@ namespace mapviz_plugins
 
   void PointDrawingPlugin::ResetTransformedPoints()
   {
-    for (std::deque<StampedPoint>& lap: laps_)
+    for (PointHistory& lap: laps_)
     {
-      for (StampedPoint& point: lap)
-      {
-        point.transformed = false;
-      }
+      lap.ResetTransformed();
     }
-    for (StampedPoint& point: points_)
+    points_.ResetTransformed();
+    cur_point_.transformed = false;
+    markInstancesDirty();
+    Transform();
+  }
+
+  void PointDrawingPlugin::pushHistory(PointHistory& history, const StampedPoint& point)
+  {
+    history.Push(point.point.x(), point.point.y(), point.point.z(),
+                 static_cast<float>(tf::getYaw(point.orientation)),
+                 point.stamp,
+                 frames_.Intern(point.source_frame));
+    if (point.has_covariance)
     {
-      point.transformed = false;
+      history.SetCovariance(history.Size() - 1,
+                            point.covariance(0, 0),
+                            point.covariance(0, 1),
+                            point.covariance(1, 1));
     }
-    Transform();
   }
 
   void PointDrawingPlugin::pushPoint(PointDrawingPlugin::StampedPoint stamped_point)
   {
     cur_point_ = stamped_point;
 
-    if (points_.empty() ||
-        (stamped_point.point.distance(points_.back().point)) >=
+    const size_t last = points_.Size() - 1;
+    if (points_.Empty() ||
+        (stamped_point.point.distance(tf::Point(points_.X(last), points_.Y(last), points_.Z(last)))) >=
             (position_tolerance_))
     {
-      points_.push_back(stamped_point);
+      pushHistory(points_, stamped_point);
     }
 
     if (buffer_size_ > 0)
     {
-      while (static_cast<int>(points_.size()) >= buffer_size_)
-      {
-        points_.pop_front();
-      }
+      // The current point makes up the rest of the buffer
+      points_.Trim(buffer_size_ - 1);
     }
+
+    Q_EMIT Dirty();
   }
 
   void PointDrawingPlugin::ClearPoints()
   {
-    points_.clear();
+    points_.Clear();
+    markInstancesDirty();
+
+    Q_EMIT Dirty();
   }
 
   double PointDrawingPlugin::bufferSize() const
@@ -217,30 +259,34 @@ namespace mapviz_plugins
     return position_tolerance_;
   }
 
-  const std::deque<PointDrawingPlugin::StampedPoint> &PointDrawingPlugin::points() const
+  const PointHistory& PointDrawingPlugin::points() const
   {
     return points_;
   }
 
+  void PointDrawingPlugin::destroyInstances()
+  {
+    arrows_.batch.Destroy();
+    lap_arrows_.Destroy();
+    current_lap_arrows_.batch.Destroy();
+    ellipses_.batch.Destroy();
+  }
+
   void PointDrawingPlugin::BufferSizeChanged(int value)
   {
     buffer_size_ = value;
 
     if (buffer_size_ > 0)
     {
-      while (static_cast<int>(points_.size()) >= buffer_size_)
-      {
-        points_.pop_front();
-      }
+      points_.Trim(buffer_size_ - 1);
     }
+    markInstancesDirty();
   }
 
   bool PointDrawingPlugin::DrawPoints(double scale)
   {
-    if( scale_ != scale && draw_style_ == ARROWS && static_arrow_sizes_)
-    {
-      ResetTransformedPoints();
-    }
+    // Arrows are sized when they're drawn, so zooming doesn't have to
+    // transform anything again.
     scale_ = scale;
     bool transformed = true;
     if (lap_checked_)
@@ -261,6 +307,7 @@ namespace mapviz_plugins
       buffer_size_ = buffer_holder_;
       laps_.clear();
       got_begin_ = false;
+      markInstancesDirty();
     }
     if (draw_style_ == ARROWS)
     {
@@ -279,7 +326,8 @@ namespace mapviz_plugins
     if (!got_begin_)
     {
       begin_ = cur_point_.point;
-      points_.clear();
+      points_.Clear();
+      markInstancesDirty();
       buffer_holder_ = buffer_size_;
       buffer_size_ = INT_MAX;
       got_begin_ = true;
@@ -289,12 +337,13 @@ namespace mapviz_plugins
         !new_lap_)
     {
       new_lap_ = true;
-      if (points_.size() > 0)
+      if (!points_.Empty())
       {
         laps_.push_back(points_);
-        laps_[0].pop_back();
-        points_.clear();
-        points_.push_back(cur_point_);
+        laps_[0].PopBack();
+        points_.Clear();
+        pushHistory(points_, cur_point_);
+        markInstancesDirty();
       }
     }
 
@@ -308,78 +357,186 @@ namespace mapviz_plugins
   bool PointDrawingPlugin::DrawLines()
   {
     bool success = cur_point_.transformed;
-    glColor4d(color_.redF(), color_.greenF(), color_.blueF(), 1.0);
-    if (draw_style_ == LINES && points_.size()>0)
+    const QColor color(color_.red(), color_.green(), color_.blue(), 255);
+
+    vertices_.clear();
+    success &= appendHistory(points_, color);
+
+    if (cur_point_.transformed)
     {
-      glLineWidth(3);
-      glBegin(GL_LINE_STRIP);
+      vertices_.push_back(mapviz::ColorVertex(
+          cur_point_.transformed_point.getX(),
+          cur_point_.transformed_point.getY(),
+          color));
+    }
+
+    if (draw_style_ == LINES && !points_.Empty())
+    {
+      renderer_->DrawLineStrip(vertices_, 3);
     }
     else
     {
-      glPointSize(6);
-      glBegin(GL_POINTS);
+      renderer_->DrawPoints(vertices_, 6);
     }
 
-    for (const auto& pt : points_)
+    return success;
+  }
+
+  /**
+   * Appends a history's transformed points to vertices_, leaving out those
+   * that are within a pixel of the ones around them.
+   * @return false if any of the points drawn couldn't be transformed
+   */
+  bool PointDrawingPlugin::appendHistory(const PointHistory& history, const QColor& color)
+  {
+    bool success = true;
+    history.Simplify(scale_, indices_);
+    for (size_t i = 0; i < indices_.size(); i++)
     {
-      success &= pt.transformed;
-      if (pt.transformed)
+      const size_t index = indices_[i];
+      if (history.Transformed(index))
       {
-        glVertex2d(pt.transformed_point.getX(), pt.transformed_point.getY());
+        vertices_.push_back(mapviz::ColorVertex(
+            history.TransformedX(index), history.TransformedY(index), color));
+      }
+      else
+      {
+        success = false;
       }
     }
+    return success;
+  }
 
-    if (cur_point_.transformed)
+  /**
+   * Places a unit arrow glyph; it's scaled to its length when it's drawn.
+   */
+  mapviz::Instance PointDrawingPlugin::makeArrow(float x, float y, float yaw, const QColor& color)
+  {
+    mapviz::Instance arrow;
+    arrow.x = x;
+    arrow.y = y;
+    arrow.x_axis_x = std::cos(yaw);
+    arrow.x_axis_y = std::sin(yaw);
+    arrow.y_axis_x = -arrow.x_axis_y;
+    arrow.y_axis_y = arrow.x_axis_x;
+    arrow.r = static_cast<uint8_t>(color.red());
+    arrow.g = static_cast<uint8_t>(color.green());
+    arrow.b = static_cast<uint8_t>(color.blue());
+    arrow.a = static_cast<uint8_t>(color.alpha());
+    return arrow;
+  }
+
+  void PointDrawingPlugin::appendArrows(const PointHistory& history, const QColor& color,
+                                        std::vector<mapviz::Instance>& arrows)
+  {
+    for (size_t i = 0; i < history.Size(); i++)
     {
-      glVertex2d(cur_point_.transformed_point.getX(),
-                 cur_point_.transformed_point.getY());
+      if (history.Transformed(i))
+      {
+        arrows.push_back(makeArrow(
+            history.TransformedX(i), history.TransformedY(i), history.TransformedYaw(i), color));
+      }
     }
+  }
 
-    glEnd();
-
-    return success;
+  /**
+   * The length of an arrow in the target frame.  Static arrow sizes are in
+   * pixels, so they follow the zoom; otherwise they're tenths of a meter.
+   */
+  float PointDrawingPlugin::arrowLength() const
+  {
+    double size = static_cast<double>(arrow_size_);
+    if (static_arrow_sizes_)
+    {
+      size *= scale_;
+    }
+    else
+    {
+      size /= 10.0;
+    }
+    return static_cast<float>(size);
   }
 
-  bool PointDrawingPlugin::DrawArrow(const StampedPoint& it)
+  /**
+   * Skips the glyphs of points that have been dropped from the front of
+   * points_, and clears the batch if the points have changed in any other
+   * way than by new ones being added.
+   * @return true if the batch has to be built again from the start
+   */
+  bool PointDrawingPlugin::resetInstances(HistoryInstances& instances)
   {
-      if (it.transformed)
+    const uint64_t first_sequence = points_.FirstSequence();
+    if (instances.generation == instance_generation_ &&
+        first_sequence >= instances.sequence &&
+        first_sequence - instances.sequence <= instances.Placed() &&
+        instances.sequence + instances.Placed() <= first_sequence + points_.Size())
+    {
+      instances.first += static_cast<size_t>(first_sequence - instances.sequence);
+      instances.sequence = first_sequence;
+      if (instances.first > instances.batch.Size() / 2)
       {
-        glVertex2d(it.transformed_point.getX(),
-                   it.transformed_point.getY());
-
-        glVertex2d(it.transformed_arrow_point.getX(),
-                   it.transformed_arrow_point.getY());
-
-        glVertex2d(it.transformed_arrow_point.getX(),
-                   it.transformed_arrow_point.getY());
-        glVertex2d(it.transformed_arrow_left.getX(),
-                   it.transformed_arrow_left.getY());
-
-        glVertex2d(it.transformed_arrow_point.getX(),
-                   it.transformed_arrow_point.getY());
-        glVertex2d(it.transformed_arrow_right.getX(),
-                   it.transformed_arrow_right.getY());
-        return true;
-       }
+        // Once most of the batch has been skipped it's compacted, which
+        // copies each glyph about once however long the history runs.
+        std::vector<mapviz::Instance>& glyphs = instances.batch.Edit();
+        glyphs.erase(glyphs.begin(), glyphs.begin() + instances.first);
+        instances.first = 0;
+      }
       return false;
+    }
+
+    instances.batch.Edit().clear();
+    instances.generation = instance_generation_;
+    instances.first = 0;
+    instances.sequence = first_sequence;
+    return true;
   }
 
-  bool PointDrawingPlugin::DrawArrows()
+  /**
+   * Places arrows at the points of points_ that don't have one yet.  Up to
+   * the first point that isn't transformed, they're added to the batch;
+   * the points after that might be transformed in any order, so their
+   * arrows go in unplaced_.
+   */
+  void PointDrawingPlugin::placeArrows(HistoryInstances& instances, const QColor& color)
   {
-    bool success = true;
-    glLineWidth(4);
-    glBegin(GL_LINES);
-    glColor4d(color_.redF(), color_.greenF(), color_.blueF(), 0.5);
-    for (const auto &pt : points_)
+    std::vector<mapviz::Instance>& arrows = instances.batch.Append();
+    size_t i = instances.Placed();
+    for (; i < points_.Size() && points_.Transformed(i); i++)
     {
-      success &= DrawArrow(pt);
+      arrows.push_back(makeArrow(
+          points_.TransformedX(i), points_.TransformedY(i), points_.TransformedYaw(i), color));
     }
 
-    success &= DrawArrow(cur_point_);
+    for (; i < points_.Size(); i++)
+    {
+      if (points_.Transformed(i))
+      {
+        unplaced_.push_back(makeArrow(
+            points_.TransformedX(i), points_.TransformedY(i), points_.TransformedYaw(i), color));
+      }
+    }
+  }
 
-    glEnd();
+  bool PointDrawingPlugin::DrawArrows()
+  {
+    const QColor color(color_.red(), color_.green(), color_.blue(), 127);
 
-    return success;
+    resetInstances(arrows_);
+    unplaced_.clear();
+    placeArrows(arrows_, color);
+    if (cur_point_.transformed)
+    {
+      unplaced_.push_back(makeArrow(cur_point_.transformed_point.getX(),
+                                    cur_point_.transformed_point.getY(),
+                                    cur_point_.transformed_yaw,
+                                    color));
+    }
+
+    glLineWidth(4);
+    renderer_->DrawInstances(mapviz::MESH_ARROW, arrows_.batch, arrowLength(), arrows_.first);
+    renderer_->DrawInstances(mapviz::MESH_ARROW, unplaced_, arrowLength());
+
+    return points_.AllTransformed() && cur_point_.transformed;
   }
 
   void PointDrawingPlugin::SetColor(const QColor& color)
@@ -387,6 +544,7 @@ namespace mapviz_plugins
     if (color != color_)
     {
       color_ = color;
+      markInstancesDirty();
       DrawIcon();
     }
   }
@@ -402,38 +560,10 @@ namespace mapviz_plugins
     if( GetTransform(point.source_frame, point.stamp, transform))
     {
       point.transformed_point = transform * point.point;
-
-      if (draw_style_ == ARROWS)
+      point.transformed_yaw = transformYaw(transform, tf::getYaw(point.orientation));
+      if (point.has_covariance)
       {
-        tf::Transform orientation(tf::Transform(transform.GetOrientation()) *
-                                  point.orientation);
-
-        double size = static_cast<double>(arrow_size_);
-        if (static_arrow_sizes_)
-        {
-          size *= scale_;
-        }
-        else
-        {
-          size /= 10.0;
-        }
-        double arrow_width = size / 5.0;
-        double head_length = size * 0.75;
-
-        point.transformed_arrow_point =
-            point.transformed_point + orientation * tf::Point(size, 0.0, 0.0);
-        point.transformed_arrow_left =
-            point.transformed_point + orientation * tf::Point(head_length, -arrow_width, 0.0);
-        point.transformed_arrow_right =
-            point.transformed_point + orientation * tf::Point(head_length, arrow_width, 0.0);
-      }
-
-      if (covariance_checked_)
-      {
-        for (uint32_t i = 0; i < point.cov_points.size(); i++)
-        {
-          point.transformed_cov_points[i] = transform * point.cov_points[i];
-        }
+        point.transformed_covariance = transformCovariance(transform, point.covariance);
       }
       point.transformed = true;
       return true;
@@ -442,27 +572,54 @@ namespace mapviz_plugins
     return false;
   }
 
-  void PointDrawingPlugin::Transform()
+  /**
+   * Transforms the points of a history that haven't been yet.
+   * @return true if any of the points are transformed
+   */
+  bool PointDrawingPlugin::TransformHistory(PointHistory& history)
   {
-    bool transformed = false;
+    if (history.AllTransformed())
+    {
+      return !history.Empty();
+    }
 
-    for (auto &pt : points_)
+    bool transformed = false;
+    swri_transform_util::Transform transform;
+    for (size_t i = 0; i < history.Size(); i++)
     {
-      transformed = transformed | TransformPoint(pt);
+      if (history.Transformed(i))
+      {
+        transformed = true;
+        continue;
+      }
+
+      if (GetTransform(frames_.Frame(history.Frame(i)), history.Stamp(i), transform))
+      {
+        const tf::Point point = transform * tf::Point(history.X(i), history.Y(i), history.Z(i));
+        history.SetTransformed(i, point.x(), point.y(), transformYaw(transform, history.Yaw(i)));
+        transformed = true;
+      }
     }
+    return transformed;
+  }
+
+  void PointDrawingPlugin::Transform()
+  {
+    bool transformed = TransformHistory(points_);
 
     transformed = transformed | TransformPoint(cur_point_);
-    if (laps_.size() > 0)
+    for (auto &lap : laps_)
     {
-      for (auto &lap : laps_)
+      // Lap arrows are placed all at once, so a lap point that's transformed
+      // late means placing them again.
+      const size_t count = lap.TransformedCount();
+      transformed = transformed | TransformHistory(lap);
+      if (lap.TransformedCount() != count)
       {
-        for (auto &pt : lap)
-        {
-          transformed = transformed | TransformPoint(pt);
-        }
+        markInstancesDirty();
       }
     }
-    if (!points_.empty() && !transformed)
+    if (!points_.Empty() && !transformed)
     {
       PrintError("No transform between " + cur_point_.source_frame + " and " +
                  target_frame_);
@@ -471,67 +628,41 @@ namespace mapviz_plugins
 
   bool PointDrawingPlugin::DrawLaps()
   {
-    bool transformed = points_.size() != 0;
-    glColor4d(color_.redF(), color_.greenF(), color_.blueF(), 0.5);
-    glLineWidth(3);
+    bool transformed = !points_.Empty();
     QColor base_color = color_;
 
+    // Points can't be joined into a single batch the way separate line
+    // strips can, so only the line style needs one draw call per lap.
+    vertices_.clear();
     for (size_t i = 0; i < laps_.size(); i++)
     {
-      UpdateColor(base_color, static_cast<int>(i));
-      if (draw_style_ == LINES)
-      {
-        glLineWidth(3);
-        glBegin(GL_LINE_STRIP);
-      }
-      else
-      {
-        glPointSize(6);
-        glBegin(GL_POINTS);
-      }
+      const QColor lap_color = UpdateColor(base_color, static_cast<int>(i));
+
+      appendHistory(laps_[i], lap_color);
 
-      for (const auto& pt : laps_[i])
+      if (draw_style_ == LINES)
       {
-        if (pt.transformed)
-        {
-          glVertex2d(pt.transformed_point.getX(),
-                     pt.transformed_point.getY());
-        }
+        renderer_->DrawLineStrip(vertices_, 3);
+        vertices_.clear();
       }
-      glEnd();
     }
 
+    const QColor color(base_color.red(), base_color.green(), base_color.blue(), 127);
+    transformed &= appendHistory(points_, color);
+
     if (draw_style_ == LINES)
     {
-      glLineWidth(3);
-      glBegin(GL_LINE_STRIP);
+      renderer_->DrawLineStrip(vertices_, 3);
     }
     else
     {
-      glPointSize(6);
-      glBegin(GL_POINTS);
+      renderer_->DrawPoints(vertices_, 6);
     }
 
-    glColor4d(base_color.redF(), base_color.greenF(), base_color.blueF(), 0.5);
-
-    if (points_.size() > 0)
-    {
-      for (const auto &pt : points_)
-      {
-        transformed &= pt.transformed;
-        if (pt.transformed)
-        {
-          glVertex2d(pt.transformed_point.getX(),
-                     pt.transformed_point.getY());
-        }
-      }
-    }
-
-    glEnd();
     return transformed;
   }
 
-  void PointDrawingPlugin::UpdateColor(QColor base_color, int i)
+  QColor PointDrawingPlugin::UpdateColor(QColor base_color, int i)
   {
       int hue = static_cast<int>(color_.hue() + (i + 1.0) * 10.0 * M_PI);
       if (hue > 360)
@@ -541,70 +672,166 @@ namespace mapviz_plugins
       int sat = color_.saturation();
       int v = color_.value();
       base_color.setHsv(hue, sat, v);
-      glColor4d(base_color.redF(), base_color.greenF(), base_color.blueF(),
-                0.5);
+      base_color.setAlpha(127);
+      return base_color;
   }
 
-  void PointDrawingPlugin::DrawCovariance()
+  /**
+   * Places a unit circle so that it's deformed into the 3-sigma ellipse of a
+   * covariance.  The circle is stretched by the covariance's Cholesky factor,
+   * which maps it onto the same ellipse as the eigenvectors would, and then
+   * rotated into the target frame.
+   * @return false if the covariance has no extent
+   */
+  bool PointDrawingPlugin::makeEllipse(float x, float y, const cv::Matx22f& covariance,
+                                       float rotation, const QColor& color,
+                                       mapviz::Instance& ellipse)
   {
-    glLineWidth(4);
+    const float xx = covariance(0, 0);
+    if (!(xx > 0.0f))
+    {
+      return false;
+    }
+    const float l00 = 3.0f * std::sqrt(xx);
+    const float l10 = 3.0f * covariance(1, 0) / std::sqrt(xx);
+    const float l11 = 3.0f * std::sqrt(
+        std::max(0.0f, covariance(1, 1) - covariance(1, 0) * covariance(1, 0) / xx));
+
+    const float cos_r = std::cos(rotation);
+    const float sin_r = std::sin(rotation);
+
+    ellipse.x = x;
+    ellipse.y = y;
+    ellipse.x_axis_x = cos_r * l00 - sin_r * l10;
+    ellipse.x_axis_y = sin_r * l00 + cos_r * l10;
+    ellipse.y_axis_x = -sin_r * l11;
+    ellipse.y_axis_y = cos_r * l11;
+    ellipse.r = static_cast<uint8_t>(color.red());
+    ellipse.g = static_cast<uint8_t>(color.green());
+    ellipse.b = static_cast<uint8_t>(color.blue());
+    ellipse.a = static_cast<uint8_t>(color.alpha());
+    return true;
+  }
 
-    glColor4d(color_.redF(), color_.greenF(), color_.blueF(), 1.0);
+  /**
+   * Places an ellipse at a point of points_.  Covariances are kept in the
+   * source frame; the transform turns them by as much as it turns the
+   * heading.
+   * @return false if the point has no covariance to draw
+   */
+  bool PointDrawingPlugin::makeEllipse(size_t i, const QColor& color,
+                                       mapviz::Instance& ellipse) const
+  {
+    return makeEllipse(points_.TransformedX(i),
+                       points_.TransformedY(i),
+                       cv::Matx22f(points_.CovarianceXX(i), points_.CovarianceXY(i),
+                                   points_.CovarianceXY(i), points_.CovarianceYY(i)),
+                       points_.TransformedYaw(i) - points_.Yaw(i),
+                       color,
+                       ellipse);
+  }
 
-    if (cur_point_.transformed && !cur_point_.transformed_cov_points.empty())
+  /**
+   * Places ellipses at the points of points_ that don't have one yet,
+   * splitting them between the batch and unplaced_ the same way as
+   * placeArrows().  Points without a covariance get an invisible glyph in
+   * the batch, so that it still has one glyph per point.
+   */
+  void PointDrawingPlugin::placeEllipses(HistoryInstances& instances, const QColor& color)
+  {
+    mapviz::Instance hidden;
+    hidden.x_axis_x = 0.0f;
+    hidden.y_axis_y = 0.0f;
+    hidden.a = 0;
+
+    std::vector<mapviz::Instance>& ellipses = instances.batch.Append();
+    mapviz::Instance ellipse;
+    size_t i = instances.Placed();
+    for (; i < points_.Size() && points_.Transformed(i); i++)
     {
-      glBegin(GL_LINE_STRIP);
+      if (points_.HasCovariance() && makeEllipse(i, color, ellipse))
+      {
+        ellipses.push_back(ellipse);
+      }
+      else
+      {
+        ellipses.push_back(hidden);
+      }
+    }
 
-      for (uint32_t i = 0; i < cur_point_.transformed_cov_points.size(); i++)
+    for (; i < points_.Size(); i++)
+    {
+      if (points_.Transformed(i) && points_.HasCovariance() && makeEllipse(i, color, ellipse))
       {
-        glVertex2d(cur_point_.transformed_cov_points[i].getX(),
-                   cur_point_.transformed_cov_points[i].getY());
+        unplaced_.push_back(ellipse);
       }
+    }
+  }
 
-      glVertex2d(cur_point_.transformed_cov_points.front().getX(),
-                 cur_point_.transformed_cov_points.front().getY());
+  void PointDrawingPlugin::DrawCovariance()
+  {
+    const QColor color(color_.red(), color_.green(), color_.blue(), 255);
 
-      glEnd();
+    resetInstances(ellipses_);
+    unplaced_.clear();
+    placeEllipses(ellipses_, color);
+
+    mapviz::Instance ellipse;
+    if (cur_point_.transformed && cur_point_.has_covariance &&
+        makeEllipse(cur_point_.transformed_point.getX(),
+                    cur_point_.transformed_point.getY(),
+                    cur_point_.transformed_covariance,
+                    0.0f,
+                    color,
+                    ellipse))
+    {
+      unplaced_.push_back(ellipse);
     }
+
+    glLineWidth(4);
+    renderer_->DrawInstances(mapviz::MESH_CIRCLE, ellipses_.batch, 1.0f, ellipses_.first);
+    renderer_->DrawInstances(mapviz::MESH_CIRCLE, unplaced_);
   }
 
   bool PointDrawingPlugin::DrawLapsArrows()
   {
-    bool success = laps_.size() != 0 && points_.size() != 0;
-    glColor4d(color_.redF(), color_.greenF(), color_.blueF(), 0.5);
-    glLineWidth(2);
+    bool success = laps_.size() != 0 && !points_.Empty() && points_.AllTransformed();
+    for (const PointHistory& lap: laps_)
+    {
+      success &= lap.AllTransformed();
+    }
+
     QColor base_color = color_;
+    QColor color(color_.red(), color_.green(), color_.blue(), 127);
     if (laps_.size() != 0)
     {
-      for (size_t i = 0; i < laps_.size(); i++)
-      {
-        UpdateColor(base_color, static_cast<int>(i));
-        for (const auto &pt : laps_[i])
-        {
-          glBegin(GL_LINE_STRIP);
-          success &= DrawArrow(pt);
-          glEnd();
-        }
-      }
-      glEnd();
-
       int hue = static_cast<int>(color_.hue() + laps_.size() * 10.0 * M_PI);
       int sat = color_.saturation();
       int v = color_.value();
       base_color.setHsv(hue, sat, v);
-      glColor4d(base_color.redF(), base_color.greenF(), base_color.blueF(),
-                0.5);
+      color = QColor(base_color.red(), base_color.green(), base_color.blue(), 127);
     }
 
-    if (points_.size() > 0)
+    if (lap_arrows_generation_ != instance_generation_)
     {
-      for (const auto& pt : points_)
+      std::vector<mapviz::Instance>& arrows = lap_arrows_.Edit();
+      arrows.clear();
+      for (size_t i = 0; i < laps_.size(); i++)
       {
-        glBegin(GL_LINE_STRIP);
-        success &= DrawArrow(pt);
-        glEnd();
+        const QColor lap_color = UpdateColor(color_, static_cast<int>(i));
+        appendArrows(laps_[i], lap_color, arrows);
       }
+      lap_arrows_generation_ = instance_generation_;
     }
+    resetInstances(current_lap_arrows_);
+    unplaced_.clear();
+    placeArrows(current_lap_arrows_, color);
+
+    glLineWidth(2);
+    renderer_->DrawInstances(mapviz::MESH_ARROW, lap_arrows_, arrowLength());
+    renderer_->DrawInstances(mapviz::MESH_ARROW, current_lap_arrows_.batch, arrowLength(),
+                             current_lap_arrows_.first);
+    renderer_->DrawInstances(mapviz::MESH_ARROW, unplaced_, arrowLength());
 
     return success;
   }
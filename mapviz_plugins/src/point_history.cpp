@@ -0,0 +1,327 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <mapviz_plugins/point_history.h>
+
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+
+namespace mapviz_plugins
+{
+  namespace
+  {
+    const size_t INITIAL_CAPACITY = 64;
+
+    /**
+     * Moves the elements of a ring buffer into a larger array, starting at
+     * its beginning.
+     */
+    template <class T>
+    void unwrap(std::vector<T>& values, size_t head, size_t size, size_t capacity)
+    {
+      std::vector<T> grown(capacity);
+      const size_t mask = values.size() - 1;
+      for (size_t i = 0; i < size; i++)
+      {
+        grown[i] = values[(head + i) & mask];
+      }
+      values.swap(grown);
+    }
+  }
+
+  const double PointHistory::LOD_TOLERANCE = 0.01;
+
+  uint16_t FrameTable::Intern(const std::string& frame)
+  {
+    std::unordered_map<std::string, uint16_t>::const_iterator existing = indices_.find(frame);
+    if (existing != indices_.end())
+    {
+      return existing->second;
+    }
+
+    const uint16_t index = static_cast<uint16_t>(frames_.size());
+    frames_.push_back(frame);
+    indices_[frame] = index;
+    return index;
+  }
+
+  PointHistory::PointHistory() :
+    capacity_(0),
+    head_(0),
+    size_(0),
+    transformed_count_(0),
+    first_sequence_(0),
+    levels_(LOD_LEVELS)
+  {
+  }
+
+  void PointHistory::Clear()
+  {
+    // The arrays are kept, since a cleared history usually fills up again.
+    head_ = 0;
+    first_sequence_ += size_;
+    size_ = 0;
+    transformed_count_ = 0;
+    for (Level& level: levels_)
+    {
+      level.points.clear();
+    }
+  }
+
+  void PointHistory::Push(
+      double x,
+      double y,
+      double z,
+      float yaw,
+      const ros::Time& stamp,
+      uint16_t frame)
+  {
+    if (size_ == capacity_)
+    {
+      Grow();
+    }
+
+    const size_t slot = Slot(size_);
+    x_[slot] = x;
+    y_[slot] = y;
+    z_[slot] = static_cast<float>(z);
+    yaw_[slot] = yaw;
+    stamps_[slot] = stamp;
+    frames_[slot] = frame;
+    transformed_[slot] = 0;
+    if (HasCovariance())
+    {
+      covariance_xx_[slot] = 0.0f;
+      covariance_xy_[slot] = 0.0f;
+      covariance_yy_[slot] = 0.0f;
+    }
+
+    // The finest level is every point, so it isn't stored.
+    const uint64_t sequence = first_sequence_ + size_;
+    double tolerance = LOD_TOLERANCE;
+    for (int i = 1; i < LOD_LEVELS; i++)
+    {
+      tolerance *= 2.0;
+      Level& level = levels_[i];
+      if (level.points.empty() ||
+          std::hypot(x - level.last_x, y - level.last_y) >= tolerance)
+      {
+        level.points.push_back(sequence);
+        level.last_x = x;
+        level.last_y = y;
+      }
+    }
+
+    size_++;
+  }
+
+  /**
+   * Updates the transformed count for a point that's about to be dropped.
+   */
+  void PointHistory::Forget(size_t i)
+  {
+    if (transformed_[Slot(i)])
+    {
+      transformed_count_--;
+    }
+  }
+
+  void PointHistory::DropExpiredDetail()
+  {
+    for (Level& level: levels_)
+    {
+      while (!level.points.empty() && level.points.front() < first_sequence_)
+      {
+        level.points.pop_front();
+      }
+    }
+  }
+
+  void PointHistory::PopFront()
+  {
+    if (size_ > 0)
+    {
+      Forget(0);
+      head_ = (head_ + 1) & (capacity_ - 1);
+      first_sequence_++;
+      size_--;
+      DropExpiredDetail();
+    }
+  }
+
+  void PointHistory::PopBack()
+  {
+    if (size_ > 0)
+    {
+      Forget(size_ - 1);
+      size_--;
+      const uint64_t sequence = first_sequence_ + size_;
+      for (Level& level: levels_)
+      {
+        if (!level.points.empty() && level.points.back() == sequence)
+        {
+          level.points.pop_back();
+        }
+      }
+    }
+  }
+
+  void PointHistory::Trim(size_t size)
+  {
+    if (size_ > size)
+    {
+      const size_t dropped = size_ - size;
+      for (size_t i = 0; i < dropped; i++)
+      {
+        Forget(i);
+      }
+      head_ = (head_ + dropped) & (capacity_ - 1);
+      first_sequence_ += dropped;
+      size_ = size;
+      DropExpiredDetail();
+    }
+  }
+
+  void PointHistory::SetCovariance(size_t i, float xx, float xy, float yy)
+  {
+    if (!HasCovariance())
+    {
+      covariance_xx_.assign(capacity_, 0.0f);
+      covariance_xy_.assign(capacity_, 0.0f);
+      covariance_yy_.assign(capacity_, 0.0f);
+    }
+
+    const size_t slot = Slot(i);
+    covariance_xx_[slot] = xx;
+    covariance_xy_[slot] = xy;
+    covariance_yy_[slot] = yy;
+  }
+
+  void PointHistory::SetTransformed(size_t i, float x, float y, float yaw)
+  {
+    const size_t slot = Slot(i);
+    if (!transformed_[slot])
+    {
+      transformed_count_++;
+    }
+    transformed_x_[slot] = x;
+    transformed_y_[slot] = y;
+    transformed_yaw_[slot] = yaw;
+    transformed_[slot] = 1;
+  }
+
+  void PointHistory::ResetTransformed()
+  {
+    std::fill(transformed_.begin(), transformed_.end(), 0);
+    transformed_count_ = 0;
+  }
+
+  void PointHistory::Simplify(double tolerance, std::vector<size_t>& indices) const
+  {
+    indices.clear();
+    if (size_ == 0)
+    {
+      return;
+    }
+
+    // The coarsest level that's still within tolerance
+    int selected = 0;
+    double level_tolerance = LOD_TOLERANCE;
+    for (int i = 1; i < LOD_LEVELS && level_tolerance * 2.0 <= tolerance; i++)
+    {
+      level_tolerance *= 2.0;
+      selected = i;
+    }
+
+    if (selected == 0)
+    {
+      indices.reserve(size_);
+      for (size_t i = 0; i < size_; i++)
+      {
+        indices.push_back(i);
+      }
+      return;
+    }
+
+    const std::deque<uint64_t>& points = levels_[selected].points;
+    indices.reserve(points.size() + 2);
+    if (points.empty() || points.front() != first_sequence_)
+    {
+      indices.push_back(0);
+    }
+    for (size_t i = 0; i < points.size(); i++)
+    {
+      indices.push_back(static_cast<size_t>(points[i] - first_sequence_));
+    }
+    if (indices.back() != size_ - 1)
+    {
+      indices.push_back(size_ - 1);
+    }
+  }
+
+  void PointHistory::Grow()
+  {
+    const size_t capacity = std::max(INITIAL_CAPACITY, capacity_ * 2);
+    if (capacity_ == 0)
+    {
+      x_.resize(capacity);
+      y_.resize(capacity);
+      z_.resize(capacity);
+      yaw_.resize(capacity);
+      stamps_.resize(capacity);
+      frames_.resize(capacity);
+      transformed_x_.resize(capacity);
+      transformed_y_.resize(capacity);
+      transformed_yaw_.resize(capacity);
+      transformed_.resize(capacity);
+    }
+    else
+    {
+      unwrap(x_, head_, size_, capacity);
+      unwrap(y_, head_, size_, capacity);
+      unwrap(z_, head_, size_, capacity);
+      unwrap(yaw_, head_, size_, capacity);
+      unwrap(stamps_, head_, size_, capacity);
+      unwrap(frames_, head_, size_, capacity);
+      unwrap(transformed_x_, head_, size_, capacity);
+      unwrap(transformed_y_, head_, size_, capacity);
+      unwrap(transformed_yaw_, head_, size_, capacity);
+      unwrap(transformed_, head_, size_, capacity);
+      if (HasCovariance())
+      {
+        unwrap(covariance_xx_, head_, size_, capacity);
+        unwrap(covariance_xy_, head_, size_, capacity);
+        unwrap(covariance_yy_, head_, size_, capacity);
+      }
+    }
+    capacity_ = capacity;
+    head_ = 0;
+  }
+}
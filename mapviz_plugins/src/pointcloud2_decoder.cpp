@@ -0,0 +1,334 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <mapviz_plugins/pointcloud2_decoder.h>
+
+// C++ standard libraries
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+// ROS libraries
+#include <ros/console.h>
+
+namespace mapviz_plugins
+{
+  namespace
+  {
+    template <typename T>
+    inline float Read(const uint8_t* ptr)
+    {
+      // memcpy instead of a cast, since fields don't have to be aligned
+      T value;
+      std::memcpy(&value, ptr, sizeof(T));
+      return static_cast<float>(value);
+    }
+
+    /**
+     * x, y and z are consecutive float32s, so each point is a single 12 byte
+     * copy.  Step is the point step if it's known at compile time, 0 if not.
+     */
+    template <uint32_t Step>
+    void DecodePackedXyz(const uint8_t* data, size_t count, uint32_t step,
+        const uint32_t* offsets, float* xyz)
+    {
+      const uint32_t stride = Step ? Step : step;
+      const uint8_t* ptr = data + offsets[0];
+      for (size_t i = 0; i < count; i++, ptr += stride, xyz += 3)
+      {
+        std::memcpy(xyz, ptr, 3 * sizeof(float));
+      }
+    }
+
+    template <uint32_t Step>
+    void DecodeXyz(const uint8_t* data, size_t count, uint32_t step,
+        const uint32_t* offsets, float* xyz)
+    {
+      const uint32_t stride = Step ? Step : step;
+      const uint32_t xoff = offsets[0];
+      const uint32_t yoff = offsets[1];
+      const uint32_t zoff = offsets[2];
+      for (size_t i = 0; i < count; i++, data += stride, xyz += 3)
+      {
+        xyz[0] = Read<float>(data + xoff);
+        xyz[1] = Read<float>(data + yoff);
+        xyz[2] = Read<float>(data + zoff);
+      }
+    }
+
+    template <typename T, uint32_t Step>
+    void DecodeValues(const uint8_t* data, size_t count, uint32_t step,
+        uint32_t offset, float* values)
+    {
+      const uint32_t stride = Step ? Step : step;
+      const uint8_t* ptr = data + offset;
+      for (size_t i = 0; i < count; i++, ptr += stride)
+      {
+        values[i] = Read<T>(ptr);
+      }
+    }
+
+    void DecodeZeros(const uint8_t*, size_t count, uint32_t, uint32_t, float* values)
+    {
+      std::fill(values, values + count, 0.0f);
+    }
+
+    template <uint32_t Step>
+    struct PackedXyzDecoder
+    {
+      static void Decode(const uint8_t* data, size_t count, uint32_t step,
+          const uint32_t* offsets, float* xyz)
+      {
+        DecodePackedXyz<Step>(data, count, step, offsets, xyz);
+      }
+    };
+
+    template <uint32_t Step>
+    struct XyzDecoder
+    {
+      static void Decode(const uint8_t* data, size_t count, uint32_t step,
+          const uint32_t* offsets, float* xyz)
+      {
+        DecodeXyz<Step>(data, count, step, offsets, xyz);
+      }
+    };
+
+    template <typename T>
+    struct ValueDecoder
+    {
+      template <uint32_t Step>
+      struct WithStep
+      {
+        static void Decode(const uint8_t* data, size_t count, uint32_t step,
+            uint32_t offset, float* values)
+        {
+          DecodeValues<T, Step>(data, count, step, offset, values);
+        }
+      };
+    };
+
+    /**
+     * Specializes a kernel on the point steps of common layouts: x, y, z
+     * padded to 16 bytes (PointXYZ, or xyz with rgb/intensity in the
+     * padding), PCL's padded PointXYZI and PointXYZRGB, and Ouster's 48 byte
+     * points.  Anything else uses the step at runtime.
+     */
+    template <template <uint32_t> class Kernel, typename F>
+    F SelectStep(uint32_t step)
+    {
+      switch (step)
+      {
+        case 16:
+          return &Kernel<16>::Decode;
+        case 32:
+          return &Kernel<32>::Decode;
+        case 48:
+          return &Kernel<48>::Decode;
+        default:
+          return &Kernel<0>::Decode;
+      }
+    }
+
+    template <typename T, typename F>
+    F SelectValueKernel(uint32_t step)
+    {
+      return SelectStep<ValueDecoder<T>::template WithStep, F>(step);
+    }
+  }
+
+  PointCloud2Decoder::PointCloud2Decoder() :
+    configured_(false),
+    point_step_(0),
+    value_offset_(0),
+    value_datatype_(0),
+    packed_xyz_(false),
+    xyz_kernel_(NULL),
+    value_kernel_(NULL)
+  {
+    xyz_offsets_[0] = 0;
+    xyz_offsets_[1] = 0;
+    xyz_offsets_[2] = 0;
+  }
+
+  bool PointCloud2Decoder::Configure(const sensor_msgs::PointCloud2& cloud,
+      const std::string& value_field)
+  {
+    if (configured_ &&
+        cloud.point_step == point_step_ &&
+        cloud.fields == fields_ &&
+        value_field == value_field_)
+    {
+      return true;
+    }
+
+    configured_ = false;
+    error_.clear();
+    fields_ = cloud.fields;
+    point_step_ = cloud.point_step;
+    value_field_ = value_field;
+
+    const char* xyz_names[3] = { "x", "y", "z" };
+    for (int axis = 0; axis < 3; axis++)
+    {
+      bool found = false;
+      for (const sensor_msgs::PointField& field: cloud.fields)
+      {
+        if (field.name == xyz_names[axis])
+        {
+          if (field.datatype != sensor_msgs::PointField::FLOAT32)
+          {
+            std::ostringstream error;
+            error << "Unsupported data type for field " << field.name << ": " <<
+                static_cast<int>(field.datatype) << " (x, y and z must be float32)";
+            error_ = error.str();
+            return false;
+          }
+          xyz_offsets_[axis] = field.offset;
+          found = true;
+          break;
+        }
+      }
+      if (!found)
+      {
+        error_ = std::string("Cloud has no ") + xyz_names[axis] + " field";
+        return false;
+      }
+    }
+
+    packed_xyz_ = xyz_offsets_[1] == xyz_offsets_[0] + 4 &&
+                  xyz_offsets_[2] == xyz_offsets_[0] + 8;
+    if (packed_xyz_)
+    {
+      xyz_kernel_ = SelectStep<PackedXyzDecoder, XyzKernel>(point_step_);
+    }
+    else
+    {
+      xyz_kernel_ = SelectStep<XyzDecoder, XyzKernel>(point_step_);
+    }
+
+    value_kernel_ = &DecodeZeros;
+    value_datatype_ = 0;
+    value_offset_ = 0;
+    for (const sensor_msgs::PointField& field: cloud.fields)
+    {
+      if (value_field.empty() || field.name != value_field)
+      {
+        continue;
+      }
+
+      value_datatype_ = field.datatype;
+      value_offset_ = field.offset;
+      switch (field.datatype)
+      {
+        case sensor_msgs::PointField::INT8:
+          value_kernel_ = SelectValueKernel<int8_t, ValueKernel>(point_step_);
+          break;
+        case sensor_msgs::PointField::UINT8:
+          value_kernel_ = SelectValueKernel<uint8_t, ValueKernel>(point_step_);
+          break;
+        case sensor_msgs::PointField::INT16:
+          value_kernel_ = SelectValueKernel<int16_t, ValueKernel>(point_step_);
+          break;
+        case sensor_msgs::PointField::UINT16:
+          value_kernel_ = SelectValueKernel<uint16_t, ValueKernel>(point_step_);
+          break;
+        case sensor_msgs::PointField::INT32:
+          value_kernel_ = SelectValueKernel<int32_t, ValueKernel>(point_step_);
+          break;
+        case sensor_msgs::PointField::UINT32:
+          value_kernel_ = SelectValueKernel<uint32_t, ValueKernel>(point_step_);
+          break;
+        case sensor_msgs::PointField::FLOAT32:
+          value_kernel_ = SelectValueKernel<float, ValueKernel>(point_step_);
+          break;
+        case sensor_msgs::PointField::FLOAT64:
+          value_kernel_ = SelectValueKernel<double, ValueKernel>(point_step_);
+          break;
+        default:
+          ROS_WARN("Unknown data type in point: %d", field.datatype);
+          break;
+      }
+      break;
+    }
+
+    configured_ = true;
+    ROS_DEBUG("Decoding point clouds with %s", LayoutName().c_str());
+    return true;
+  }
+
+  size_t PointCloud2Decoder::PointCount(const sensor_msgs::PointCloud2& cloud)
+  {
+    if (cloud.point_step == 0)
+    {
+      return 0;
+    }
+    return cloud.data.size() / cloud.point_step;
+  }
+
+  void PointCloud2Decoder::Decode(const sensor_msgs::PointCloud2& cloud,
+      size_t begin, size_t end, float* xyz, float* values) const
+  {
+    if (!configured_ || end <= begin)
+    {
+      return;
+    }
+
+    const uint8_t* data = &cloud.data[begin * point_step_];
+    xyz_kernel_(data, end - begin, point_step_, xyz_offsets_, xyz);
+    if (values != NULL)
+    {
+      value_kernel_(data, end - begin, point_step_, value_offset_, values);
+    }
+  }
+
+  void PointCloud2Decoder::Decode(const sensor_msgs::PointCloud2& cloud,
+      std::vector<float>& xyz, std::vector<float>& values) const
+  {
+    const size_t count = PointCount(cloud);
+    xyz.resize(count * 3);
+    values.resize(count);
+    Decode(cloud, 0, count, xyz.data(), values.data());
+  }
+
+  std::string PointCloud2Decoder::LayoutName() const
+  {
+    std::stringstream name;
+    name << (packed_xyz_ ? "packed xyz" : "strided xyz")
+         << ", point step " << point_step_;
+    if (point_step_ != 16 && point_step_ != 32 && point_step_ != 48)
+    {
+      name << " (generic)";
+    }
+    if (value_datatype_ != 0)
+    {
+      name << ", values from " << value_field_ << " (type " << static_cast<int>(value_datatype_) << ")";
+    }
+    return name.str();
+  }
+}
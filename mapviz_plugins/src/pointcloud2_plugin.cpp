@@ -34,6 +34,7 @@
 #include <cmath>
 #include <cstdio>
 #include <algorithm>
+#include <limits>
 #include <vector>
 #include <map>
 
@@ -44,6 +45,8 @@
 #include <QColorDialog>
 #include <QDialog>
 #include <QGLWidget>
+#include <QRunnable>
+#include <QThread>
 
 // QT Autogenerated
 #include "ui_topic_select.h"
@@ -53,6 +56,7 @@
 #include <swri_transform_util/transform.h>
 #include <swri_yaml_util/yaml_util.h>
 
+#include <mapviz/renderer.h>
 #include <mapviz/select_topic_dialog.h>
 
 // Declare plugin
@@ -62,6 +66,45 @@ PLUGINLIB_EXPORT_CLASS(mapviz_plugins::PointCloud2Plugin, mapviz::MapvizPlugin)
 
 namespace mapviz_plugins
 {
+  namespace
+  {
+    /**
+     * Decodes a range of a cloud's points into slices of the columns on
+     * the decoding thread pool.
+     */
+    class DecodeChunk : public QRunnable
+    {
+    public:
+      DecodeChunk(const PointCloud2Decoder& decoder,
+                  const sensor_msgs::PointCloud2& cloud,
+                  size_t begin,
+                  size_t end,
+                  float* xyz,
+                  float* values) :
+        decoder_(decoder),
+        cloud_(cloud),
+        begin_(begin),
+        end_(end),
+        xyz_(xyz),
+        values_(values)
+      {
+      }
+
+      void run()
+      {
+        decoder_.Decode(cloud_, begin_, end_, xyz_, values_);
+      }
+
+    private:
+      const PointCloud2Decoder& decoder_;
+      const sensor_msgs::PointCloud2& cloud_;
+      size_t begin_;
+      size_t end_;
+      float* xyz_;
+      float* values_;
+    };
+  }
+
   PointCloud2Plugin::PointCloud2Plugin() :
       config_widget_(new QWidget()),
       topic_(""),
@@ -74,7 +117,14 @@ namespace mapviz_plugins
       has_message_(false),
       num_of_feats_(0),
       need_new_list_(true),
-      need_minmax_(false)
+      need_minmax_(false),
+      color_version_(0),
+      vram_bytes_(0),
+      reported_tiles_(std::numeric_limits<size_t>::max()),
+      reported_vram_bytes_(std::numeric_limits<size_t>::max()),
+      parallel_decode_threshold_(500000),
+      decode_threads_(0),
+      decode_failed_(false)
   {
     ui_.setupUi(config_widget_);
 
@@ -150,6 +200,18 @@ namespace mapviz_plugins
                      SIGNAL(stateChanged(int)),
                      this,
                      SLOT(UseAutomaxminChanged(int)));
+    QObject::connect(ui_.accumulate,
+                     SIGNAL(currentIndexChanged(int)),
+                     this,
+                     SLOT(AccumulateChanged(int)));
+    QObject::connect(ui_.cellSize,
+                     SIGNAL(valueChanged(double)),
+                     this,
+                     SLOT(CellSizeChanged(double)));
+    QObject::connect(ui_.decayTime,
+                     SIGNAL(valueChanged(int)),
+                     this,
+                     SLOT(DecayTimeChanged(int)));
     QObject::connect(ui_.max_color,
                      SIGNAL(colorEdited(const QColor &)),
                      this,
@@ -167,6 +229,14 @@ namespace mapviz_plugins
                      this,
                      SLOT(SetSubscription(bool)));
 
+    decode_pool_.setMaxThreadCount(QThread::idealThreadCount());
+
+    accumulator_.SetResolution(ui_.cellSize->value());
+    ui_.cellSize->setEnabled(false);
+    ui_.decayTime->setEnabled(false);
+
+    UpdateColormap();
+
     PrintInfo("Constructed PointCloud2Plugin");
   }
 
@@ -174,9 +244,29 @@ namespace mapviz_plugins
   {
   }
 
+  void PointCloud2Plugin::Shutdown()
+  {
+    // Every scan's buffers go back to the pool, and then the whole pool is
+    // deleted rather than trimmed to the ring size.
+    ReleaseAllBuffers();
+    for (ScanBuffers& buffers: free_buffers_)
+    {
+      glDeleteBuffers(1, &buffers.point_vbo);
+      glDeleteBuffers(1, &buffers.value_vbo);
+      glDeleteBuffers(1, &buffers.color_vbo);
+    }
+    free_buffers_.clear();
+    vram_bytes_ = 0;
+
+    accumulator_.Destroy();
+    colormap_.Destroy();
+  }
+
   void PointCloud2Plugin::ClearHistory()
   {
-    scans_.clear();
+    incoming_scans_.Clear();
+    ReleaseAllBuffers();
+    accumulator_.Clear();
   }
 
   void PointCloud2Plugin::DrawIcon()
@@ -215,19 +305,23 @@ namespace mapviz_plugins
 
   void PointCloud2Plugin::ResetTransformedPointClouds()
   {
-    QMutexLocker locker(&scan_mutex_);
-    for (Scan& scan: scans_)
     {
-      scan.transformed = false;
-      scan.gl_color.clear();
-      scan.gl_point.clear();
+      QMutexLocker locker(&scan_mutex_);
+      for (Scan& scan: scans_)
+      {
+        scan.transformed = false;
+      }
     }
+    // The grid is in the old target frame
+    accumulator_.Clear();
   }
 
   void PointCloud2Plugin::ClearPointClouds()
   {
-      QMutexLocker locker(&scan_mutex_);
-      scans_.clear();
+      incoming_scans_.Clear();
+      ReleaseAllBuffers();
+      accumulator_.Clear();
+      Q_EMIT Dirty();
   }
 
   void PointCloud2Plugin::SetSubscription(bool subscribe)
@@ -244,101 +338,161 @@ namespace mapviz_plugins
     }
   }
 
-  QColor PointCloud2Plugin::CalculateColor(const StampedPoint& point)
+  std::string PointCloud2Plugin::SelectedField() const
   {
-    float val;
-    unsigned int color_transformer = static_cast<unsigned int>(ui_.color_transformer->currentIndex());
-    unsigned int transformer_index = color_transformer -1;
-    if (num_of_feats_ > 0 && color_transformer > 0)
+    if (ui_.color_transformer->currentIndex() == COLOR_FLAT)
     {
-      val = point.features[transformer_index];
-      if (need_minmax_)
-      {
-        if (val > max_[transformer_index])
-        {
-          max_[transformer_index] = val;
-        }
-
-        if (val < min_[transformer_index])
-        {
-          min_[transformer_index] = val;
-        }
-      }
+      return "";
     }
-    else  // No intensity or  (color_transformer == COLOR_FLAT)
+    return ui_.color_transformer->currentText().toStdString();
+  }
+
+  void PointCloud2Plugin::UpdateMinMax(const Scan& scan)
+  {
+    unsigned int transformer_index = static_cast<unsigned int>(ui_.color_transformer->currentIndex()) - 1;
+    if (transformer_index >= max_.size() || scan.values.empty())
     {
-      return ui_.min_color->color();
+      return;
     }
 
-    if (ui_.unpack_rgb->isChecked())
+    const std::pair<std::vector<float>::const_iterator, std::vector<float>::const_iterator> range =
+        std::minmax_element(scan.values.begin(), scan.values.end());
+    max_[transformer_index] = std::max(max_[transformer_index], static_cast<double>(*range.second));
+    min_[transformer_index] = std::min(min_[transformer_index], static_cast<double>(*range.first));
+  }
+
+  /**
+   * Decodes the newest scan's values again with field, so that a cloud
+   * that isn't published again, like a latched map, follows the selected
+   * field.  Older scans aren't drawn until they leave the buffer.  A flat
+   * color doesn't use the values, so they're left as they are.
+   */
+  void PointCloud2Plugin::RedecodeNewestScan(const std::string& field)
+  {
+    QMutexLocker locker(&scan_mutex_);
+    if (field.empty() || scans_.empty() || !scans_.back().cloud ||
+        scans_.back().value_field == field)
     {
-        uint8_t* pixelColor = reinterpret_cast<uint8_t*>(&val);
-        return QColor(pixelColor[2], pixelColor[1], pixelColor[0], 255);
+      return;
     }
 
-    if (max_value_ > min_value_)
+    Scan& scan = scans_.back();
+    PointCloud2Decoder decoder;
+    if (!decoder.Configure(*scan.cloud, field))
     {
-      val = (val - min_value_) / (max_value_ - min_value_);
+      PrintError(decoder.Error());
+      return;
     }
-    val = std::max(0.0f, std::min(val, 1.0f));
-
-    if (ui_.use_automaxmin->isChecked())
+    // The coordinates may already have been uploaded and released, so
+    // they're decoded into scratch space and thrown away.
+    std::vector<float> xyz(scan.point_count * 3);
+    decoder.Decode(*scan.cloud, 0, scan.point_count, xyz.data(), scan.values.data());
+    scan.value_field = field;
+    scan.values_uploaded = false;
+    scan.colors_version = color_version_ - 1;
+
+    if (need_minmax_)
     {
-      max_value_ = max_[transformer_index];
-      min_value_ = min_[transformer_index];
+      UpdateMinMax(scan);
     }
+  }
 
-    if (ui_.use_rainbow->isChecked())
-    {  // Hue Interpolation
+  /**
+   * Colors a scan on the CPU.  This is only needed when shaders aren't
+   * available or when the values are packed RGB, which GLSL 1.20 has no way
+   * of unpacking.
+   */
+  void PointCloud2Plugin::UpdateCpuColors(Scan& scan)
+  {
+    const bool unpack_rgb = ui_.unpack_rgb->isChecked() &&
+        ui_.color_transformer->currentIndex() != COLOR_FLAT;
+    const uint8_t alpha = static_cast<uint8_t>(alpha_ * 255.0);
 
-      int hue = (int)(val * 255.0);
-      return QColor::fromHsl(hue, 255, 127, 255);
+    scan.gl_color.resize(scan.values.size() * 4);
+    for (size_t i = 0; i < scan.values.size(); i++)
+    {
+      uint8_t* color = &scan.gl_color[i * 4];
+      if (unpack_rgb)
+      {
+        const uint8_t* pixelColor = reinterpret_cast<const uint8_t*>(&scan.values[i]);
+        color[0] = pixelColor[2];
+        color[1] = pixelColor[1];
+        color[2] = pixelColor[0];
+      }
+      else
+      {
+        colormap_.Lookup(scan.values[i], color);
+      }
+      color[3] = alpha;
     }
-    else
+    scan.colors_uploaded = false;
+    scan.colors_version = color_version_;
+  }
+
+  bool PointCloud2Plugin::Accumulating() const
+  {
+    return ui_.accumulate->currentIndex() > 0;
+  }
+
+  /**
+   * Max Z and hit count don't come from the color transformer, so they're
+   * never drawn in a flat color.
+   */
+  bool PointCloud2Plugin::ColorIsFlat() const
+  {
+    if (Accumulating() &&
+        (accumulator_.GetStatistic() == PointCloudAccumulator::MAX_Z ||
+         accumulator_.GetStatistic() == PointCloudAccumulator::HIT_COUNT))
     {
-      const QColor min_color = ui_.min_color->color();
-      const QColor max_color = ui_.max_color->color();
-      // RGB Interpolation
-      int red, green, blue;
-      red = (int)(val * max_color.red() + ((1.0 - val) * min_color.red()));
-      green = (int)(val * max_color.green() + ((1.0 - val) * min_color.green()));
-      blue = (int)(val * max_color.blue() + ((1.0 - val) * min_color.blue()));
-      return QColor(red, green, blue, 255);
+      return false;
     }
+    return ui_.color_transformer->currentIndex() == COLOR_FLAT;
   }
 
-  inline int32_t findChannelIndex(const sensor_msgs::PointCloud2ConstPtr& cloud, const std::string& channel)
+  void PointCloud2Plugin::UpdateColormap()
   {
-    for (int32_t i = 0; static_cast<size_t>(i) < cloud->fields.size(); ++i)
+    if (ColorIsFlat())
+    {
+      colormap_.SetGradient(ui_.min_color->color(), ui_.min_color->color());
+    }
+    else if (ui_.use_rainbow->isChecked())
+    {
+      colormap_.SetRainbow();
+    }
+    else
+    {
+      colormap_.SetGradient(ui_.min_color->color(), ui_.max_color->color());
+    }
+
+    unsigned int transformer_index = static_cast<unsigned int>(ui_.color_transformer->currentIndex()) - 1;
+    if (ui_.use_automaxmin->isChecked() && Accumulating())
     {
-      if (cloud->fields[i].name == channel)
+      float min;
+      float max;
+      if (accumulator_.Range(min, max))
       {
-        return i;
+        min_value_ = min;
+        max_value_ = max;
       }
     }
+    else if (ui_.use_automaxmin->isChecked() && transformer_index < max_.size())
+    {
+      max_value_ = max_[transformer_index];
+      min_value_ = min_[transformer_index];
+    }
+    colormap_.SetRange(min_value_, max_value_);
 
-    return -1;
+    color_version_++;
   }
 
+  /**
+   * Only the colormap changes here; the points and their values stay where
+   * they are on the GPU.
+   */
   void PointCloud2Plugin::UpdateColors()
   {
-    {
-      QMutexLocker locker(&scan_mutex_);
-      for (Scan& scan: scans_)
-      {
-        scan.gl_color.clear();
-        scan.gl_color.reserve(scan.points.size()*4);
-        for (const StampedPoint& point: scan.points)
-        {
-          const QColor color = CalculateColor(point);
-          scan.gl_color.push_back( color.red());
-          scan.gl_color.push_back( color.green());
-          scan.gl_color.push_back( color.blue());
-          scan.gl_color.push_back( static_cast<uint8_t>(alpha_ * 255.0 ) );
-        }
-      }
-    }
-    canvas_->update();
+    UpdateColormap();
+    Q_EMIT Dirty();
   }
 
   void PointCloud2Plugin::SelectTopic()
@@ -360,10 +514,9 @@ namespace mapviz_plugins
     if (topic != topic_)
     {
       initialized_ = false;
-      {
-        QMutexLocker locker(&scan_mutex_);
-        scans_.clear();
-      }
+      incoming_scans_.Clear();
+      ReleaseAllBuffers();
+      accumulator_.Clear();
       has_message_ = false;
       PrintWarning("No messages received.");
 
@@ -393,18 +546,19 @@ namespace mapviz_plugins
       QMutexLocker locker(&scan_mutex_);
       while (scans_.size() > buffer_size_)
       {
+        ReleaseBuffers(scans_.front());
         scans_.pop_front();
       }
     }
 
-    canvas_->update();
+    Q_EMIT Dirty();
   }
 
   void PointCloud2Plugin::PointSizeChanged(int value)
   {
     point_size_ = (size_t)value;
 
-    canvas_->update();
+    Q_EMIT Dirty();
   }
 
   void PointCloud2Plugin::PointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr& msg)
@@ -420,184 +574,269 @@ namespace mapviz_plugins
     // messages with different source frames, so we need to store and transform
     // them individually.
 
+    // This runs on the plugin's callback thread, so only decode the cloud
+    // here.  Anything that depends on the GUI settings, the target frame or
+    // the GL context is done when the scan is admitted in Transform().
     Scan scan;
-    {
-        // recycle already allocated memory, reusing an old scan
-      QMutexLocker locker(&scan_mutex_);
-      if (buffer_size_ > 0 )
-      {
-          if( scans_.size() >= buffer_size_)
-          {
-              scan = std::move( scans_.front() );
-          }
-          else{
-             glGenBuffers(1, &scan.color_vbo);
-             glGenBuffers(1, &scan.point_vbo);
-          }
-          while (scans_.size() >= buffer_size_)
-          {
-            scans_.pop_front();
-          }
-      }
-    }
-
     scan.stamp = msg->header.stamp;
     scan.color = QColor::fromRgbF(1.0f, 0.0f, 0.0f, 1.0f);
     scan.source_frame = msg->header.frame_id;
-    scan.transformed = true;
+    scan.transformed = false;
+    scan.point_count = 0;
 
-    swri_transform_util::Transform transform;
-    if (!GetTransform(scan.source_frame, msg->header.stamp, transform))
+    for (size_t i = 0; i < msg->fields.size(); ++i)
     {
-      scan.transformed = false;
-      PrintError("No transform between " + scan.source_frame + " and " + target_frame_);
+      FieldInfo input;
+      std::string name = msg->fields[i].name;
+
+      uint32_t offset_value = msg->fields[i].offset;
+      uint8_t datatype_value = msg->fields[i].datatype;
+      input.offset = offset_value;
+      input.datatype = datatype_value;
+      scan.new_features.insert(std::pair<std::string, FieldInfo>(name, input));
     }
 
-    int32_t xi = findChannelIndex(msg, "x");
-    int32_t yi = findChannelIndex(msg, "y");
-    int32_t zi = findChannelIndex(msg, "z");
-
-    if (xi == -1 || yi == -1 || zi == -1)
+    // Only the coordinates and the field that's being colored by are
+    // decoded.  The message is kept until a newer one arrives, so that
+    // selecting a different field can recolor it.
+    size_t parallel_decode_threshold;
     {
+      QMutexLocker locker(&decode_mutex_);
+      scan.value_field = value_field_;
+      parallel_decode_threshold = parallel_decode_threshold_;
+    }
+    if (!decoder_.Configure(*msg, scan.value_field))
+    {
+      PrintError(decoder_.Error());
+      QMutexLocker locker(&decode_mutex_);
+      decode_failed_ = true;
       return;
     }
 
-    if (new_topic_)
+    scan.point_count = PointCloud2Decoder::PointCount(*msg);
+    scan.gl_point.resize(scan.point_count * 3);
+    scan.values.resize(scan.point_count);
+
+    const size_t threads = static_cast<size_t>(std::max(decode_pool_.maxThreadCount(), 1));
+    if (threads > 1 && parallel_decode_threshold > 0 &&
+        scan.point_count >= parallel_decode_threshold)
     {
-      for (size_t i = 0; i < msg->fields.size(); ++i)
+      // Large clouds are split into a chunk per thread, each of which
+      // decodes straight into its own slice of the columns.
+      const size_t chunk_size = (scan.point_count + threads - 1) / threads;
+      for (size_t begin = 0; begin < scan.point_count; begin += chunk_size)
       {
-        FieldInfo input;
-        std::string name = msg->fields[i].name;
-
-        uint32_t offset_value = msg->fields[i].offset;
-        uint8_t datatype_value = msg->fields[i].datatype;
-        input.offset = offset_value;
-        input.datatype = datatype_value;
-        scan.new_features.insert(std::pair<std::string, FieldInfo>(name, input));
+        const size_t end = std::min(begin + chunk_size, scan.point_count);
+        decode_pool_.start(new DecodeChunk(decoder_, *msg, begin, end,
+            &scan.gl_point[begin * 3], &scan.values[begin]));
       }
+      decode_pool_.waitForDone();
+    }
+    else
+    {
+      decoder_.Decode(*msg, 0, scan.point_count, scan.gl_point.data(), scan.values.data());
+    }
+
+    scan.cloud = msg;
+    incoming_scans_.Post(std::move(scan));
+    Q_EMIT Dirty();
+  }
+
+  void PointCloud2Plugin::UpdateFeatureList(const std::map<std::string, FieldInfo>& features)
+  {
+    if (!new_topic_)
+    {
+      return;
+    }
 
-      new_topic_ = false;
-      num_of_feats_ = scan.new_features.size();
+    new_topic_ = false;
+    num_of_feats_ = features.size();
 
-      max_.resize(num_of_feats_);
-      min_.resize(num_of_feats_);
+    max_.resize(num_of_feats_);
+    min_.resize(num_of_feats_);
 
-      int label = 1;
-      if (need_new_list_)
+    int label = 1;
+    if (need_new_list_)
+    {
+      int new_feature_index = ui_.color_transformer->currentIndex();
+      std::map<std::string, FieldInfo>::const_iterator it;
+      for (it = features.begin(); it != features.end(); ++it)
       {
-        int new_feature_index = ui_.color_transformer->currentIndex();
-        std::map<std::string, FieldInfo>::const_iterator it;
-        for (it = scan.new_features.begin(); it != scan.new_features.end(); ++it)
-        {
-          ui_.color_transformer->removeItem(static_cast<int>(num_of_feats_));
-          num_of_feats_--;
-        }
+        ui_.color_transformer->removeItem(static_cast<int>(num_of_feats_));
+        num_of_feats_--;
+      }
 
-        for (it = scan.new_features.begin(); it != scan.new_features.end(); ++it)
+      for (it = features.begin(); it != features.end(); ++it)
+      {
+        std::string const field = it->first;
+        if (field == saved_color_transformer_)
         {
-          std::string const field = it->first;
-          if (field == saved_color_transformer_)
-          {
-            // The very first time we see a new set of features, that means the
-            // plugin was just created; if we have a saved value, set the current
-            // index to that and clear the saved value.
-            new_feature_index = label;
-            saved_color_transformer_ = "";
-          }
+          // The very first time we see a new set of features, that means the
+          // plugin was just created; if we have a saved value, set the current
+          // index to that and clear the saved value.
+          new_feature_index = label;
+          saved_color_transformer_ = "";
+        }
 
-          ui_.color_transformer->addItem(QString::fromStdString(field), QVariant(label));
-          num_of_feats_++;
-          label++;
+        ui_.color_transformer->addItem(QString::fromStdString(field), QVariant(label));
+        num_of_feats_++;
+        label++;
 
-        }
-        ui_.color_transformer->setCurrentIndex(new_feature_index);
-        need_new_list_ = false;
       }
+      ui_.color_transformer->setCurrentIndex(new_feature_index);
+      need_new_list_ = false;
     }
+  }
 
-    if (!msg->data.empty())
+  void PointCloud2Plugin::AdmitIncomingScans()
+  {
+    std::deque<Scan> incoming;
+    if (!incoming_scans_.Take(incoming))
     {
-      const uint8_t* ptr = &msg->data.front();
-      const uint32_t point_step = msg->point_step;
-      const uint32_t xoff = msg->fields[xi].offset;
-      const uint32_t yoff = msg->fields[yi].offset;
-      const uint32_t zoff = msg->fields[zi].offset;
-      const size_t num_points = msg->data.size() / point_step;
-      const size_t num_features = scan.new_features.size();
-      scan.points.resize(num_points);
+      return;
+    }
 
-      std::vector<FieldInfo> field_infos;
-      field_infos.reserve(num_features);
-      for (auto it = scan.new_features.begin(); it != scan.new_features.end(); ++it)
+    {
+      // An error from the callback thread has replaced the status
+      QMutexLocker locker(&decode_mutex_);
+      if (decode_failed_)
       {
-        field_infos.push_back(it->second);
+        decode_failed_ = false;
+        reported_tiles_ = std::numeric_limits<size_t>::max();
+        reported_vram_bytes_ = std::numeric_limits<size_t>::max();
       }
+    }
 
-      scan.gl_point.clear();
-      scan.gl_point.reserve(num_points*2);
-      scan.gl_color.clear();
-      scan.gl_color.reserve(num_points*4);
+    for (Scan& scan: incoming)
+    {
+      UpdateFeatureList(scan.new_features);
 
-      for (size_t i = 0; i < num_points; i++, ptr += point_step)
       {
-        float x = *reinterpret_cast<const float*>(ptr + xoff);
-        float y = *reinterpret_cast<const float*>(ptr + yoff);
-        float z = *reinterpret_cast<const float*>(ptr + zoff);
-
-        StampedPoint& point = scan.points[i];
-        point.point = tf::Point(x, y, z);
-
-        point.features.resize(num_features);
-
-        for (int count=0; count < field_infos.size(); count++)
+        // The buffers of the scans that are evicted go back to the pool to
+        // be reused by the new one.
+        QMutexLocker locker(&scan_mutex_);
+        while (buffer_size_ > 0 && scans_.size() >= buffer_size_)
         {
-          point.features[count] = PointFeature(ptr, field_infos[count]);
+          ReleaseBuffers(scans_.front());
+          scans_.pop_front();
         }
-        if (scan.transformed)
+      }
+      AcquireBuffers(scan);
+
+      // The points are kept in the source frame; Transform() only has to
+      // find the matrix that takes them to the target frame.
+      scan.transformed = false;
+      scan.points_uploaded = false;
+      scan.values_uploaded = false;
+      scan.colors_uploaded = false;
+      scan.colors_version = color_version_ - 1;
+
+      // A cloud decoded just before the field was changed doesn't count
+      // towards the new field's range.
+      if (need_minmax_ && scan.value_field == SelectedField())
+      {
+        UpdateMinMax(scan);
+      }
+
+      {
+        QMutexLocker locker(&scan_mutex_);
+        if (!scans_.empty())
         {
-          const tf::Point transformed_point = transform * point.point;
-          scan.gl_point.push_back( transformed_point.getX() );
-          scan.gl_point.push_back( transformed_point.getY() );
+          scans_.back().cloud.reset();
         }
-        const QColor color = CalculateColor(point);
-        scan.gl_color.push_back( color.red());
-        scan.gl_color.push_back( color.green());
-        scan.gl_color.push_back( color.blue());
-        scan.gl_color.push_back( static_cast<uint8_t>(alpha_ * 255.0 ) );
+        scans_.push_back( std::move(scan) );
       }
+      new_topic_ = true;
+    }
+
+    if (need_minmax_)
+    {
+      // The new values may have widened the automatic range
+      UpdateColormap();
+    }
+
+    TrimBufferPool();
+  }
+
+  void PointCloud2Plugin::AcquireBuffers(Scan& scan)
+  {
+    if (!free_buffers_.empty())
+    {
+      scan.buffers = free_buffers_.back();
+      free_buffers_.pop_back();
+    }
+    else
+    {
+      glGenBuffers(1, &scan.buffers.point_vbo);
+      glGenBuffers(1, &scan.buffers.value_vbo);
+      glGenBuffers(1, &scan.buffers.color_vbo);
+    }
+  }
+
+  /**
+   * Returns a scan's buffers to the pool.  This doesn't need a GL context, so
+   * it's safe to call from any slot; the pool is trimmed the next time
+   * scans are admitted.
+   */
+  void PointCloud2Plugin::ReleaseBuffers(Scan& scan)
+  {
+    if (scan.buffers.point_vbo != 0)
+    {
+      free_buffers_.push_back(scan.buffers);
+      scan.buffers = ScanBuffers();
+    }
+  }
+
+  void PointCloud2Plugin::ReleaseAllBuffers()
+  {
+    QMutexLocker locker(&scan_mutex_);
+    for (Scan& scan: scans_)
+    {
+      ReleaseBuffers(scan);
     }
+    scans_.clear();
+  }
 
+  /**
+   * Deletes pooled buffers beyond what the history can use, so that the
+   * ring never holds more than buffer_size_ scans worth of video memory.
+   */
+  void PointCloud2Plugin::TrimBufferPool()
+  {
+    size_t in_use;
     {
       QMutexLocker locker(&scan_mutex_);
-      scans_.push_back( std::move(scan) );
+      in_use = scans_.size();
+    }
+
+    const size_t ring_size = buffer_size_ > 0 ? buffer_size_ : in_use;
+    while (!free_buffers_.empty() && in_use + free_buffers_.size() > ring_size)
+    {
+      ScanBuffers& buffers = free_buffers_.back();
+      glDeleteBuffers(1, &buffers.point_vbo);
+      glDeleteBuffers(1, &buffers.value_vbo);
+      glDeleteBuffers(1, &buffers.color_vbo);
+      vram_bytes_ -= buffers.point_bytes + buffers.value_bytes + buffers.color_bytes;
+      free_buffers_.pop_back();
     }
-    new_topic_ = true;
-    canvas_->update();
   }
 
-  float PointCloud2Plugin::PointFeature(const uint8_t* data, const FieldInfo& feature_info)
+  /**
+   * Uploads data into buffer, reusing its storage when it's already large
+   * enough so that a recycled buffer isn't reallocated.
+   */
+  void PointCloud2Plugin::Upload(GLuint buffer, size_t& capacity, const void* data, size_t bytes)
   {
-    switch (feature_info.datatype)
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (bytes > capacity)
     {
-      case 1:
-        return *reinterpret_cast<const int8_t*>(data + feature_info.offset);
-      case 2:
-        return *(data + feature_info.offset);
-      case 3:
-        return *reinterpret_cast<const int16_t*>(data + feature_info.offset);
-      case 4:
-        return *reinterpret_cast<const uint16_t*>(data + feature_info.offset);
-      case 5:
-        return *reinterpret_cast<const int32_t*>(data + feature_info.offset);
-      case 6:
-        return *reinterpret_cast<const uint32_t*>(data + feature_info.offset);
-      case 7:
-        return *reinterpret_cast<const float*>(data + feature_info.offset);
-      case 8:
-        return *reinterpret_cast<const double*>(data + feature_info.offset);
-      default:
-        ROS_WARN("Unknown data type in point: %d", feature_info.datatype);
-        return 0.0;
+      glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+      vram_bytes_ += bytes - capacity;
+      capacity = bytes;
+    }
+    else if (bytes > 0)
+    {
+      glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
     }
   }
 
@@ -634,35 +873,106 @@ namespace mapviz_plugins
 
   void PointCloud2Plugin::Draw(double x, double y, double scale)
   {
+    if (Accumulating())
+    {
+      accumulator_.Draw(renderer_, colormap_, alpha_, ui_.unpack_rgb->isChecked());
+      return;
+    }
+
     glPointSize(point_size_);
 
+    // Packed RGB values can't be unpacked by a GLSL 1.20 shader, so those
+    // are still colored on the CPU.
+    const bool unpack_rgb = ui_.unpack_rgb->isChecked() &&
+        ui_.color_transformer->currentIndex() != COLOR_FLAT;
+    const bool use_shader = !unpack_rgb && renderer_->BeginColormap(colormap_, alpha_);
+
     glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_COLOR_ARRAY);
+    if (use_shader)
+    {
+      glEnableVertexAttribArray(mapviz::Renderer::SCALAR_ATTRIBUTE);
+    }
+    else
+    {
+      glEnableClientState(GL_COLOR_ARRAY);
+    }
 
+    // Scans decoded with another field would be colored by the wrong
+    // range, so they're left out until they leave the buffer.
+    const bool color_is_flat = ColorIsFlat();
+    const std::string field = SelectedField();
     {
       QMutexLocker locker(&scan_mutex_);
 
       for (Scan& scan: scans_)
       {
-        if (scan.transformed && !scan.gl_color.empty())
+        if (scan.transformed && scan.point_count > 0 &&
+            (color_is_flat || scan.value_field == field))
         {
-          glBindBuffer(GL_ARRAY_BUFFER, scan.point_vbo);  // coordinates
-          glBufferData(GL_ARRAY_BUFFER, scan.gl_point.size() * sizeof(float), scan.gl_point.data(), GL_STATIC_DRAW);
-          glVertexPointer( 2, GL_FLOAT, 0, 0);
+          // Geometry is uploaded once when the scan arrives and then drawn
+          // from video memory; values only when the color transformer is
+          // changed.
+          ScanBuffers& buffers = scan.buffers;
+          if (!scan.points_uploaded)
+          {
+            Upload(buffers.point_vbo, buffers.point_bytes, scan.gl_point.data(),
+                scan.gl_point.size() * sizeof(float));
+            std::vector<float>().swap(scan.gl_point);
+            scan.points_uploaded = true;
+          }
+          glBindBuffer(GL_ARRAY_BUFFER, buffers.point_vbo);  // coordinates
+          glVertexPointer( 3, GL_FLOAT, 0, 0);
 
-          glBindBuffer(GL_ARRAY_BUFFER, scan.color_vbo);  // color
-          glBufferData(GL_ARRAY_BUFFER, scan.gl_color.size() * sizeof(uint8_t), scan.gl_color.data(), GL_STATIC_DRAW);
-          glColorPointer( 4, GL_UNSIGNED_BYTE, 0, 0);
+          if (use_shader)
+          {
+            if (!scan.values_uploaded)
+            {
+              Upload(buffers.value_vbo, buffers.value_bytes, scan.values.data(),
+                  scan.values.size() * sizeof(float));
+              scan.values_uploaded = true;
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, buffers.value_vbo);  // values
+            glVertexAttribPointer(mapviz::Renderer::SCALAR_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, 0, 0);
+          }
+          else
+          {
+            if (scan.colors_version != color_version_)
+            {
+              UpdateCpuColors(scan);
+            }
+            if (!scan.colors_uploaded)
+            {
+              Upload(buffers.color_vbo, buffers.color_bytes, scan.gl_color.data(),
+                  scan.gl_color.size() * sizeof(uint8_t));
+              scan.colors_uploaded = true;
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, buffers.color_vbo);  // color
+            glColorPointer( 4, GL_UNSIGNED_BYTE, 0, 0);
+          }
 
-          glDrawArrays(GL_POINTS, 0, scan.gl_point.size() / 2 );
+          mapviz::Renderer::PushTransform(scan.transform);
+          glDrawArrays(GL_POINTS, 0, scan.point_count);
+          mapviz::Renderer::PopTransform();
         }
       }
     }
     glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_COLOR_ARRAY);
+    if (use_shader)
+    {
+      glDisableVertexAttribArray(mapviz::Renderer::SCALAR_ATTRIBUTE);
+      renderer_->EndColormap();
+    }
+    else
+    {
+      glDisableClientState(GL_COLOR_ARRAY);
+    }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    PrintInfo("OK");
+    if (vram_bytes_ != reported_vram_bytes_)
+    {
+      reported_vram_bytes_ = vram_bytes_;
+      PrintInfo("OK (" + QString::number(vram_bytes_ / 1048576.0, 'f', 1).toStdString() + " MB in VRAM)");
+    }
   }
 
   void PointCloud2Plugin::UseRainbowChanged(int check_state)
@@ -686,6 +996,8 @@ namespace mapviz_plugins
 
   void PointCloud2Plugin::Transform()
   {
+    AdmitIncomingScans();
+
     {
       QMutexLocker locker(&scan_mutex_);
 
@@ -698,16 +1010,8 @@ namespace mapviz_plugins
           swri_transform_util::Transform transform;
           if (GetTransform(scan.source_frame, scan.stamp, transform))
           {
-            scan.gl_point.clear();
-            scan.gl_point.reserve(scan.points.size()*2);
-
+            scan.transform = transform.GetTF();
             scan.transformed = true;
-            for (StampedPoint& point: scan.points)
-            {
-              const tf::Point transformed_point = transform * point.point;
-              scan.gl_point.push_back( transformed_point.getX() );
-              scan.gl_point.push_back( transformed_point.getY() );
-            }
           }
           else
           {
@@ -718,12 +1022,91 @@ namespace mapviz_plugins
       }
       use_latest_transforms_ = was_using_latest_transforms;
     }
-    // Z color is based on transformed color, so it is dependent on the
-    // transform
-    if (ui_.color_transformer->currentIndex() == COLOR_Z)
+
+    if (Accumulating())
+    {
+      AccumulateScans();
+    }
+  }
+
+  /**
+   * Bins every scan that has been transformed into the grid, after which
+   * the scan itself is no longer needed.
+   */
+  void PointCloud2Plugin::AccumulateScans()
+  {
+    bool added = false;
+    {
+      QMutexLocker locker(&scan_mutex_);
+      std::deque<Scan>::iterator it = scans_.begin();
+      while (it != scans_.end())
+      {
+        if (!it->transformed)
+        {
+          ++it;
+          continue;
+        }
+
+        // The coordinates are gone if the scan was already uploaded to be
+        // drawn as points before accumulation was turned on.
+        if (it->gl_point.size() == it->point_count * 3 &&
+            it->values.size() == it->point_count)
+        {
+          accumulator_.Add(it->gl_point.data(), it->values.data(), it->point_count,
+              it->transform, it->stamp.toSec());
+          added = true;
+        }
+        ReleaseBuffers(*it);
+        it = scans_.erase(it);
+      }
+    }
+
+    accumulator_.Decay(ros::Time::now().toSec());
+
+    if (added && need_minmax_)
+    {
+      UpdateColormap();
+    }
+
+    const size_t tiles = accumulator_.TileCount();
+    if (tiles != reported_tiles_)
+    {
+      reported_tiles_ = tiles;
+      PrintInfo("OK (" + QString::number(tiles).toStdString() + " tiles, " +
+          QString::number(accumulator_.Bytes() / 1048576.0, 'f', 1).toStdString() + " MB)");
+    }
+  }
+
+  void PointCloud2Plugin::AccumulateChanged(int index)
+  {
+    if (index > 0)
     {
-      UpdateColors();
+      accumulator_.SetStatistic(static_cast<PointCloudAccumulator::Statistic>(index - 1));
     }
+    else
+    {
+      accumulator_.Clear();
+    }
+    ui_.cellSize->setEnabled(index > 0);
+    ui_.decayTime->setEnabled(index > 0);
+    // The status switches between the grid's size and the ring's
+    reported_tiles_ = std::numeric_limits<size_t>::max();
+    reported_vram_bytes_ = std::numeric_limits<size_t>::max();
+
+    UpdateMinMaxWidgets();
+    UpdateColors();
+  }
+
+  void PointCloud2Plugin::CellSizeChanged(double value)
+  {
+    accumulator_.SetResolution(value);
+    Q_EMIT Dirty();
+  }
+
+  void PointCloud2Plugin::DecayTimeChanged(int value)
+  {
+    accumulator_.SetDecayTime(value);
+    Q_EMIT Dirty();
   }
 
   void PointCloud2Plugin::LoadConfig(const YAML::Node& node,
@@ -754,6 +1137,21 @@ namespace mapviz_plugins
       node["color_transformer"] >> saved_color_transformer_;
     }
 
+    {
+      QMutexLocker locker(&decode_mutex_);
+      if (node["parallel_decode_threshold"])
+      {
+        node["parallel_decode_threshold"] >> parallel_decode_threshold_;
+      }
+
+      if (node["decode_threads"])
+      {
+        node["decode_threads"] >> decode_threads_;
+      }
+      decode_pool_.setMaxThreadCount(
+          decode_threads_ > 0 ? decode_threads_ : QThread::idealThreadCount());
+    }
+
     if (node["min_color"])
     {
       std::string min_color_str;
@@ -800,6 +1198,31 @@ namespace mapviz_plugins
       ui_.unpack_rgb->setChecked(unpack_rgb);
     }
 
+    if (node["cell_size"])
+    {
+      double cell_size;
+      node["cell_size"] >> cell_size;
+      ui_.cellSize->setValue(cell_size);
+    }
+
+    if (node["decay_time"])
+    {
+      int decay_time;
+      node["decay_time"] >> decay_time;
+      ui_.decayTime->setValue(decay_time);
+    }
+
+    if (node["accumulate"])
+    {
+      std::string accumulate;
+      node["accumulate"] >> accumulate;
+      int index = ui_.accumulate->findText(QString::fromStdString(accumulate));
+      if (index != -1)
+      {
+        ui_.accumulate->setCurrentIndex(index);
+      }
+    }
+
     // UseRainbowChanged must be called *before* ColorTransformerChanged
     UseRainbowChanged(ui_.use_rainbow->checkState());
 
@@ -818,13 +1241,20 @@ namespace mapviz_plugins
   void PointCloud2Plugin::ColorTransformerChanged(int index)
   {
     ROS_DEBUG("Color transformer changed to %d", index);
+    const std::string field = SelectedField();
+    {
+      // New clouds are decoded with the selected field from now on
+      QMutexLocker locker(&decode_mutex_);
+      value_field_ = field;
+    }
+    RedecodeNewestScan(field);
     UpdateMinMaxWidgets();
     UpdateColors();
   }
 
   void PointCloud2Plugin::UpdateMinMaxWidgets()
   {
-    bool color_is_flat = ui_.color_transformer->currentIndex() == COLOR_FLAT;
+    bool color_is_flat = ColorIsFlat();
 
     if (color_is_flat)
     {
@@ -859,6 +1289,8 @@ namespace mapviz_plugins
   void PointCloud2Plugin::AlphaEdited(double value)
   {
     alpha_ = std::max(0.0f, std::min((float)value, 1.0f));
+    color_version_++;
+    Q_EMIT Dirty();
   }
 
   void PointCloud2Plugin::SaveConfig(YAML::Emitter& emitter,
@@ -888,6 +1320,18 @@ namespace mapviz_plugins
       YAML::Value << ui_.use_automaxmin->isChecked();
     emitter << YAML::Key << "unpack_rgb" <<
       YAML::Value << ui_.unpack_rgb->isChecked();
+    emitter << YAML::Key << "accumulate" <<
+      YAML::Value << ui_.accumulate->currentText().toStdString();
+    emitter << YAML::Key << "cell_size" <<
+      YAML::Value << ui_.cellSize->value();
+    emitter << YAML::Key << "decay_time" <<
+      YAML::Value << ui_.decayTime->value();
+
+    QMutexLocker locker(&decode_mutex_);
+    emitter << YAML::Key << "parallel_decode_threshold" <<
+      YAML::Value << parallel_decode_threshold_;
+    emitter << YAML::Key << "decode_threads" <<
+      YAML::Value << decode_threads_;
   }
 }
 
@@ -134,6 +134,7 @@ namespace mapviz_plugins
       zone_ = zone.data;
 
       LoadImage();
+      Q_EMIT Dirty();
     }
   }
 
@@ -207,11 +207,15 @@ namespace mapviz_plugins
       const marti_nav_msgs::RoutePositionConstPtr& msg)
   {
     src_route_position_ = msg;
+
+    Q_EMIT Dirty();
   }
 
   void RoutePlugin::RouteCallback(const marti_nav_msgs::RouteConstPtr& msg)
   {
     src_route_ = sru::Route(*msg);
+
+    Q_EMIT Dirty();
   }
 
   void RoutePlugin::PrintError(const std::string& message)
@@ -298,45 +302,44 @@ namespace mapviz_plugins
   {
     const double a = 2;
     const double S = a * 2.414213562373095;
-
-    glBegin(GL_POLYGON);
-
-    glColor3f(1.0, 0.0, 0.0);
-
-    glVertex2d(x + S / 2.0, y - a / 2.0);
-    glVertex2d(x + S / 2.0, y + a / 2.0);
-    glVertex2d(x + a / 2.0, y + S / 2.0);
-    glVertex2d(x - a / 2.0, y + S / 2.0);
-    glVertex2d(x - S / 2.0, y + a / 2.0);
-    glVertex2d(x - S / 2.0, y - a / 2.0);
-    glVertex2d(x - a / 2.0, y - S / 2.0);
-    glVertex2d(x + a / 2.0, y - S / 2.0);
-
-    glEnd();
+    const QColor color(255, 0, 0);
+
+    vertices_.clear();
+    vertices_.push_back(mapviz::ColorVertex(x + S / 2.0, y - a / 2.0, color));
+    vertices_.push_back(mapviz::ColorVertex(x + S / 2.0, y + a / 2.0, color));
+    vertices_.push_back(mapviz::ColorVertex(x + a / 2.0, y + S / 2.0, color));
+    vertices_.push_back(mapviz::ColorVertex(x - a / 2.0, y + S / 2.0, color));
+    vertices_.push_back(mapviz::ColorVertex(x - S / 2.0, y + a / 2.0, color));
+    vertices_.push_back(mapviz::ColorVertex(x - S / 2.0, y - a / 2.0, color));
+    vertices_.push_back(mapviz::ColorVertex(x - a / 2.0, y - S / 2.0, color));
+    vertices_.push_back(mapviz::ColorVertex(x + a / 2.0, y - S / 2.0, color));
+
+    renderer_->Draw(GL_TRIANGLE_FAN, vertices_);
   }
 
   void RoutePlugin::DrawRoute(const sru::Route& route)
   {
-    const QColor color = ui_.color->color();
-    glColor4d(color.redF(), color.greenF(), color.blueF(), 1.0);
+    QColor color = ui_.color->color();
+    color.setAlpha(255);
 
-    if (draw_style_ == LINES)
+    vertices_.clear();
+    vertices_.reserve(route.points.size());
+    for (size_t i = 0; i < route.points.size(); i++)
     {
-      glLineWidth(3);
-      glBegin(GL_LINE_STRIP);
+      vertices_.push_back(mapviz::ColorVertex(
+          route.points[i].position().x(),
+          route.points[i].position().y(),
+          color));
     }
-    else
+
+    if (draw_style_ == LINES)
     {
-      glPointSize(2);
-      glBegin(GL_POINTS);
+      renderer_->DrawLineStrip(vertices_, 3);
     }
-
-    for (size_t i = 0; i < route.points.size(); i++)
+    else
     {
-      glVertex2d(route.points[i].position().x(),
-                 route.points[i].position().y());
+      renderer_->DrawPoints(vertices_, 2);
     }
-    glEnd();
   }
 
   void RoutePlugin::DrawRoutePoint(const sru::RoutePoint& point)
@@ -353,14 +356,14 @@ namespace mapviz_plugins
     v2 = point_g * v2;
     v3 = point_g * v3;
 
-    const QColor color = ui_.positioncolor->color();
-    glLineWidth(3);
-    glBegin(GL_POLYGON);
-    glColor4d(color.redF(), color.greenF(), color.blueF(), 1.0);
-    glVertex2d(v1.x(), v1.y());
-    glVertex2d(v2.x(), v2.y());
-    glVertex2d(v3.x(), v3.y());
-    glEnd();
+    QColor color = ui_.positioncolor->color();
+    color.setAlpha(255);
+
+    vertices_.clear();
+    vertices_.push_back(mapviz::ColorVertex(v1.x(), v1.y(), color));
+    vertices_.push_back(mapviz::ColorVertex(v2.x(), v2.y(), color));
+    vertices_.push_back(mapviz::ColorVertex(v3.x(), v3.y(), color));
+    renderer_->DrawTriangles(vertices_);
   }
 
   void RoutePlugin::LoadConfig(const YAML::Node& node, const std::string& path)
@@ -0,0 +1,303 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <GL/glew.h>
+#include <mapviz_plugins/scan_persistence.h>
+
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+
+namespace mapviz_plugins
+{
+  ScanPersistence::ScanPersistence() :
+    extent_(100.0),
+    half_life_(0),
+    framebuffer_(0),
+    current_(0),
+    previous_framebuffer_(0),
+    center_x_(0),
+    center_y_(0),
+    cleared_(true),
+    last_fade_(-1)
+  {
+    textures_[0] = 0;
+    textures_[1] = 0;
+  }
+
+  ScanPersistence::~ScanPersistence()
+  {
+  }
+
+  void ScanPersistence::SetExtent(double extent)
+  {
+    if (extent > 0 && extent != extent_)
+    {
+      extent_ = extent;
+      Clear();
+    }
+  }
+
+  void ScanPersistence::SetHalfLife(double half_life)
+  {
+    half_life_ = std::max(0.0, half_life);
+  }
+
+  bool ScanPersistence::Supported()
+  {
+    return GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object;
+  }
+
+  void ScanPersistence::Clear()
+  {
+    // The texture is cleared the next time it's bound
+    cleared_ = true;
+    last_fade_ = -1;
+  }
+
+  void ScanPersistence::Fade(mapviz::Renderer* renderer, double now)
+  {
+    if (half_life_ <= 0 || last_fade_ < 0 || now < last_fade_)
+    {
+      last_fade_ = now;
+      return;
+    }
+
+    // There are only 8 bits of alpha, so fading by a sliver every frame would
+    // round away to nothing; fade in steps of an eighth of the half-life.
+    const double elapsed = now - last_fade_;
+    if (elapsed < half_life_ / 8.0)
+    {
+      return;
+    }
+    last_fade_ = now;
+
+    if (cleared_ || !Bind(current_))
+    {
+      return;
+    }
+
+    // Scale the alpha of every pixel, leaving the colors alone
+    const double factor = std::pow(0.5, elapsed / half_life_);
+    const QColor color(0, 0, 0, static_cast<int>(factor * 255.0));
+    const double half = extent_ / 2.0;
+    std::vector<mapviz::ColorVertex> quad;
+    quad.push_back(mapviz::ColorVertex(center_x_ - half, center_y_ - half, color));
+    quad.push_back(mapviz::ColorVertex(center_x_ + half, center_y_ - half, color));
+    quad.push_back(mapviz::ColorVertex(center_x_ + half, center_y_ + half, color));
+    quad.push_back(mapviz::ColorVertex(center_x_ - half, center_y_ - half, color));
+    quad.push_back(mapviz::ColorVertex(center_x_ + half, center_y_ + half, color));
+    quad.push_back(mapviz::ColorVertex(center_x_ - half, center_y_ + half, color));
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ZERO, GL_SRC_ALPHA);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
+    renderer->DrawTriangles(quad);
+
+    End();
+  }
+
+  bool ScanPersistence::Begin(mapviz::Renderer* renderer, double x, double y)
+  {
+    const double pixel = extent_ / TEXTURE_SIZE;
+    const double margin = extent_ / 4.0;
+    // Keep the center on a pixel boundary so that copying the history across
+    // doesn't resample it
+    const double new_x = std::floor(x / pixel + 0.5) * pixel;
+    const double new_y = std::floor(y / pixel + 0.5) * pixel;
+
+    if (cleared_)
+    {
+      if (!Bind(current_))
+      {
+        return false;
+      }
+      center_x_ = new_x;
+      center_y_ = new_y;
+      glClearColor(0, 0, 0, 0);
+      glClear(GL_COLOR_BUFFER_BIT);
+      cleared_ = false;
+    }
+    else if (std::fabs(x - center_x_) > margin || std::fabs(y - center_y_) > margin)
+    {
+      // Copy what overlaps into the other texture, centered on the sensor
+      const int previous = current_;
+      if (!Bind(1 - previous))
+      {
+        return false;
+      }
+      std::vector<mapviz::TexturedVertex> quad;
+      Quad(center_x_, center_y_, quad);
+      center_x_ = new_x;
+      center_y_ = new_y;
+      LoadProjection();
+      glClearColor(0, 0, 0, 0);
+      glClear(GL_COLOR_BUFFER_BIT);
+      renderer->DrawTexturedQuads(textures_[previous], quad);
+      current_ = 1 - previous;
+    }
+    else if (!Bind(current_))
+    {
+      return false;
+    }
+
+    LoadProjection();
+    return true;
+  }
+
+  void ScanPersistence::End()
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer_);
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glPopAttrib();
+  }
+
+  void ScanPersistence::Draw(mapviz::Renderer* renderer,
+      const tf::Transform& transform, float alpha)
+  {
+    if (cleared_ || textures_[current_] == 0)
+    {
+      return;
+    }
+
+    // The canvas only keeps a thin slice around z = 0, so the history is laid
+    // flat rather than following the fixed frame's height.
+    tf::Vector3 origin = transform.getOrigin();
+    origin.setZ(0);
+
+    std::vector<mapviz::TexturedVertex> quad;
+    Quad(center_x_, center_y_, quad);
+    mapviz::Renderer::PushTransform(tf::Transform(transform.getBasis(), origin));
+    renderer->DrawTexturedQuads(textures_[current_], quad,
+        QColor(255, 255, 255, static_cast<int>(alpha * 255.0f)));
+    mapviz::Renderer::PopTransform();
+  }
+
+  void ScanPersistence::Destroy()
+  {
+    if (framebuffer_ != 0)
+    {
+      glDeleteFramebuffers(1, &framebuffer_);
+      glDeleteTextures(2, textures_);
+      framebuffer_ = 0;
+      textures_[0] = 0;
+      textures_[1] = 0;
+    }
+    Clear();
+  }
+
+  bool ScanPersistence::Allocate()
+  {
+    if (framebuffer_ != 0)
+    {
+      return true;
+    }
+
+    if (!Supported())
+    {
+      return false;
+    }
+
+    glGenFramebuffers(1, &framebuffer_);
+    glGenTextures(2, textures_);
+    for (int i = 0; i < 2; i++)
+    {
+      glBindTexture(GL_TEXTURE_2D, textures_[i]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, TEXTURE_SIZE, TEXTURE_SIZE, 0,
+          GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    cleared_ = true;
+
+    return true;
+  }
+
+  /**
+   * Redirects drawing into one of the textures, saving the state that's
+   * changed along the way; End() puts it back.
+   */
+  bool ScanPersistence::Bind(int texture)
+  {
+    if (!Allocate())
+    {
+      return false;
+    }
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_2D, textures_[texture], 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+      glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer_);
+      return false;
+    }
+
+    glPushAttrib(GL_VIEWPORT_BIT | GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+    glViewport(0, 0, TEXTURE_SIZE, TEXTURE_SIZE);
+    glDisable(GL_BLEND);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    LoadProjection();
+
+    return true;
+  }
+
+  void ScanPersistence::LoadProjection()
+  {
+    // The depth range is wide open since scans can be anywhere in z
+    const double half = extent_ / 2.0;
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(center_x_ - half, center_x_ + half, center_y_ - half, center_y_ + half,
+        -1.0e6, 1.0e6);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+  }
+
+  void ScanPersistence::Quad(double x, double y,
+      std::vector<mapviz::TexturedVertex>& quad) const
+  {
+    const double half = extent_ / 2.0;
+    quad.clear();
+    quad.push_back(mapviz::TexturedVertex(x - half, y - half, 0, 0));
+    quad.push_back(mapviz::TexturedVertex(x + half, y - half, 1, 0));
+    quad.push_back(mapviz::TexturedVertex(x + half, y + half, 1, 1));
+    quad.push_back(mapviz::TexturedVertex(x - half, y + half, 0, 1));
+  }
+}
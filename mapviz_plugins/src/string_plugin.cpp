@@ -54,7 +54,6 @@ namespace mapviz_plugins
     offset_x_(0),
     offset_y_(0),
     has_message_(false),
-    has_painted_(false),
     color_(Qt::black)
   {
     ui_.setupUi(config_widget_);
@@ -88,6 +87,11 @@ namespace mapviz_plugins
   {
   }
 
+  void StringPlugin::Shutdown()
+  {
+    text_.Destroy();
+  }
+
   bool StringPlugin::Initialize(QGLWidget* canvas)
   {
     canvas_ = canvas;
@@ -95,37 +99,18 @@ namespace mapviz_plugins
   }
 
   void StringPlugin::Draw(double x, double y, double scale)
-  {
-    // This plugin doesn't do any  OpenGL drawing.
-  }
-
-  void StringPlugin::Paint(QPainter* painter, double x, double y, double scale)
   {
     if (has_message_)
     {
-      painter->save();
-      painter->resetTransform();
-      painter->setFont(font_);
-
-      if (!has_painted_)
+      if (!text_.IsCurrent(layout_))
       {
-        // After the first time we get a new message, we do not know how wide it's
-        // going to be when rendered, so we can't accurately calculate the top left
-        // coordinate if it's offset from the right or bottom borders.
-        // The easiest workaround I've found for this is to draw it once using
-        // a completely transparent pen, which will cause the QStaticText class to
-        // know how wide it is; then we can recalculate the offsets and draw it
-        // again with a visible pen.
-        QPen invisPen(QBrush(Qt::transparent), 1);
-        painter->setPen(invisPen);
-        PaintText(painter);
-        has_painted_ = true;
+        layout_ = text_.GetLayout(message_, font_);
       }
-      QPen pen(QBrush(color_), 1);
-      painter->setPen(pen);
-      PaintText(painter);
 
-      painter->restore();
+      text_.Begin();
+      DrawText();
+      text_.Draw(*renderer_);
+
       PrintInfo("OK");
     }
     else
@@ -134,7 +119,7 @@ namespace mapviz_plugins
     }
   }
 
-  void StringPlugin::PaintText(QPainter* painter)
+  void StringPlugin::DrawText()
   {
     // Calculate the correct offsets and dimensions
     int x_offset = offset_x_;
@@ -145,10 +130,10 @@ namespace mapviz_plugins
       y_offset = static_cast<int>((float)(offset_y_ * canvas_->height()) / 100.0);
     }
 
-    int right = static_cast<int>((float)canvas_->width() - message_.size().width()) - x_offset;
-    int bottom = static_cast<int>((float)canvas_->height() - message_.size().height()) - y_offset;
-    int yCenter = static_cast<int>((float)canvas_->height() / 2.0 - message_.size().height()/2.0);
-    int xCenter = static_cast<int>((float)canvas_->width() / 2.0 - message_.size().width()/2.0);
+    int right = static_cast<int>((float)canvas_->width() - layout_->width) - x_offset;
+    int bottom = static_cast<int>((float)canvas_->height() - layout_->height) - y_offset;
+    int yCenter = static_cast<int>((float)canvas_->height() / 2.0 - layout_->height/2.0);
+    int xCenter = static_cast<int>((float)canvas_->width() / 2.0 - layout_->width/2.0);
 
     QPoint ulPoint;
 
@@ -191,7 +176,7 @@ namespace mapviz_plugins
         ulPoint.setY(bottom);
         break;
     }
-    painter->drawStaticText(ulPoint, message_);
+    text_.Add(layout_, ulPoint.x(), ulPoint.y(), color_);
   }
 
   void StringPlugin::LoadConfig(const YAML::Node& node, const std::string& path)
@@ -205,6 +190,7 @@ namespace mapviz_plugins
     if (node[FONT_KEY])
     {
       font_.fromString(QString(node[FONT_KEY].as<std::string>().c_str()));
+      layout_.reset();
       ui_.font_button->setFont(font_);
       ui_.font_button->setText(font_.family());
     }
@@ -286,7 +272,7 @@ namespace mapviz_plugins
     if (ok)
     {
       font_ = font;
-      message_.prepare(QTransform(), font_);
+      layout_.reset();
       ui_.font_button->setFont(font_);
       ui_.font_button->setText(font_.family());
     }
@@ -389,12 +375,13 @@ namespace mapviz_plugins
 
   void StringPlugin::stringCallback(const std_msgs::StringConstPtr& str)
   {
-    message_.setText(QString(str->data.c_str()));
-    message_.prepare(QTransform(), font_);
+    message_ = QString(str->data.c_str());
+    layout_.reset();
 
     has_message_ = true;
-    has_painted_ = false;
     initialized_ = true;
+
+    Q_EMIT Dirty();
   }
 
   std::string StringPlugin::AnchorToString(StringPlugin::Anchor anchor)
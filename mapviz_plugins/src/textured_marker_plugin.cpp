@@ -404,11 +404,15 @@ namespace mapviz_plugins
   void TexturedMarkerPlugin::MarkerCallback(const marti_visualization_msgs::TexturedMarkerConstPtr marker)
   {
     Q_EMIT MarkerReceived(marker);
+
+    Q_EMIT Dirty();
   }
 
   void TexturedMarkerPlugin::MarkerArrayCallback(const marti_visualization_msgs::TexturedMarkerArrayConstPtr markers)
   {
     Q_EMIT MarkersReceived(markers);
+
+    Q_EMIT Dirty();
   }
 
   void TexturedMarkerPlugin::PrintError(const std::string& message)
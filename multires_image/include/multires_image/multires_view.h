@@ -50,6 +50,9 @@ class MultiresView
 
     void Draw();
 
+    // True if the last Draw() skipped tiles that are still being loaded.
+    bool HasPendingTiles() const { return m_pendingTiles; }
+
     void Exit() { m_cache.Exit(); }
 
   private:
@@ -60,6 +63,7 @@ class MultiresView
     int        m_startColumn;
     int        m_endRow;
     int        m_endColumn;
+    bool       m_pendingTiles;
 
     double min_scale_;
   };
@@ -219,6 +219,12 @@ namespace mapviz_plugins
 
       tile_view_->Draw();
 
+      if (tile_view_->HasPendingTiles())
+      {
+        // Keep repainting until the tiles in view have finished loading.
+        Q_EMIT Dirty();
+      }
+
       PrintInfo("OK");
     }
   }
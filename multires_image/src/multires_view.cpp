@@ -45,7 +45,8 @@ namespace mapviz_plugins
       m_startRow(0),
       m_startColumn(0),
       m_endRow(0),
-      m_endColumn(0)
+      m_endColumn(0),
+      m_pendingTiles(false)
   {
     double top, left, bottom, right;
 
@@ -129,6 +130,8 @@ namespace mapviz_plugins
 
   void MultiresView::Draw()
   {
+    m_pendingTiles = false;
+
     glEnable(GL_TEXTURE_2D);
 
     glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
@@ -144,6 +147,7 @@ namespace mapviz_plugins
     else
     {
       m_cache.Load(tile);
+      m_pendingTiles = true;
     }
 
     if(m_tiles->LayerCount() >= 2)
@@ -161,6 +165,7 @@ namespace mapviz_plugins
           else
           {
             m_cache.Load(tile);
+            m_pendingTiles = true;
           }
         }
       }
@@ -183,6 +188,7 @@ namespace mapviz_plugins
             else
             {
               m_cache.Load(tile);
+              m_pendingTiles = true;
             }
           }
         }
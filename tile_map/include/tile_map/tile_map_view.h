@@ -31,6 +31,7 @@
 #define TILE_MAP_TILE_MAP_VIEW_H_
 
 #include <string>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 
@@ -39,6 +40,11 @@
 
 #include <swri_transform_util/transform.h>
 
+namespace mapviz
+{
+  class Renderer;
+}
+
 namespace tile_map
 {
   class TileSource;
@@ -78,10 +84,16 @@ namespace tile_map
       int32_t width,
       int32_t height);
 
-    void Draw();
+    void Draw(mapviz::Renderer* renderer);
+
+    /**
+     * True if the last Draw() skipped visible tiles whose images are still
+     * being loaded.
+     */
+    bool HasPendingTiles() const { return pending_tiles_; }
 
   private:
-    void DrawTiles(std::vector<Tile> &tiles ,int priority);
+    void DrawTiles(mapviz::Renderer* renderer, std::vector<Tile> &tiles ,int priority);
 
     boost::shared_ptr<TileSource> tile_source_;
 
@@ -102,6 +114,8 @@ namespace tile_map
 
     TextureCachePtr tile_cache_;
 
+    bool pending_tiles_;
+
     void ToLatLon(int32_t level, double x, double y, double& latitude, double& longitude);
 
     void InitializeTile(int32_t level, int64_t x, int64_t y, Tile& tile, int priority);
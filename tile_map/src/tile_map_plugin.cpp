@@ -324,7 +324,13 @@ namespace tile_map
         tile_map_.SetView(center.y(), center.x(), scale, canvas_->width(), canvas_->height());
         ROS_DEBUG("TileMapPlugin::Draw: Successfully set view");
       }
-      tile_map_.Draw();
+      tile_map_.Draw(renderer_);
+
+      if (tile_map_.HasPendingTiles())
+      {
+        // Keep repainting until the tiles in view have finished loading.
+        Q_EMIT Dirty();
+      }
     }
   }
 
@@ -37,6 +37,8 @@
 #include <GL/gl.h>
 #include <GL/glu.h>
 
+#include <mapviz/renderer.h>
+
 #include <ros/ros.h>
 
 #include <swri_math_util/constants.h>
@@ -50,7 +52,8 @@ namespace tile_map
   TileMapView::TileMapView() :
     level_(-1),
     width_(100),
-    height_(100)
+    height_(100),
+    pending_tiles_(false)
   {
     ImageCachePtr image_cache = boost::make_shared<ImageCache>("/tmp/tile_map");
     tile_cache_ = boost::make_shared<TextureCache>(image_cache);
@@ -208,8 +211,9 @@ namespace tile_map
     }
   }
 
-  void TileMapView::DrawTiles(std::vector<Tile>& tiles, int priority)
+  void TileMapView::DrawTiles(mapviz::Renderer* renderer, std::vector<Tile>& tiles, int priority)
   {
+    std::vector<mapviz::TexturedVertex> vertices;
     for (size_t i = 0; i < tiles.size(); i++)
     {
       TexturePtr& texture = tiles[i].texture;
@@ -218,15 +222,16 @@ namespace tile_map
       {
         bool failed;
         texture = tile_cache_->GetTexture(tiles[i].url_hash, tiles[i].url, failed, priority);
+        if (!texture && !failed)
+        {
+          pending_tiles_ = true;
+        }
       }
 
       if (texture)
       {
-        glBindTexture(GL_TEXTURE_2D, texture->id);
-
-        glBegin(GL_TRIANGLES);
-
-        glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+        vertices.clear();
+        vertices.reserve(tiles[i].subdiv_count * tiles[i].subdiv_count * 4);
 
         for (int32_t row = 0; row < tiles[i].subdiv_count; row++)
         {
@@ -242,38 +247,29 @@ namespace tile_map
             const tf::Vector3& br = tiles[i].points_t[(row + 1) * (tiles[i].subdiv_count + 1) + col + 1];
             const tf::Vector3& bl = tiles[i].points_t[(row + 1) * (tiles[i].subdiv_count + 1) + col];
 
-            // Triangle 1
-            glTexCoord2f(u_0, v_0); glVertex2d(tl.x(), tl.y());
-            glTexCoord2f(u_1, v_0); glVertex2d(tr.x(), tr.y());
-            glTexCoord2f(u_1, v_1); glVertex2d(br.x(), br.y());
-
-            // Triangle 2
-            glTexCoord2f(u_0, v_0); glVertex2d(tl.x(), tl.y());
-            glTexCoord2f(u_1, v_1); glVertex2d(br.x(), br.y());
-            glTexCoord2f(u_0, v_1); glVertex2d(bl.x(), bl.y());
+            vertices.push_back(mapviz::TexturedVertex(tl.x(), tl.y(), u_0, v_0));
+            vertices.push_back(mapviz::TexturedVertex(tr.x(), tr.y(), u_1, v_0));
+            vertices.push_back(mapviz::TexturedVertex(br.x(), br.y(), u_1, v_1));
+            vertices.push_back(mapviz::TexturedVertex(bl.x(), bl.y(), u_0, v_1));
           }
         }
 
-        glEnd();
-
-        glBindTexture(GL_TEXTURE_2D, 0);
+        renderer->DrawTexturedQuads(texture->id, vertices);
       }
     }
   }
 
-  void TileMapView::Draw()
+  void TileMapView::Draw(mapviz::Renderer* renderer)
   {
     if (!tile_source_)
     {
       return;
     }
 
-    glEnable(GL_TEXTURE_2D);
-
-    DrawTiles( precache_, 0 );
-    DrawTiles( tiles_, 10000 );
+    pending_tiles_ = false;
 
-    glDisable(GL_TEXTURE_2D);
+    DrawTiles(renderer, precache_, 0);
+    DrawTiles(renderer, tiles_, 10000);
   }
 
   void TileMapView::ToLatLon(int32_t level, double x, double y, double& latitude, double& longitude)